@@ -0,0 +1,476 @@
+// bench.c - headless timing of opening and saving mapter files
+//           part of the mapter program
+// Copyright (C) 2020 John Davies
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#include <gtk/gtk.h>
+#include "main.h"
+#include "doc.h"
+#include "file.h"
+#include "config.h"
+#include "binfile.h"
+#include "compress.h"
+#include "template.h"
+#include "export.h"
+#include "incremental.h"
+#include "bench.h"
+
+// Documents timed when no files are given
+const bench_profile bench_profiles[] = {
+  { "small", 10, 10, 500, 20, 2 },
+  { "sparse", 100, 100, 1000, 95, 3 },
+  { "dense", 50, 50, 4000, 0, 4 }
+};
+
+// Every document is saved and opened in each of these formats
+const bench_format bench_formats[] = {
+  { "json", BENCH_JSON_EXTENSION, FALSE },
+  { "compact", BENCH_JSON_EXTENSION, TRUE },
+  { "binary", BINARY_EXTENSION, FALSE },
+  { "gzip", BENCH_JSON_EXTENSION GZIP_EXTENSION, FALSE }
+};
+
+// Words that generated text is made from, including some that have to be
+// escaped in JSON
+const gchar *bench_words[] = {
+  "the", "army", "advanced", "towards", "river", "while", "\"reserves\"",
+  "were", "held", "back", "at", "Verdun", "and", "Somme", "café", "front",
+  "line", "orders", "arrived", "late", "tab\there", "slash\\", "of", "a"
+};
+
+// --------------------------------------------------------------------------
+// bench_files
+//
+// Entry point for the --bench option, none of GTK is used
+// Times saving and opening the specified files, or a set of generated
+// documents if none are given, in each of the supported formats
+//
+// --------------------------------------------------------------------------
+
+gint bench_files( gint count, gchar **file_paths )
+{
+  GError *error = NULL;
+  gint status = EXIT_SUCCESS;
+
+  g_info( "bench.c / bench_files");
+  // Somewhere to save to
+  gchar *dir = g_dir_make_tmp( BENCH_TEMP_DIR, &error );
+  if( dir == NULL )
+  {
+    fprintf( stderr, "%s\n", error->message );
+    g_error_free( error );
+    return EXIT_FAILURE;
+  }
+  printf( "Best of %d runs, open only reads the file into the document\n", BENCH_RUNS );
+  if( count == 0 )
+  {
+    for( gsize i=0; i<G_N_ELEMENTS( bench_profiles ); i++ )
+    {
+      mapter_doc *doc = bench_generate( &bench_profiles[i] );
+      if( bench_document( bench_profiles[i].name, doc, dir ) == FALSE )
+      {
+        status = EXIT_FAILURE;
+      }
+      doc_free( doc );
+    }
+  }
+  for( gint i=0; i<count; i++ )
+  {
+    mapter_doc *doc;
+    result_return result = load_document( file_paths[i], &doc );
+    if( result.result == FALSE )
+    {
+      fprintf( stderr, "%s: %s\n", file_paths[i], result.message );
+      status = EXIT_FAILURE;
+      continue;
+    }
+    gchar *name = g_path_get_basename( file_paths[i] );
+    if( bench_document( name, doc, dir ) == FALSE )
+    {
+      status = EXIT_FAILURE;
+    }
+    g_free( name );
+    doc_free( doc );
+  }
+  g_rmdir( dir );
+  g_free( dir );
+
+  g_info( "bench.c / ~bench_files");
+  return status;
+}
+
+// --------------------------------------------------------------------------
+// bench_generate_file
+//
+// Entry point for the --generate option, writes a generated document
+// FILE ROWS COLUMNS [ BODY_SIZE [ EMPTY_PERCENT [ NOTE_DEPTH ] ] ]
+//
+// --------------------------------------------------------------------------
+
+gint bench_generate_file( gint count, gchar **args )
+{
+  bench_profile profile = { NULL, 0, 0, BENCH_DEFAULT_BODY_SIZE,
+                            BENCH_DEFAULT_EMPTY_PERCENT, BENCH_DEFAULT_NOTE_DEPTH };
+  gint *values[] = { &profile.rows, &profile.columns, &profile.body_size,
+                     &profile.empty_percent, &profile.note_depth };
+  const gint64 minimum[] = { MIN_GRID_ROWS, MIN_GRID_COLUMNS, 0, 0, 0 };
+  const gint64 maximum[] = { G_MAXINT16, G_MAXINT16, G_MAXINT32, 100, 8 };
+  gint64 value;
+
+  g_info( "bench.c / bench_generate_file");
+  if( ( count < 3 ) || ( count > 6 ) )
+  {
+    fprintf( stderr, "Usage: %s %s FILE ROWS COLUMNS [ BODY_SIZE [ EMPTY_PERCENT [ NOTE_DEPTH ] ] ]\n",
+             APP_NAME, GENERATE_OPTION );
+    return EXIT_FAILURE;
+  }
+  profile.name = args[0];
+  for( gint i=1; i<count; i++ )
+  {
+    if( g_ascii_string_to_signed( args[i], 10, minimum[i-1], maximum[i-1], &value, NULL ) == FALSE )
+    {
+      fprintf( stderr, "%s: should be a number from %" G_GINT64_FORMAT " to %" G_GINT64_FORMAT "\n",
+               args[i], minimum[i-1], maximum[i-1] );
+      return EXIT_FAILURE;
+    }
+    *values[i-1] = value;
+  }
+  mapter_doc *doc = bench_generate( &profile );
+  result_return result = save_document( doc, args[0], 0 );
+  doc_free( doc );
+  if( result.result == FALSE )
+  {
+    fprintf( stderr, "%s: %s\n", args[0], result.message );
+    return EXIT_FAILURE;
+  }
+
+  g_info( "bench.c / ~bench_generate_file");
+  return EXIT_SUCCESS;
+}
+
+// --------------------------------------------------------------------------
+// bench_generate
+//
+// Builds a document to the specified profile, filled with made up text
+//
+// --------------------------------------------------------------------------
+
+mapter_doc *bench_generate( const bench_profile *profile )
+{
+  g_info( "bench.c / bench_generate");
+  GRand *rand = g_rand_new_with_seed( BENCH_SEED );
+  mapter_doc *doc = doc_new( profile->rows, profile->columns );
+  for( gint i=0; i<( profile->rows * profile->columns ); i++ )
+  {
+    doc_cell *cell = &doc->cells[i];
+    if( g_rand_int_range( rand, 0, 100 ) < profile->empty_percent )
+    {
+      continue;
+    }
+    cell->colour = g_rand_int_range( rand, NONE, NEUTRAL + 1 );
+    gchar *text = bench_text( rand, BENCH_SUMMARY_SIZE );
+    doc_text_set( &cell->summary, text );
+    g_free( text );
+    text = bench_text( rand, BENCH_HEADING_SIZE );
+    doc_text_set( &cell->heading, text );
+    g_free( text );
+    text = bench_text( rand, profile->body_size );
+    doc_text_set( &cell->body, text );
+    g_free( text );
+  }
+  bench_generate_notes( doc, rand, 0, profile );
+  g_rand_free( rand );
+  g_info( "bench.c / ~bench_generate");
+  return doc;
+}
+
+// --------------------------------------------------------------------------
+// bench_generate_notes
+//
+// Adds the notes at one level of the tree along with their children, in
+// depth first order
+//
+// --------------------------------------------------------------------------
+
+void bench_generate_notes( mapter_doc *doc, GRand *rand, gint level, const bench_profile *profile )
+{
+  if( level >= profile->note_depth )
+  {
+    return;
+  }
+  for( gint i=0; i<BENCH_NOTE_CHILDREN; i++ )
+  {
+    gchar *heading = bench_text( rand, BENCH_HEADING_SIZE );
+    gchar *text = bench_text( rand, profile->body_size );
+    doc_add_note( doc, level, heading, text );
+    g_free( heading );
+    g_free( text );
+    bench_generate_notes( doc, rand, level + 1, profile );
+  }
+}
+
+// --------------------------------------------------------------------------
+// bench_text
+//
+// Makes up some text of about the specified length, split into paragraphs
+//
+// --------------------------------------------------------------------------
+
+gchar *bench_text( GRand *rand, gint size )
+{
+  GString *text = g_string_sized_new( size + 16 );
+  while( (gint)text->len < size )
+  {
+    if( text->len > 0 )
+    {
+      g_string_append_c( text, ( g_rand_int_range( rand, 0, 12 ) == 0 ) ? '\n' : ' ' );
+    }
+    g_string_append( text, bench_words[ g_rand_int_range( rand, 0, G_N_ELEMENTS( bench_words ) ) ] );
+  }
+  return g_string_free( text, FALSE );
+}
+
+// --------------------------------------------------------------------------
+// bench_document
+//
+// Times saving and opening the document in each format and shows the
+// results. Returns FALSE if any of them failed
+//
+// --------------------------------------------------------------------------
+
+gboolean bench_document( const gchar *name, mapter_doc *doc, const gchar *dir )
+{
+  GStatBuf info;
+  gboolean compact = doc->compact;
+  gboolean result = TRUE;
+  gdouble cells = doc->rows * doc->columns;
+
+  g_info( "bench.c / bench_document");
+  printf( "\n%s: %d x %d cells, %d notes\n", name, doc->rows, doc->columns, doc->notes->len );
+  printf( "  %-8s %10s %10s %12s %10s %12s\n", "format", "size KB", "save MB/s", "save cells/s",
+          "open MB/s", "open cells/s" );
+  for( gsize i=0; i<G_N_ELEMENTS( bench_formats ); i++ )
+  {
+    gchar *file_name = g_strconcat( bench_formats[i].name, bench_formats[i].extension, NULL );
+    gchar *file_path = g_build_filename( dir, file_name, NULL );
+    doc->compact = bench_formats[i].compact;
+    gdouble save_time = bench_time_save( doc, file_path );
+    gdouble open_time = ( save_time >= 0 ) ? bench_time_open( file_path ) : -1;
+    if( ( open_time < 0 ) || ( g_stat( file_path, &info ) != 0 ) )
+    {
+      printf( "  %-8s failed\n", bench_formats[i].name );
+      result = FALSE;
+    }
+    else
+    {
+      gdouble megabytes = info.st_size / ( 1024.0 * 1024.0 );
+      printf( "  %-8s %10.1f %10.1f %12.0f %10.1f %12.0f\n", bench_formats[i].name, info.st_size / 1024.0,
+              bench_rate( megabytes, save_time ), bench_rate( cells, save_time ),
+              bench_rate( megabytes, open_time ), bench_rate( cells, open_time ) );
+    }
+    g_remove( file_path );
+    g_free( file_path );
+    g_free( file_name );
+  }
+  doc->compact = compact;
+  // Export only writes so there's no open time, a re-export only has one
+  // changed cell and the rates are for the whole document. A reopen is a
+  // re-export of the document read back from a file, with its text still
+  // as it was in the file
+  gchar *export_path = g_build_filename( dir, BENCH_EXPORT_FILE, NULL );
+  gchar *manifest_path = g_strconcat( export_path, INCREMENTAL_SUFFIX, NULL );
+  gchar *reopen_path = g_build_filename( dir, BENCH_REOPEN_FILE, NULL );
+  const gchar *export_names[] = { "export", "reexport", "reopen" };
+  for( gsize i=0; i<G_N_ELEMENTS( export_names ); i++ )
+  {
+    const gchar *name = export_names[i];
+    gdouble export_time = ( i < 2 ) ? bench_time_export( doc, export_path, ( i == 1 ) ) :
+                                      bench_time_reopen( doc, reopen_path, export_path );
+    if( ( export_time < 0 ) || ( g_stat( export_path, &info ) != 0 ) )
+    {
+      printf( "  %-8s failed\n", name );
+      result = FALSE;
+    }
+    else
+    {
+      printf( "  %-8s %10.1f %10.1f %12.0f\n", name, info.st_size / 1024.0,
+              bench_rate( info.st_size / ( 1024.0 * 1024.0 ), export_time ), bench_rate( cells, export_time ) );
+    }
+  }
+  g_remove( reopen_path );
+  g_remove( manifest_path );
+  g_remove( export_path );
+  g_free( reopen_path );
+  g_free( manifest_path );
+  g_free( export_path );
+  g_info( "bench.c / ~bench_document");
+  return result;
+}
+
+// --------------------------------------------------------------------------
+// bench_time_save
+//
+// Returns the best time in seconds to save the document to the file, or
+// -1 if it couldn't be saved
+//
+// --------------------------------------------------------------------------
+
+gdouble bench_time_save( mapter_doc *doc, const gchar *file_path )
+{
+  gint64 best = G_MAXINT64;
+  for( gint run=0; run<BENCH_RUNS; run++ )
+  {
+    gint64 start = g_get_monotonic_time();
+    result_return result = save_document( doc, file_path, 0 );
+    if( result.result == FALSE )
+    {
+      fprintf( stderr, "%s: %s\n", file_path, result.message );
+      return -1;
+    }
+    best = MIN( best, g_get_monotonic_time() - start );
+  }
+  return best / (gdouble) G_USEC_PER_SEC;
+}
+
+// --------------------------------------------------------------------------
+// bench_time_export
+//
+// Returns the best time in seconds to export the document as text with
+// all of the export options turned on, or -1 if it couldn't be exported
+// An incremental export is timed after the body of the last cell has
+// been changed, as if it had just been edited
+//
+// --------------------------------------------------------------------------
+
+gdouble bench_time_export( mapter_doc *doc, const gchar *file_path, gboolean incremental )
+{
+  export_options options = { TRUE, TRUE, TRUE, ROWS_AS_CHAPTERS, incremental, NULL, PACKAGE_NONE, FALSE };
+  doc_cell *edited = doc_get_cell( doc, doc->rows - 1, doc->columns - 1 );
+  gchar *original = g_strdup( doc_text_get( &edited->body ) );
+  gint64 best = G_MAXINT64;
+  for( gint run=0; run<BENCH_RUNS; run++ )
+  {
+    if( incremental == TRUE )
+    {
+      gchar *text = g_strdup_printf( "%s %d", original, run );
+      doc_text_set( &edited->body, text );
+      g_free( text );
+    }
+    gint64 start = g_get_monotonic_time();
+    result_return result = export_file( doc, &options, file_path );
+    if( result.result == FALSE )
+    {
+      fprintf( stderr, "%s: %s\n", file_path, result.message );
+      best = -1;
+      break;
+    }
+    best = MIN( best, g_get_monotonic_time() - start );
+  }
+  if( incremental == TRUE )
+  {
+    doc_text_set( &edited->body, original );
+  }
+  g_free( original );
+  return ( best < 0 ) ? -1 : best / (gdouble) G_USEC_PER_SEC;
+}
+
+// --------------------------------------------------------------------------
+// bench_time_reopen
+//
+// Returns the best time in seconds to re-export the document after it's
+// been saved and read back in, with the body of the last cell changed as
+// for bench_time_export, or -1 if it couldn't be saved, read or exported
+// Only the edited chapter should need to be exported again
+//
+// --------------------------------------------------------------------------
+
+gdouble bench_time_reopen( mapter_doc *doc, const gchar *file_path, const gchar *export_path )
+{
+  export_options options = { TRUE, TRUE, TRUE, ROWS_AS_CHAPTERS, TRUE, NULL, PACKAGE_NONE, FALSE };
+  mapter_doc *reopened;
+  gint64 best = G_MAXINT64;
+
+  if( save_document( doc, file_path, 0 ).result == FALSE )
+  {
+    return -1;
+  }
+  for( gint run=0; run<BENCH_RUNS; run++ )
+  {
+    result_return result = load_document( file_path, &reopened );
+    if( result.result == FALSE )
+    {
+      fprintf( stderr, "%s: %s\n", file_path, result.message );
+      return -1;
+    }
+    doc_cell *edited = doc_get_cell( reopened, reopened->rows - 1, reopened->columns - 1 );
+    gchar *text = g_strdup_printf( "%s reopened %d", doc_text_get( &edited->body ), run );
+    doc_text_set( &edited->body, text );
+    g_free( text );
+    gint64 start = g_get_monotonic_time();
+    result = export_file( reopened, &options, export_path );
+    if( result.result == FALSE )
+    {
+      fprintf( stderr, "%s: %s\n", export_path, result.message );
+      doc_free( reopened );
+      return -1;
+    }
+    best = MIN( best, g_get_monotonic_time() - start );
+    doc_free( reopened );
+  }
+  return best / (gdouble) G_USEC_PER_SEC;
+}
+
+// --------------------------------------------------------------------------
+// bench_time_open
+//
+// Returns the best time in seconds to read the file into a document, or
+// -1 if it couldn't be read
+//
+// --------------------------------------------------------------------------
+
+gdouble bench_time_open( const gchar *file_path )
+{
+  gint64 best = G_MAXINT64;
+  mapter_doc *doc;
+  for( gint run=0; run<BENCH_RUNS; run++ )
+  {
+    gint64 start = g_get_monotonic_time();
+    result_return result = load_document( file_path, &doc );
+    if( result.result == FALSE )
+    {
+      fprintf( stderr, "%s: %s\n", file_path, result.message );
+      return -1;
+    }
+    best = MIN( best, g_get_monotonic_time() - start );
+    doc_free( doc );
+  }
+  return best / (gdouble) G_USEC_PER_SEC;
+}
+
+// --------------------------------------------------------------------------
+// bench_rate
+//
+// Returns the amount per second, a time too short to measure shows as 0
+//
+// --------------------------------------------------------------------------
+
+gdouble bench_rate( gdouble amount, gdouble seconds )
+{
+  return ( seconds > 0 ) ? ( amount / seconds ) : 0;
+}
@@ -0,0 +1,78 @@
+// bench.h - header file for bench.c
+//           part of the mapter program
+// Copyright (C) 2020 John Davies
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef BENCH_H
+#define BENCH_H
+
+// Command line options
+#define BENCH_OPTION "--bench"
+#define GENERATE_OPTION "--generate"
+
+// Each time is the best of this many runs
+#define BENCH_RUNS 3
+
+// Generated documents are always the same for the same profile
+#define BENCH_SEED 1916
+
+// Each note in a generated notes tree has this many children until the
+// tree is deep enough
+#define BENCH_NOTE_CHILDREN 3
+
+// Generated summary and heading lengths
+#define BENCH_SUMMARY_SIZE 30
+#define BENCH_HEADING_SIZE 40
+
+// Defaults for the optional --generate values
+#define BENCH_DEFAULT_BODY_SIZE 1000
+#define BENCH_DEFAULT_EMPTY_PERCENT 50
+#define BENCH_DEFAULT_NOTE_DEPTH 3
+
+#define BENCH_TEMP_DIR "mapter-bench-XXXXXX"
+#define BENCH_JSON_EXTENSION ".mapter"
+#define BENCH_EXPORT_FILE "export.txt"
+#define BENCH_REOPEN_FILE "reopen" BENCH_JSON_EXTENSION
+
+// Shape of a generated document
+typedef struct {
+  const gchar *name;
+  gint rows;
+  gint columns;
+  gint body_size;         // Approximate characters in each cell body
+  gint empty_percent;     // Cells with no text at all
+  gint note_depth;        // Levels in the notes tree, 0 = no notes
+} bench_profile;
+
+// A way of saving a document that is timed
+typedef struct {
+  const gchar *name;
+  const gchar *extension;
+  gboolean compact;
+} bench_format;
+
+gint bench_files( gint, gchar ** );
+gint bench_generate_file( gint, gchar ** );
+mapter_doc *bench_generate( const bench_profile * );
+void bench_generate_notes( mapter_doc *, GRand *, gint, const bench_profile * );
+gchar *bench_text( GRand *, gint );
+gboolean bench_document( const gchar *, mapter_doc *, const gchar * );
+gdouble bench_time_save( mapter_doc *, const gchar * );
+gdouble bench_time_export( mapter_doc *, const gchar *, gboolean );
+gdouble bench_time_reopen( mapter_doc *, const gchar *, const gchar * );
+gdouble bench_time_open( const gchar * );
+gdouble bench_rate( gdouble, gdouble );
+
+#endif
@@ -0,0 +1,369 @@
+// binfile.c - reading and writing of the binary snapshot file format
+//             part of the mapter program
+// Copyright (C) 2020 John Davies
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <stdio.h>
+#include <string.h>
+#include <gtk/gtk.h>
+#include "main.h"
+#include "doc.h"
+#include "binfile.h"
+
+// The records are written as they are so check that there's no padding
+G_STATIC_ASSERT( sizeof( binary_header ) == 48 );
+G_STATIC_ASSERT( sizeof( binary_cell ) == 40 );
+G_STATIC_ASSERT( sizeof( binary_note ) == 32 );
+
+// --------------------------------------------------------------------------
+// binary_check_magic
+//
+// Checks if the start of a file identifies it as a binary file
+//
+// --------------------------------------------------------------------------
+
+gboolean binary_check_magic( const gchar *data, gsize length )
+{
+  return( ( length >= BINARY_MAGIC_SIZE ) &&
+          ( memcmp( data, BINARY_MAGIC, BINARY_MAGIC_SIZE ) == 0 ) );
+}
+
+// --------------------------------------------------------------------------
+// binary_text
+//
+// Points the text at a string in the file without copying it
+// Returns FALSE if the string is outside the file
+//
+// --------------------------------------------------------------------------
+
+gboolean binary_text( doc_text *text, const gchar *data, gsize size, guint64 offset, guint32 length )
+{
+  if( length == 0 )
+  {
+    // Empty so nothing to point at
+    return TRUE;
+  }
+  if( ( offset > size ) || ( length > ( size - offset ) ) )
+  {
+    g_info( "  ERROR: string out of range, Offset: %" G_GUINT64_FORMAT ", Length: %u", offset, length );
+    return FALSE;
+  }
+  text->raw = data + offset;
+  text->raw_length = length;
+  return TRUE;
+}
+
+// --------------------------------------------------------------------------
+// binary_read
+//
+// Builds a new document from a binary file
+// The file is mapped into memory and only the header and tables are read,
+// the strings are left in the mapping until they are first used
+//
+// --------------------------------------------------------------------------
+
+result_return binary_read( const gchar *file_path, mapter_doc **doc_out )
+{
+  result_return file_process = { TRUE, "" };
+  GMappedFile *mapped_file;
+  GError *error = NULL;
+
+  g_info( "binfile.c / binary_read");
+  *doc_out = NULL;
+
+  if( ( mapped_file = g_mapped_file_new( file_path, FALSE, &error ) ) == NULL )
+  {
+    g_info( "  ERROR: Could not open file for reading: %s", error->message );
+    g_error_free( error );
+    file_process.result = FALSE;
+    file_process.message = "Could not open file for reading";
+  }
+  else
+  {
+    g_info( "  Reading file: %s", file_path );
+    GBytes *source = g_mapped_file_get_bytes( mapped_file );
+    file_process = binary_read_bytes( source, doc_out );
+    g_bytes_unref( source );
+    g_mapped_file_unref( mapped_file );
+  }
+
+  g_info( "binfile.c / ~binary_read");
+  return( file_process );
+}
+
+// --------------------------------------------------------------------------
+// binary_read_bytes
+//
+// Builds a new document from a buffer holding a binary file
+// Only the header and tables are read, the strings are left in the buffer
+// until they are first used
+//
+// --------------------------------------------------------------------------
+
+result_return binary_read_bytes( GBytes *source, mapter_doc **doc_out )
+{
+  result_return file_process = { TRUE, "" };
+  binary_header header;
+  mapter_doc *doc = NULL;
+  gsize size;
+
+  g_info( "binfile.c / binary_read_bytes");
+  *doc_out = NULL;
+
+  const gchar *data = g_bytes_get_data( source, &size );
+  g_info( "  Reading %" G_GSIZE_FORMAT " bytes", size );
+
+  // Header
+  if( ( size < sizeof( header ) ) || ( binary_check_magic( data, size ) == FALSE ) )
+  {
+    g_info( "  ERROR: Binary file header not found" );
+    file_process.result = FALSE;
+    file_process.message = "Binary file header not found";
+    goto error_exit;
+  }
+  memcpy( &header, data, sizeof( header ) );
+  guint32 version = GUINT32_FROM_LE( header.version );
+  guint32 rows = GUINT32_FROM_LE( header.rows );
+  guint32 columns = GUINT32_FROM_LE( header.columns );
+  guint32 note_count = GUINT32_FROM_LE( header.note_count );
+  guint64 cell_table_offset = GUINT64_FROM_LE( header.cell_table_offset );
+  guint64 note_table_offset = GUINT64_FROM_LE( header.note_table_offset );
+  g_info( "  Version number: %u", version );
+  g_info( "  Rows: %u, Columns: %u, Notes: %u", rows, columns, note_count );
+  if( version > SAVE_FILE_VERSION_NUMBER )
+  {
+    g_info( "  ERROR: Save file version number is unsupported" );
+    file_process.result = FALSE;
+    file_process.message = "Save file version number is unsupported";
+    goto error_exit;
+  }
+  if( ( rows < MIN_GRID_ROWS ) || ( rows > G_MAXINT ) )
+  {
+    g_info( "  ERROR: Row specification too small" );
+    file_process.result = FALSE;
+    file_process.message = "Row specification too small";
+    goto error_exit;
+  }
+  if( ( columns < MIN_GRID_COLUMNS ) || ( columns > G_MAXINT ) )
+  {
+    g_info( "  ERROR: Column specification too small" );
+    file_process.result = FALSE;
+    file_process.message = "Column specification too small";
+    goto error_exit;
+  }
+  // Check that both tables are inside the file
+  guint64 cell_count = (guint64)rows * columns;
+  if( ( cell_count > ( G_MAXINT / sizeof( doc_cell ) ) ) ||
+      ( cell_table_offset > size ) ||
+      ( ( cell_count * sizeof( binary_cell ) ) > ( size - cell_table_offset ) ) ||
+      ( note_table_offset > size ) ||
+      ( ( (guint64)note_count * sizeof( binary_note ) ) > ( size - note_table_offset ) ) )
+  {
+    g_info( "  ERROR: Binary file tables out of range" );
+    file_process.result = FALSE;
+    file_process.message = "Binary file tables out of range";
+    goto error_exit;
+  }
+
+  // The document keeps the buffer as the text points into it
+  doc = doc_new( rows, columns );
+  doc->source = g_bytes_ref( source );
+
+  // Cells
+  const gchar *entry = data + cell_table_offset;
+  for( guint64 i=0; i<cell_count; i++ )
+  {
+    binary_cell cell_entry;
+    doc_cell *cell = &doc->cells[i];
+    memcpy( &cell_entry, entry, sizeof( cell_entry ) );
+    entry += sizeof( cell_entry );
+    cell->colour = GUINT32_FROM_LE( cell_entry.colour );
+    if( ( binary_text( &cell->summary, data, size,
+                       GUINT64_FROM_LE( cell_entry.summary_offset ), GUINT32_FROM_LE( cell_entry.summary_length ) ) == FALSE ) ||
+        ( binary_text( &cell->heading, data, size,
+                       GUINT64_FROM_LE( cell_entry.heading_offset ), GUINT32_FROM_LE( cell_entry.heading_length ) ) == FALSE ) ||
+        ( binary_text( &cell->body, data, size,
+                       GUINT64_FROM_LE( cell_entry.body_offset ), GUINT32_FROM_LE( cell_entry.body_length ) ) == FALSE ) )
+    {
+      file_process.result = FALSE;
+      file_process.message = "Binary file cell text out of range";
+      goto error_exit;
+    }
+  }
+
+  // Notes
+  entry = data + note_table_offset;
+  for( guint32 i=0; i<note_count; i++ )
+  {
+    binary_note note_entry;
+    doc_note note = { 0, { NULL, NULL, 0, FALSE }, { NULL, NULL, 0, FALSE }, 0 };
+    memcpy( &note_entry, entry, sizeof( note_entry ) );
+    entry += sizeof( note_entry );
+    note.level = MIN( GUINT32_FROM_LE( note_entry.level ), G_MAXINT );
+    if( ( binary_text( &note.heading, data, size,
+                       GUINT64_FROM_LE( note_entry.heading_offset ), GUINT32_FROM_LE( note_entry.heading_length ) ) == FALSE ) ||
+        ( binary_text( &note.text, data, size,
+                       GUINT64_FROM_LE( note_entry.text_offset ), GUINT32_FROM_LE( note_entry.text_length ) ) == FALSE ) )
+    {
+      file_process.result = FALSE;
+      file_process.message = "Binary file note text out of range";
+      goto error_exit;
+    }
+    g_array_append_val( doc->notes, note );
+  }
+
+  // Hand the document over
+  *doc_out = doc;
+  doc = NULL;
+
+  error_exit: // Destination if an error was found during the file reading
+  doc_free( doc );
+
+  g_info( "binfile.c / ~binary_read_bytes");
+  return( file_process );
+}
+
+// --------------------------------------------------------------------------
+// binary_place_text
+//
+// Works out the length of a text entry and where it will be in the file
+// Returns FALSE if the text is too long for the file format
+//
+// --------------------------------------------------------------------------
+
+gboolean binary_place_text( doc_text *text, guint64 *offset, guint32 *length_le, guint64 *offset_le )
+{
+  gsize length;
+  doc_text_peek( text, &length );
+  if( length > G_MAXUINT32 )
+  {
+    g_info( "  ERROR: text too long for binary file ( %" G_GSIZE_FORMAT " bytes )", length );
+    return FALSE;
+  }
+  *length_le = GUINT32_TO_LE( (guint32)length );
+  *offset_le = GUINT64_TO_LE( *offset );
+  // Allow for the zero terminator
+  *offset += length + 1;
+  return TRUE;
+}
+
+// --------------------------------------------------------------------------
+// binary_write_text
+//
+// Writes a single text entry followed by its zero terminator
+//
+// --------------------------------------------------------------------------
+
+gboolean binary_write_text( FILE *output_file, doc_text *text )
+{
+  gsize length;
+  const gchar *str = doc_text_peek( text, &length );
+  return( ( fwrite( str, 1, length, output_file ) == length ) &&
+          ( fputc( '\0', output_file ) != EOF ) );
+}
+
+// --------------------------------------------------------------------------
+// binary_write
+//
+// Writes the document to the specified file in the binary format
+// The tables are worked out first so that the file is written in a single
+// forward pass
+//
+// --------------------------------------------------------------------------
+
+result_return binary_write( FILE *output_file, mapter_doc *doc )
+{
+  result_return file_process = { TRUE, "" };
+  binary_header header;
+  gint cell_count = doc->rows * doc->columns;
+  guint note_count = doc->notes->len;
+  binary_cell *cell_table = g_new0( binary_cell, cell_count );
+  binary_note *note_table = g_new0( binary_note, note_count );
+
+  g_info( "binfile.c / binary_write");
+  // Work out where everything goes, the strings start after the tables
+  guint64 cell_table_offset = sizeof( binary_header );
+  guint64 note_table_offset = cell_table_offset + ( (guint64)cell_count * sizeof( binary_cell ) );
+  guint64 offset = note_table_offset + ( (guint64)note_count * sizeof( binary_note ) );
+  for( gint i=0; i<cell_count; i++ )
+  {
+    doc_cell *cell = &doc->cells[i];
+    cell_table[i].colour = GUINT32_TO_LE( cell->colour );
+    if( ( binary_place_text( &cell->summary, &offset, &cell_table[i].summary_length, &cell_table[i].summary_offset ) == FALSE ) ||
+        ( binary_place_text( &cell->heading, &offset, &cell_table[i].heading_length, &cell_table[i].heading_offset ) == FALSE ) ||
+        ( binary_place_text( &cell->body, &offset, &cell_table[i].body_length, &cell_table[i].body_offset ) == FALSE ) )
+    {
+      file_process.result = FALSE;
+      file_process.message = "Text too long for binary file";
+      goto error_exit;
+    }
+  }
+  for( guint i=0; i<note_count; i++ )
+  {
+    doc_note *note = &g_array_index( doc->notes, doc_note, i );
+    note_table[i].level = GUINT32_TO_LE( MAX( note->level, 0 ) );
+    if( ( binary_place_text( &note->heading, &offset, &note_table[i].heading_length, &note_table[i].heading_offset ) == FALSE ) ||
+        ( binary_place_text( &note->text, &offset, &note_table[i].text_length, &note_table[i].text_offset ) == FALSE ) )
+    {
+      file_process.result = FALSE;
+      file_process.message = "Text too long for binary file";
+      goto error_exit;
+    }
+  }
+
+  // Header
+  memset( &header, 0, sizeof( header ) );
+  memcpy( header.magic, BINARY_MAGIC, BINARY_MAGIC_SIZE );
+  header.version = GUINT32_TO_LE( SAVE_FILE_VERSION_NUMBER );
+  header.rows = GUINT32_TO_LE( doc->rows );
+  header.columns = GUINT32_TO_LE( doc->columns );
+  header.note_count = GUINT32_TO_LE( note_count );
+  header.cell_table_offset = GUINT64_TO_LE( cell_table_offset );
+  header.note_table_offset = GUINT64_TO_LE( note_table_offset );
+  header.file_size = GUINT64_TO_LE( offset );
+  g_info( "  Rows: %d, Columns: %d, Notes: %u, Size: %" G_GUINT64_FORMAT, doc->rows, doc->columns, note_count, offset );
+
+  // Now write it all out in order
+  gboolean ok = ( fwrite( &header, sizeof( header ), 1, output_file ) == 1 ) &&
+                ( fwrite( cell_table, sizeof( binary_cell ), cell_count, output_file ) == (gsize)cell_count ) &&
+                ( ( note_count == 0 ) ||
+                  ( fwrite( note_table, sizeof( binary_note ), note_count, output_file ) == note_count ) );
+  for( gint i=0; ( ok == TRUE ) && ( i<cell_count ); i++ )
+  {
+    doc_cell *cell = &doc->cells[i];
+    ok = binary_write_text( output_file, &cell->summary ) &&
+         binary_write_text( output_file, &cell->heading ) &&
+         binary_write_text( output_file, &cell->body );
+  }
+  for( guint i=0; ( ok == TRUE ) && ( i<note_count ); i++ )
+  {
+    doc_note *note = &g_array_index( doc->notes, doc_note, i );
+    ok = binary_write_text( output_file, &note->heading ) &&
+         binary_write_text( output_file, &note->text );
+  }
+  if( ok == FALSE )
+  {
+    g_info( "  ERROR: Binary file write failed" );
+    file_process.result = FALSE;
+    file_process.message = "Binary file write failed";
+  }
+
+  error_exit: // Destination if an error was found while laying out the file
+  g_free( cell_table );
+  g_free( note_table );
+
+  g_info( "binfile.c / ~binary_write");
+  return( file_process );
+}
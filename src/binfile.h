@@ -0,0 +1,72 @@
+// binfile.h - header file for binfile.c
+//             part of the mapter program
+// Copyright (C) 2020 John Davies
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef BINFILE_H
+#define BINFILE_H
+
+// Binary file identification
+#define BINARY_MAGIC "MAPTERB"      // Stored with the terminating zero
+#define BINARY_MAGIC_SIZE 8
+#define BINARY_EXTENSION ".mapterb"
+
+// Layout of the binary file, all values are little endian
+//
+//  header
+//  cell table    - rows * columns entries in row order
+//  note table    - note_count entries in depth first order
+//  strings       - each one is followed by a zero byte which isn't
+//                  included in the length
+//
+// Offsets are from the start of the file so a single cell can be read
+// without reading anything else
+
+typedef struct {
+  gchar magic[ BINARY_MAGIC_SIZE ];
+  guint32 version;              // SAVE_FILE_VERSION_NUMBER when written
+  guint32 rows;
+  guint32 columns;
+  guint32 note_count;
+  guint64 cell_table_offset;
+  guint64 note_table_offset;
+  guint64 file_size;
+} binary_header;
+
+typedef struct {
+  guint32 colour;
+  guint32 summary_length;
+  guint32 heading_length;
+  guint32 body_length;
+  guint64 summary_offset;
+  guint64 heading_offset;
+  guint64 body_offset;
+} binary_cell;
+
+typedef struct {
+  guint32 level;
+  guint32 heading_length;
+  guint32 text_length;
+  guint32 reserved;
+  guint64 heading_offset;
+  guint64 text_offset;
+} binary_note;
+
+gboolean binary_check_magic( const gchar *, gsize );
+result_return binary_read( const gchar *, mapter_doc ** );
+result_return binary_read_bytes( GBytes *, mapter_doc ** );
+result_return binary_write( FILE *, mapter_doc * );
+
+#endif
@@ -0,0 +1,458 @@
+// check.c - headless checking of mapter files from the command line
+//           part of the mapter program
+// Copyright (C) 2020 John Davies
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <gtk/gtk.h>
+#include "main.h"
+#include "doc.h"
+#include "file.h"
+#include "binfile.h"
+#include "compress.h"
+#include "config.h"
+#include "json.h"
+#include "check.h"
+
+// Descriptions of the json_parse_ex errors, in json_parse_error_e order
+const gchar *check_parse_errors[] = {
+  "no error",
+  "expected a comma or a closing bracket",
+  "expected a colon",
+  "expected an opening quote",
+  "invalid string escape sequence",
+  "invalid number format",
+  "invalid value",
+  "unexpected end of file",
+  "invalid string",
+  "out of memory",
+  "unexpected characters after the end of the file",
+  "unknown error"
+};
+
+// --------------------------------------------------------------------------
+// check_files
+//
+// Entry point for the --check option, none of GTK is used
+// The files are checked in parallel but reported in the order given
+//
+// --------------------------------------------------------------------------
+
+gint check_files( gint count, gchar **file_paths )
+{
+  gint status = CHECK_VALID;
+
+  g_info( "check.c / check_files");
+  if( count == 0 )
+  {
+    fprintf( stderr, "Usage: %s %s FILE...\n", APP_NAME, CHECK_OPTION );
+    return CHECK_ERROR;
+  }
+  check_job *jobs = g_new0( check_job, count );
+  GThreadPool *pool = g_thread_pool_new( check_worker, NULL, g_get_num_processors(), FALSE, NULL );
+  for( gint i=0; i<count; i++ )
+  {
+    jobs[i].file_path = file_paths[i];
+    jobs[i].report = g_string_new( NULL );
+    g_thread_pool_push( pool, &jobs[i], NULL );
+  }
+  // Wait for them all to finish
+  g_thread_pool_free( pool, FALSE, TRUE );
+
+  for( gint i=0; i<count; i++ )
+  {
+    if( jobs[i].status == CHECK_VALID )
+    {
+      printf( "%s: OK\n", jobs[i].file_path );
+    }
+    else
+    {
+      fputs( jobs[i].report->str, stderr );
+    }
+    status = MAX( status, jobs[i].status );
+    g_string_free( jobs[i].report, TRUE );
+  }
+  g_free( jobs );
+
+  g_info( "check.c / ~check_files");
+  return status;
+}
+
+// --------------------------------------------------------------------------
+// check_worker
+//
+// Thread pool function to check a single file
+//
+// --------------------------------------------------------------------------
+
+void check_worker( gpointer data, gpointer user_data )
+{
+  check_job *job = (check_job *) data;
+  job->status = check_file( job->file_path, job->report );
+}
+
+// --------------------------------------------------------------------------
+// check_file
+//
+// Checks a single file of any of the supported formats
+// Any problems are added to the report
+//
+// --------------------------------------------------------------------------
+
+gint check_file( const gchar *file_path, GString *report )
+{
+  gchar *contents;
+  gsize length;
+  GError *error = NULL;
+  GBytes *source = NULL;
+  mapter_doc *doc = NULL;
+  gint status;
+
+  g_info( "check.c / check_file");
+  g_info( "  Checking: %s", file_path );
+  if( g_file_get_contents( file_path, &contents, &length, &error ) == FALSE )
+  {
+    g_string_append_printf( report, "%s: %s\n", file_path, error->message );
+    g_error_free( error );
+    return CHECK_ERROR;
+  }
+  source = g_bytes_new_take( contents, length );
+  if( compress_check_magic( contents, length ) == TRUE )
+  {
+    g_bytes_unref( source );
+    result_return result = compress_read( file_path, &source );
+    if( result.result == FALSE )
+    {
+      g_string_append_printf( report, "%s: %s\n", file_path, result.message );
+      return CHECK_INVALID;
+    }
+    contents = (gchar *) g_bytes_get_data( source, &length );
+    // Don't include the zero terminator
+    length--;
+  }
+
+  if( compress_check_zstd_magic( contents, length ) == TRUE )
+  {
+    g_string_append_printf( report, "%s: zstd compressed files are not supported\n", file_path );
+    status = CHECK_INVALID;
+  }
+  else if( binary_check_magic( contents, length ) == TRUE )
+  {
+    // The binary reader checks everything as it goes
+    result_return result = binary_read_bytes( source, &doc );
+    if( result.result == FALSE )
+    {
+      g_string_append_printf( report, "%s: %s\n", file_path, result.message );
+      status = CHECK_INVALID;
+    }
+    else
+    {
+      status = CHECK_VALID;
+    }
+    doc_free( doc );
+  }
+  else
+  {
+    status = check_json( file_path, contents, length, report );
+  }
+  g_bytes_unref( source );
+
+  g_info( "check.c / ~check_file");
+  return status;
+}
+
+// --------------------------------------------------------------------------
+// check_problem
+//
+// Adds a problem to the report along with where it is in the file
+//
+// --------------------------------------------------------------------------
+
+void check_problem( GString *report, const gchar *file_path, struct json_value_s *value, const gchar *format, ... )
+{
+  va_list args;
+  if( value != NULL )
+  {
+    struct json_value_ex_s *location = (struct json_value_ex_s *) value;
+    g_string_append_printf( report, "%s:%zu:%zu: ", file_path, location->line_no, location->row_no );
+  }
+  else
+  {
+    g_string_append_printf( report, "%s: ", file_path );
+  }
+  va_start( args, format );
+  g_string_append_vprintf( report, format, args );
+  va_end( args );
+  g_string_append_c( report, '\n' );
+}
+
+// --------------------------------------------------------------------------
+// check_int
+//
+// Checks that the value is a whole number and returns it
+//
+// --------------------------------------------------------------------------
+
+gboolean check_int( struct json_value_s *value, gint *result )
+{
+  struct json_number_s *number = json_value_as_number( value );
+  if( ( number == NULL ) || ( strpbrk( number->number, ".eE" ) != NULL ) )
+  {
+    return FALSE;
+  }
+  *result = atoi( number->number );
+  return TRUE;
+}
+
+// --------------------------------------------------------------------------
+// check_json
+//
+// Parses a JSON mapter file and checks its contents
+//
+// --------------------------------------------------------------------------
+
+gint check_json( const gchar *file_path, const gchar *json_string, gsize json_length, GString *report )
+{
+  struct json_parse_result_s parse_result;
+  struct json_object_s *json_data_object;
+  struct json_object_element_s *element;
+  struct json_value_s *grid = NULL;
+  gint rows = -1;
+  gint columns = -1;
+  gint version_no;
+  gboolean valid = TRUE;
+
+  struct json_value_s *json_data_root = json_parse_ex( json_string, json_length,
+                                                       json_parse_flags_allow_location_information,
+                                                       NULL, NULL, &parse_result );
+  if( json_data_root == NULL )
+  {
+    g_string_append_printf( report, "%s:%zu:%zu: %s ( offset %zu )\n",
+                            file_path, parse_result.error_line_no, parse_result.error_row_no,
+                            check_parse_errors[ MIN( parse_result.error, (gsize)json_parse_error_unknown ) ],
+                            parse_result.error_offset );
+    return CHECK_INVALID;
+  }
+  if( ( json_data_object = json_value_as_object( json_data_root ) ) == NULL )
+  {
+    check_problem( report, file_path, json_data_root, "top level is not an object" );
+    free( json_data_root );
+    return CHECK_INVALID;
+  }
+
+  for( element = json_data_object->start; element != NULL; element = element->next )
+  {
+    const gchar *name = element->name->string;
+    if( strcmp( name, VERSION ) == 0 )
+    {
+      if( check_int( element->value, &version_no ) == FALSE )
+      {
+        check_problem( report, file_path, element->value, "\"%s\" is not a whole number", name );
+        valid = FALSE;
+      }
+      else if( version_no > SAVE_FILE_VERSION_NUMBER )
+      {
+        check_problem( report, file_path, element->value, "version %d is newer than the supported version %d",
+                       version_no, SAVE_FILE_VERSION_NUMBER );
+        valid = FALSE;
+      }
+    }
+    else if( ( strcmp( name, ROWS ) == 0 ) || ( strcmp( name, COLUMNS ) == 0 ) )
+    {
+      gint *size = ( strcmp( name, ROWS ) == 0 ) ? &rows : &columns;
+      gint minimum = ( strcmp( name, ROWS ) == 0 ) ? MIN_GRID_ROWS : MIN_GRID_COLUMNS;
+      if( check_int( element->value, size ) == FALSE )
+      {
+        check_problem( report, file_path, element->value, "\"%s\" is not a whole number", name );
+        valid = FALSE;
+      }
+      else if( *size < minimum )
+      {
+        check_problem( report, file_path, element->value, "\"%s\" is %d, the minimum is %d", name, *size, minimum );
+        valid = FALSE;
+      }
+      if( grid != NULL )
+      {
+        check_problem( report, file_path, element->value, "\"%s\" must come before \"%s\"", name, TEXT_GRID );
+        valid = FALSE;
+      }
+    }
+    else if( strcmp( name, TEXT_GRID ) == 0 )
+    {
+      struct json_array_s *array = json_value_as_array( element->value );
+      grid = element->value;
+      if( array == NULL )
+      {
+        check_problem( report, file_path, element->value, "\"%s\" is not an array", name );
+        valid = FALSE;
+        continue;
+      }
+      if( ( rows > 0 ) && ( columns > 0 ) && ( array->length != (gsize)rows * columns ) )
+      {
+        check_problem( report, file_path, element->value,
+                       "\"%s\" has %zu cells but rows * columns is %d * %d = %d",
+                       name, array->length, rows, columns, rows * columns );
+        valid = FALSE;
+      }
+      for( struct json_array_element_s *cell = array->start; cell != NULL; cell = cell->next )
+      {
+        valid &= check_cell( file_path, cell->value, report );
+      }
+    }
+    else if( strcmp( name, TREE_NOTES ) == 0 )
+    {
+      valid &= check_notes( file_path, element->value, report );
+    }
+    else if( strcmp( name, GENERAL_NOTES ) == 0 )
+    {
+      if( json_value_as_string( element->value ) == NULL )
+      {
+        check_problem( report, file_path, element->value, "\"%s\" is not a string", name );
+        valid = FALSE;
+      }
+    }
+    else
+    {
+      // Not an error as it's ignored when the file is opened
+      g_info( "  Unknown entry: %s", name );
+    }
+  }
+  if( ( rows < 0 ) || ( columns < 0 ) || ( grid == NULL ) )
+  {
+    check_problem( report, file_path, NULL, "\"%s\", \"%s\" and \"%s\" are all needed", ROWS, COLUMNS, TEXT_GRID );
+    valid = FALSE;
+  }
+  free( json_data_root );
+
+  return( valid ? CHECK_VALID : CHECK_INVALID );
+}
+
+// --------------------------------------------------------------------------
+// check_cell
+//
+// Checks a single entry of the text grid
+//
+// --------------------------------------------------------------------------
+
+gboolean check_cell( const gchar *file_path, struct json_value_s *value, GString *report )
+{
+  gboolean valid = TRUE;
+  gint colour;
+  struct json_object_s *object = json_value_as_object( value );
+  if( object == NULL )
+  {
+    check_problem( report, file_path, value, "cell is not an object" );
+    return FALSE;
+  }
+  for( struct json_object_element_s *element = object->start; element != NULL; element = element->next )
+  {
+    const gchar *name = element->name->string;
+    if( strcmp( name, CELL_BACKGROUND_COLOUR ) == 0 )
+    {
+      if( ( check_int( element->value, &colour ) == FALSE ) || ( colour < NONE ) || ( colour > NEUTRAL ) )
+      {
+        check_problem( report, file_path, element->value, "\"%s\" is not a number from %d to %d", name, NONE, NEUTRAL );
+        valid = FALSE;
+      }
+    }
+    else if( ( strcmp( name, TEXT_SUMMARY ) == 0 ) ||
+             ( strcmp( name, TEXT_HEADING ) == 0 ) ||
+             ( strcmp( name, TEXT_BODY ) == 0 ) )
+    {
+      if( json_value_as_string( element->value ) == NULL )
+      {
+        check_problem( report, file_path, element->value, "\"%s\" is not a string", name );
+        valid = FALSE;
+      }
+    }
+    else
+    {
+      g_info( "  Unknown cell entry: %s", name );
+    }
+  }
+  return valid;
+}
+
+// --------------------------------------------------------------------------
+// check_notes
+//
+// Checks the notes tree, each entry must have an index, heading and text in
+// that order and the index can only be one level below the previous one
+//
+// --------------------------------------------------------------------------
+
+gboolean check_notes( const gchar *file_path, struct json_value_s *value, GString *report )
+{
+  const gchar *names[3] = { TREE_INDEX, TREE_HEADING, TREE_TEXT };
+  gint previous_level = -1;
+  struct json_array_s *array = json_value_as_array( value );
+  if( array == NULL )
+  {
+    check_problem( report, file_path, value, "\"%s\" is not an array", TREE_NOTES );
+    return FALSE;
+  }
+  for( struct json_array_element_s *note = array->start; note != NULL; note = note->next )
+  {
+    struct json_object_s *object = json_value_as_object( note->value );
+    struct json_object_element_s *element = ( object != NULL ) ? object->start : NULL;
+    const gchar *index = NULL;
+    for( gint i=0; i<3; i++ )
+    {
+      struct json_string_s *string;
+      if( ( element == NULL ) || ( strcmp( element->name->string, names[i] ) != 0 ) ||
+          ( ( string = json_value_as_string( element->value ) ) == NULL ) )
+      {
+        // The rest of the notes are dropped when the file is opened
+        check_problem( report, file_path, note->value, "note must have \"%s\", \"%s\" and \"%s\" strings in that order",
+                       TREE_INDEX, TREE_HEADING, TREE_TEXT );
+        return FALSE;
+      }
+      if( i == 0 )
+      {
+        index = string->string;
+      }
+      element = element->next;
+    }
+    if( element != NULL )
+    {
+      check_problem( report, file_path, note->value, "note has extra entries" );
+      return FALSE;
+    }
+    // The index is a list of numbers separated by ':'
+    gint level = 0;
+    for( const gchar *ptr = index; *ptr != '\0'; ptr++ )
+    {
+      if( *ptr == INDEX_SEPARATOR )
+      {
+        level++;
+      }
+      else if( g_ascii_isdigit( *ptr ) == FALSE )
+      {
+        check_problem( report, file_path, note->value, "note index \"%s\" is not valid", index );
+        return FALSE;
+      }
+    }
+    if( level > previous_level + 1 )
+    {
+      check_problem( report, file_path, note->value, "note index \"%s\" skips a level", index );
+      return FALSE;
+    }
+    previous_level = level;
+  }
+  return TRUE;
+}
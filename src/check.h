@@ -0,0 +1,47 @@
+// check.h - header file for check.c
+//           part of the mapter program
+// Copyright (C) 2020 John Davies
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef CHECK_H
+#define CHECK_H
+
+// Command line option
+#define CHECK_OPTION "--check"
+
+// Exit status, the worst result from all the files is returned
+#define CHECK_VALID 0
+#define CHECK_INVALID 1
+#define CHECK_ERROR 2          // Usage error or a file that couldn't be read
+
+struct json_value_s;
+
+// A single file to be checked along with the results
+typedef struct {
+  const gchar *file_path;
+  gint status;
+  GString *report;
+} check_job;
+
+gint check_files( gint, gchar ** );
+void check_worker( gpointer, gpointer );
+gint check_file( const gchar *, GString * );
+gint check_json( const gchar *, const gchar *, gsize, GString * );
+void check_problem( GString *, const gchar *, struct json_value_s *, const gchar *, ... ) G_GNUC_PRINTF( 4, 5 );
+gboolean check_int( struct json_value_s *, gint * );
+gboolean check_cell( const gchar *, struct json_value_s *, GString * );
+gboolean check_notes( const gchar *, struct json_value_s *, GString * );
+
+#endif
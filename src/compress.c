@@ -0,0 +1,171 @@
+// compress.c - reading and writing of gzip compressed mapter files
+//              part of the mapter program
+// Copyright (C) 2020 John Davies
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Needed for fopencookie
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <gtk/gtk.h>
+#include "main.h"
+#include "compress.h"
+
+// --------------------------------------------------------------------------
+// compress_check_magic
+//
+// Checks if the start of a file identifies it as gzip compressed
+//
+// --------------------------------------------------------------------------
+
+gboolean compress_check_magic( const gchar *data, gsize length )
+{
+  return( ( length >= GZIP_MAGIC_SIZE ) &&
+          ( memcmp( data, GZIP_MAGIC, GZIP_MAGIC_SIZE ) == 0 ) );
+}
+
+// --------------------------------------------------------------------------
+// compress_check_zstd_magic
+//
+// Checks if the start of a file identifies it as zstd compressed, these
+// are recognised so that a sensible error can be given
+//
+// --------------------------------------------------------------------------
+
+gboolean compress_check_zstd_magic( const gchar *data, gsize length )
+{
+  return( ( length >= ZSTD_MAGIC_SIZE ) &&
+          ( memcmp( data, ZSTD_MAGIC, ZSTD_MAGIC_SIZE ) == 0 ) );
+}
+
+// --------------------------------------------------------------------------
+// compress_read
+//
+// Decompresses a complete gzip file into memory
+// The buffer returned is zero terminated and the terminator is included
+// in its length
+//
+// --------------------------------------------------------------------------
+
+result_return compress_read( const gchar *file_path, GBytes **contents )
+{
+  result_return file_process = { TRUE, "" };
+  gchar chunk[ COMPRESS_BUFFER_SIZE ];
+  gint bytes_read;
+
+  g_info( "compress.c / compress_read");
+  *contents = NULL;
+  gzFile input_file = gzopen( file_path, "rb" );
+  if( input_file == NULL )
+  {
+    g_info( "  ERROR: Could not open file for reading" );
+    file_process.result = FALSE;
+    file_process.message = "Could not open file for reading";
+    return( file_process );
+  }
+  gzbuffer( input_file, COMPRESS_BUFFER_SIZE );
+  GByteArray *buffer = g_byte_array_sized_new( COMPRESS_BUFFER_SIZE );
+  while( ( bytes_read = gzread( input_file, chunk, sizeof( chunk ) ) ) > 0 )
+  {
+    g_byte_array_append( buffer, (guint8 *) chunk, bytes_read );
+  }
+  if( bytes_read < 0 )
+  {
+    gint error_number;
+    g_info( "  ERROR: Compressed file could not be read: %s", gzerror( input_file, &error_number ) );
+    file_process.result = FALSE;
+    file_process.message = "Compressed file could not be read";
+    g_byte_array_free( buffer, TRUE );
+  }
+  else
+  {
+    g_info( "  Decompressed %u bytes", buffer->len );
+    // Zero terminate
+    g_byte_array_append( buffer, (guint8 *) "", 1 );
+    *contents = g_byte_array_free_to_bytes( buffer );
+  }
+  gzclose( input_file );
+
+  g_info( "compress.c / ~compress_read");
+  return( file_process );
+}
+
+// --------------------------------------------------------------------------
+// compress_cookie_write
+//
+// Stream write function, compresses the data as it's written
+//
+// --------------------------------------------------------------------------
+
+ssize_t compress_cookie_write( void *cookie, const char *data, size_t size )
+{
+  if( size == 0 )
+  {
+    return 0;
+  }
+  gint written = gzwrite( (gzFile) cookie, data, size );
+  // Any error is reported as nothing being written
+  return( ( written > 0 ) ? written : -1 );
+}
+
+// --------------------------------------------------------------------------
+// compress_cookie_close
+//
+// Stream close function, flushes the compressor and closes the file
+//
+// --------------------------------------------------------------------------
+
+int compress_cookie_close( void *cookie )
+{
+  return( ( gzclose( (gzFile) cookie ) == Z_OK ) ? 0 : EOF );
+}
+
+// --------------------------------------------------------------------------
+// compress_open_write
+//
+// Opens a stream on a file descriptor with everything written to it being
+// compressed on the way through, so the whole file never needs to be in
+// memory. The descriptor is closed if the stream can't be opened
+// The stream must be closed with fclose and the result checked as that's
+// when any final write errors show up
+//
+// --------------------------------------------------------------------------
+
+FILE *compress_open_write( gint fd )
+{
+  cookie_io_functions_t functions = { NULL, compress_cookie_write, NULL, compress_cookie_close };
+
+  g_info( "compress.c / compress_open_write");
+  FILE *output_file = NULL;
+  gzFile compressed_file = gzdopen( fd, GZIP_LEVEL );
+  if( compressed_file != NULL )
+  {
+    gzbuffer( compressed_file, COMPRESS_BUFFER_SIZE );
+    output_file = fopencookie( compressed_file, "w", functions );
+    if( output_file == NULL )
+    {
+      gzclose( compressed_file );
+    }
+  }
+  else
+  {
+    close( fd );
+  }
+  g_info( "compress.c / ~compress_open_write");
+  return output_file;
+}
@@ -0,0 +1,36 @@
+// compress.h - header file for compress.c
+//              part of the mapter program
+// Copyright (C) 2020 John Davies
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+// Compressed file identification
+#define GZIP_EXTENSION ".gz"
+#define GZIP_MAGIC "\x1f\x8b"
+#define GZIP_MAGIC_SIZE 2
+#define ZSTD_MAGIC "\x28\xb5\x2f\xfd"
+#define ZSTD_MAGIC_SIZE 4
+
+#define GZIP_LEVEL "wb6"                 // zlib mode string for saving
+#define COMPRESS_BUFFER_SIZE ( 128 * 1024 )
+
+gboolean compress_check_magic( const gchar *, gsize );
+gboolean compress_check_zstd_magic( const gchar *, gsize );
+result_return compress_read( const gchar *, GBytes ** );
+FILE *compress_open_write( gint );
+
+#endif
@@ -21,13 +21,19 @@
 #include <errno.h>
 #include <gtk/gtk.h>
 #include "main.h"
+#include "doc.h"
 #include "config.h"
+#include "file.h"
 
 // Storage for window geometries
 
 window_geometry main_window_cache = {-1, -1, FALSE };
 window_geometry editor_window_cache = {-1, -1, FALSE };
 
+// Storage for save settings
+
+save_settings save_settings_cache = { DEFAULT_KEEP_BACKUP, DEFAULT_BACKUPS, DEFAULT_USE_JOURNAL, DEFAULT_AUTOSAVE_INTERVAL };
+
 // --------------------------------------------------------------------------
 // on_window_main_destroy
 //
@@ -38,6 +44,9 @@ window_geometry editor_window_cache = {-1, -1, FALSE };
 void on_window_main_destroy( app_widgets *app_wdgts )
 {
   g_info( "config.c / on_window_main_destroy");
+  // Only the journal is folded into the file after the main loop, so
+  // anything it doesn't hold has to be saved while the widgets are here
+  save_unjournalled( app_wdgts );
   save_config( app_wdgts );
   gtk_main_quit();
   g_info( "config.c / ~on_window_main_destroy");
@@ -122,6 +131,11 @@ gboolean save_config( app_widgets *app_wdgts )
   g_key_file_set_integer (keyfile, EDITOR_WINDOW_GROUP, EDITOR_WINDOW_WIDTH, editor_window_cache.current_width);
   g_key_file_set_integer (keyfile, EDITOR_WINDOW_GROUP, EDITOR_WINDOW_HEIGHT, editor_window_cache.current_height);
   g_key_file_set_boolean (keyfile, EDITOR_WINDOW_GROUP, EDITOR_WINDOW_ISMAX, editor_window_cache.is_maximized);
+  // Saving
+  g_key_file_set_boolean (keyfile, SAVE_GROUP, SAVE_KEEP_BACKUP, save_settings_cache.keep_backup);
+  g_key_file_set_integer (keyfile, SAVE_GROUP, SAVE_BACKUPS, save_settings_cache.backups);
+  g_key_file_set_boolean (keyfile, SAVE_GROUP, SAVE_USE_JOURNAL, save_settings_cache.use_journal);
+  g_key_file_set_integer (keyfile, SAVE_GROUP, SAVE_AUTOSAVE_INTERVAL, save_settings_cache.autosave_interval);
 
   // Check that the destination exists
   gint dir = mkdir( g_build_filename( g_get_user_cache_dir(), APP_NAME, NULL ), APP_CACHE_PERMISSIONS );
@@ -209,6 +223,24 @@ gboolean load_config( app_widgets *app_wdgts )
     {
       gtk_window_maximize( GTK_WINDOW( app_wdgts->w_editor_window ) );
     }
+
+    // Saving, older key files won't have these so keep the defaults
+    if( g_key_file_has_key( keyfile, SAVE_GROUP, SAVE_KEEP_BACKUP, NULL ) == TRUE )
+    {
+      save_settings_cache.keep_backup = g_key_file_get_boolean( keyfile, SAVE_GROUP, SAVE_KEEP_BACKUP, NULL );
+    }
+    if( g_key_file_has_key( keyfile, SAVE_GROUP, SAVE_BACKUPS, NULL ) == TRUE )
+    {
+      save_settings_cache.backups = CLAMP( g_key_file_get_integer( keyfile, SAVE_GROUP, SAVE_BACKUPS, NULL ), 0, MAX_BACKUPS );
+    }
+    if( g_key_file_has_key( keyfile, SAVE_GROUP, SAVE_USE_JOURNAL, NULL ) == TRUE )
+    {
+      save_settings_cache.use_journal = g_key_file_get_boolean( keyfile, SAVE_GROUP, SAVE_USE_JOURNAL, NULL );
+    }
+    if( g_key_file_has_key( keyfile, SAVE_GROUP, SAVE_AUTOSAVE_INTERVAL, NULL ) == TRUE )
+    {
+      save_settings_cache.autosave_interval = MAX( 0, g_key_file_get_integer( keyfile, SAVE_GROUP, SAVE_AUTOSAVE_INTERVAL, NULL ) );
+    }
   }
   else
   {
@@ -219,3 +251,15 @@ gboolean load_config( app_widgets *app_wdgts )
   g_info( "config.c / ~load_config");
   return result;
 }
+
+// --------------------------------------------------------------------------
+// config_backups
+//
+// Returns how many previous versions of a file to keep when it's saved
+//
+// --------------------------------------------------------------------------
+
+gint config_backups( void )
+{
+  return( ( save_settings_cache.keep_backup == TRUE ) ? save_settings_cache.backups : 0 );
+}
@@ -25,8 +25,17 @@ typedef struct
     gboolean is_maximized;
 } window_geometry;
 
+typedef struct
+{
+    gboolean keep_backup;
+    gint backups;                   // Previous versions kept when keep_backup is set
+    gboolean use_journal;
+    gint autosave_interval;         // Seconds, 0 to turn off autosave
+} save_settings;
+
 extern window_geometry main_window_cache;
 extern window_geometry editor_window_cache;
+extern save_settings save_settings_cache;
 
 // File paths etc
 #define APP_NAME "mapter"
@@ -42,11 +51,24 @@ extern window_geometry editor_window_cache;
 #define EDITOR_WINDOW_WIDTH "width"
 #define EDITOR_WINDOW_HEIGHT "height"
 #define EDITOR_WINDOW_ISMAX "is_max"
+#define SAVE_GROUP "save"
+#define SAVE_KEEP_BACKUP "keep_backup"
+#define SAVE_USE_JOURNAL "use_journal"
+#define SAVE_AUTOSAVE_INTERVAL "autosave_interval"
+#define SAVE_BACKUPS "backups"
+
+// Defaults for settings that aren't in the key file
+#define DEFAULT_KEEP_BACKUP TRUE
+#define DEFAULT_USE_JOURNAL FALSE
+#define DEFAULT_AUTOSAVE_INTERVAL 60
+#define DEFAULT_BACKUPS 1
+#define MAX_BACKUPS 99
 
 void on_window_main_destroy( app_widgets * );
 void on_window_main_size_allocate( GtkWidget *, GtkAllocation *, app_widgets * );
 
 gboolean load_config( app_widgets * );
 gboolean save_config( app_widgets * );
+gint config_backups( void );
 
 #endif
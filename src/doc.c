@@ -0,0 +1,1920 @@
+// doc.c - the document model that holds the grid cells and the notes
+//         along with the reading and writing of the JSON file format
+// Copyright (C) 2020 John Davies
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gtk/gtk.h>
+#include "main.h"
+#include "doc.h"
+#include "file.h"
+#include "writer.h"
+#include "json.h"
+
+// --------------------------------------------------------------------------
+// doc_note_clear
+//
+// Frees the memory used by a single note
+// Used as the clear function of the notes array
+//
+// --------------------------------------------------------------------------
+
+void doc_note_clear( gpointer element )
+{
+  doc_note *note = (doc_note *) element;
+  doc_text_clear( &note->heading );
+  doc_text_clear( &note->text );
+}
+
+// --------------------------------------------------------------------------
+// doc_cell_clear
+//
+// Frees the memory used by a single cell
+//
+// --------------------------------------------------------------------------
+
+void doc_cell_clear( doc_cell *cell )
+{
+  doc_text_clear( &cell->summary );
+  doc_text_clear( &cell->heading );
+  doc_text_clear( &cell->body );
+  cell->colour = NONE;
+}
+
+// --------------------------------------------------------------------------
+// doc_new
+//
+// Creates a new blank document of the specified size
+//
+// --------------------------------------------------------------------------
+
+mapter_doc *doc_new( gint rows, gint columns )
+{
+  g_info( "doc.c / doc_new");
+  g_info( "  Rows: %d, Columns: %d", rows, columns );
+  mapter_doc *doc = g_slice_new0( mapter_doc );
+  doc->rows = rows;
+  doc->columns = columns;
+  // Zero filled cells are blank with no background colour
+  doc->cells = g_new0( doc_cell, rows * columns );
+  doc->notes = g_array_new( FALSE, TRUE, sizeof( doc_note ) );
+  g_array_set_clear_func( doc->notes, doc_note_clear );
+  doc->source = NULL;
+  g_info( "doc.c / ~doc_new");
+  return doc;
+}
+
+// --------------------------------------------------------------------------
+// doc_free
+//
+// Frees a document and everything that it holds
+//
+// --------------------------------------------------------------------------
+
+void doc_free( mapter_doc *doc )
+{
+  g_info( "doc.c / doc_free");
+  if( doc != NULL )
+  {
+    for( gint i=0; i<( doc->rows * doc->columns ); i++ )
+    {
+      doc_cell_clear( &doc->cells[i] );
+    }
+    g_free( doc->cells );
+    g_array_free( doc->notes, TRUE );
+    // Release the source buffer last as raw text may point into it
+    if( doc->source != NULL )
+    {
+      g_bytes_unref( doc->source );
+    }
+    g_slice_free( mapter_doc, doc );
+  }
+  g_info( "doc.c / ~doc_free");
+}
+
+// --------------------------------------------------------------------------
+// doc_get_cell
+//
+// Returns the cell at the specified row and column or NULL if the
+// position is out of range
+//
+// --------------------------------------------------------------------------
+
+doc_cell *doc_get_cell( mapter_doc *doc, gint row, gint column )
+{
+  if( ( doc == NULL ) ||
+      ( row < 0 ) || ( row >= doc->rows ) ||
+      ( column < 0 ) || ( column >= doc->columns ) )
+  {
+    g_info( "  ERROR - cell out of range, Row: %d, Column: %d", row, column );
+    return NULL;
+  }
+  return &doc->cells[ ( row * doc->columns ) + column ];
+}
+
+// --------------------------------------------------------------------------
+// doc_traverse
+//
+// Sets up a traversal of the grid with either the rows or the columns as
+// the chapters and builds the table of header names, it's freed with
+// doc_traversal_clear
+//
+// --------------------------------------------------------------------------
+
+void doc_traverse( mapter_doc *doc, doc_order order, doc_traversal *traversal )
+{
+  g_info( "doc.c / doc_traverse");
+  traversal->cells = doc->cells;
+  traversal->notes = doc->notes;
+  if( order == COLUMNS_AS_CHAPTERS )
+  {
+    traversal->chapters = doc->columns;
+    traversal->sections = doc->rows;
+    traversal->chapter_step = 1;
+    traversal->section_step = doc->columns;
+  }
+  else
+  {
+    traversal->chapters = doc->rows;
+    traversal->sections = doc->columns;
+    traversal->chapter_step = doc->columns;
+    traversal->section_step = 1;
+  }
+  // One block for both tables
+  traversal->titles = g_new( doc_name, traversal->chapters + traversal->sections );
+  traversal->series = traversal->titles + traversal->chapters;
+  for( gint ch=0; ch<traversal->chapters; ch++ )
+  {
+    // Column headers usually only have a summary so fall back to that
+    doc_cell *header = doc_traversal_cell( traversal, ch, 0 );
+    doc_traversal_name( &traversal->titles[ch], &header->heading );
+    if( traversal->titles[ch].length == 0 )
+    {
+      doc_traversal_name( &traversal->titles[ch], &header->summary );
+    }
+  }
+  for( gint s=0; s<traversal->sections; s++ )
+  {
+    // The series name is what's shown in the grid
+    doc_traversal_name( &traversal->series[s], &doc_traversal_cell( traversal, 0, s )->summary );
+  }
+  g_info( "doc.c / ~doc_traverse");
+}
+
+// --------------------------------------------------------------------------
+// doc_traversal_clear
+//
+// Frees the header names of a traversal
+//
+// --------------------------------------------------------------------------
+
+void doc_traversal_clear( doc_traversal *traversal )
+{
+  g_free( traversal->titles );
+  traversal->titles = NULL;
+  traversal->series = NULL;
+}
+
+// --------------------------------------------------------------------------
+// doc_traversal_cell
+//
+// Returns the cell for a section of a chapter, section 0 is the chapter
+// header and chapter 0 the section headers
+//
+// --------------------------------------------------------------------------
+
+doc_cell *doc_traversal_cell( doc_traversal *traversal, gint chapter, gint section )
+{
+  return &traversal->cells[ ( chapter * traversal->chapter_step ) + ( section * traversal->section_step ) ];
+}
+
+// --------------------------------------------------------------------------
+// doc_traversal_name
+//
+// Looks up the text of a header name, decoding it if it hasn't been yet
+//
+// --------------------------------------------------------------------------
+
+void doc_traversal_name( doc_name *name, doc_text *text )
+{
+  name->text = doc_text_get( text );
+  name->length = strlen( name->text );
+}
+
+// --------------------------------------------------------------------------
+// doc_text_get
+//
+// Returns the text, decoding it from the source buffer if this is the
+// first time that it has been used
+//
+// --------------------------------------------------------------------------
+
+const gchar *doc_text_get( doc_text *text )
+{
+  if( text->text == NULL )
+  {
+    if( text->raw == NULL )
+    {
+      // Nothing has been stored
+      return "";
+    }
+    // First use so copy it out of the source buffer
+    gchar *decoded;
+    if( text->escaped == TRUE )
+    {
+      decoded = json_decode_len( text->raw, text->raw_length );
+    }
+    else
+    {
+      decoded = g_strndup( text->raw, text->raw_length );
+    }
+    // The widgets need valid UTF-8 so fix up anything that isn't
+    if( g_utf8_validate( decoded, -1, NULL ) == FALSE )
+    {
+      gchar *valid = g_utf8_make_valid( decoded, -1 );
+      g_free( decoded );
+      decoded = valid;
+    }
+    text->text = g_ref_string_new( decoded );
+    g_free( decoded );
+    text->raw = NULL;
+    text->raw_length = 0;
+    text->escaped = FALSE;
+  }
+  return text->text;
+}
+
+// --------------------------------------------------------------------------
+// doc_text_peek
+//
+// Returns the text as currently held without copying it, along with its
+// length. Used when writing the text straight back out to a file
+// Text that still has JSON escapes in it has to be decoded first
+//
+// --------------------------------------------------------------------------
+
+const gchar *doc_text_peek( doc_text *text, gsize *length )
+{
+  if( text->escaped == TRUE )
+  {
+    doc_text_get( text );
+  }
+  if( text->text != NULL )
+  {
+    *length = g_ref_string_length( text->text );
+    return text->text;
+  }
+  else if( text->raw != NULL )
+  {
+    *length = text->raw_length;
+    return text->raw;
+  }
+  *length = 0;
+  return "";
+}
+
+// --------------------------------------------------------------------------
+// doc_text_source
+//
+// Returns the text as currently held without decoding it, escaped is set
+// if it still has JSON escapes in it. Used to tell whether text has changed
+// without the cost of decoding it
+//
+// --------------------------------------------------------------------------
+
+const gchar *doc_text_source( doc_text *text, gsize *length, gboolean *escaped )
+{
+  *escaped = ( text->text == NULL ) && ( text->escaped == TRUE );
+  if( *escaped == TRUE )
+  {
+    *length = text->raw_length;
+    return text->raw;
+  }
+  return doc_text_peek( text, length );
+}
+
+// --------------------------------------------------------------------------
+// doc_text_set
+//
+// Replaces the text with a copy of the new text
+//
+// --------------------------------------------------------------------------
+
+void doc_text_set( doc_text *text, const gchar *new_text )
+{
+  doc_text_clear( text );
+  text->text = g_ref_string_new( ( new_text != NULL ) ? new_text : "" );
+  text->raw = NULL;
+  text->raw_length = 0;
+  text->escaped = FALSE;
+}
+
+// --------------------------------------------------------------------------
+// doc_text_clear
+//
+// Frees the text and sets it back to empty
+//
+// --------------------------------------------------------------------------
+
+void doc_text_clear( doc_text *text )
+{
+  if( text->text != NULL )
+  {
+    g_ref_string_release( text->text );
+  }
+  text->text = NULL;
+  text->raw = NULL;
+  text->raw_length = 0;
+  text->escaped = FALSE;
+}
+
+// --------------------------------------------------------------------------
+// doc_text_share
+//
+// Makes the destination hold the same text as the source without copying
+// it, the decoded text is reference counted and never changed in place
+//
+// --------------------------------------------------------------------------
+
+void doc_text_share( doc_text *destination, const doc_text *source )
+{
+  *destination = *source;
+  if( destination->text != NULL )
+  {
+    g_ref_string_acquire( destination->text );
+  }
+}
+
+// --------------------------------------------------------------------------
+// doc_snapshot
+//
+// Creates a copy of the document that can be used from another thread
+// while the original carries on being edited
+// The text isn't copied but shared with the original, any raw text is
+// decoded separately by each of them
+//
+// --------------------------------------------------------------------------
+
+mapter_doc *doc_snapshot( mapter_doc *doc )
+{
+  g_info( "doc.c / doc_snapshot");
+  mapter_doc *snapshot = g_slice_new0( mapter_doc );
+  snapshot->rows = doc->rows;
+  snapshot->columns = doc->columns;
+  snapshot->cells = g_new( doc_cell, doc->rows * doc->columns );
+  for( gint i=0; i<( doc->rows * doc->columns ); i++ )
+  {
+    snapshot->cells[i].colour = doc->cells[i].colour;
+    snapshot->cells[i].changed = doc->cells[i].changed;
+    doc_text_share( &snapshot->cells[i].summary, &doc->cells[i].summary );
+    doc_text_share( &snapshot->cells[i].heading, &doc->cells[i].heading );
+    doc_text_share( &snapshot->cells[i].body, &doc->cells[i].body );
+  }
+  snapshot->notes = g_array_sized_new( FALSE, TRUE, sizeof( doc_note ), doc->notes->len );
+  g_array_set_clear_func( snapshot->notes, doc_note_clear );
+  for( guint n=0; n<doc->notes->len; n++ )
+  {
+    doc_note *note = &g_array_index( doc->notes, doc_note, n );
+    doc_note copy;
+    copy.level = note->level;
+    copy.changed = note->changed;
+    doc_text_share( &copy.heading, &note->heading );
+    doc_text_share( &copy.text, &note->text );
+    g_array_append_val( snapshot->notes, copy );
+  }
+  // Keep the buffer that any raw text points into
+  snapshot->source = ( doc->source != NULL ) ? g_bytes_ref( doc->source ) : NULL;
+  snapshot->compact = doc->compact;
+  snapshot->changes = doc->changes;
+  snapshot->saved_changes = doc->saved_changes;
+  snapshot->structure_changed = doc->structure_changed;
+  snapshot->notes_changed = doc->notes_changed;
+  snapshot->notes_structure_changed = doc->notes_structure_changed;
+  snapshot->notes_captured = doc->notes_captured;
+  snapshot->format_changed = doc->format_changed;
+  g_info( "doc.c / ~doc_snapshot");
+  return snapshot;
+}
+
+// --------------------------------------------------------------------------
+// doc_changed
+//
+// Counts a change to the document and returns the new count
+//
+// --------------------------------------------------------------------------
+
+guint doc_changed( mapter_doc *doc )
+{
+  return ++doc->changes;
+}
+
+// --------------------------------------------------------------------------
+// doc_cell_changed
+//
+// Records that the text or colour of a cell has changed
+//
+// --------------------------------------------------------------------------
+
+void doc_cell_changed( mapter_doc *doc, doc_cell *cell )
+{
+  cell->changed = doc_changed( doc );
+}
+
+// --------------------------------------------------------------------------
+// doc_structure_changed
+//
+// Records that rows or columns have been inserted or deleted
+//
+// --------------------------------------------------------------------------
+
+void doc_structure_changed( mapter_doc *doc )
+{
+  doc->structure_changed = doc_changed( doc );
+}
+
+// --------------------------------------------------------------------------
+// doc_notes_changed
+//
+// Records that notes have been added or deleted, so the positions of any
+// of them could have changed
+//
+// --------------------------------------------------------------------------
+
+void doc_notes_changed( mapter_doc *doc )
+{
+  doc->notes_changed = doc_changed( doc );
+  doc->notes_structure_changed = doc->notes_changed;
+}
+
+// --------------------------------------------------------------------------
+// doc_note_changed
+//
+// Records that the heading or text of a single note has changed, a note
+// that isn't in the document yet counts as a change to all of them
+//
+// --------------------------------------------------------------------------
+
+void doc_note_changed( mapter_doc *doc, gint index )
+{
+  if( ( index < 0 ) || ( (guint) index >= doc->notes->len ) )
+  {
+    doc_notes_changed( doc );
+    return;
+  }
+  doc->notes_changed = doc_changed( doc );
+  g_array_index( doc->notes, doc_note, index ).changed = doc->notes_changed;
+}
+
+// --------------------------------------------------------------------------
+// doc_is_dirty
+//
+// Checks if there are any changes since the document was last saved
+//
+// --------------------------------------------------------------------------
+
+gboolean doc_is_dirty( mapter_doc *doc )
+{
+  return( ( doc != NULL ) && ( doc->changes > doc->saved_changes ) );
+}
+
+// --------------------------------------------------------------------------
+// doc_unjournalled
+//
+// Checks if anything that the journal doesn't record, the notes or the
+// format of the file, has changed since the document was last saved
+//
+// --------------------------------------------------------------------------
+
+gboolean doc_unjournalled( mapter_doc *doc )
+{
+  return( ( doc != NULL ) &&
+          ( ( doc->notes_changed > doc->saved_changes ) || ( doc->format_changed > doc->saved_changes ) ) );
+}
+
+// --------------------------------------------------------------------------
+// doc_cell_is_dirty
+//
+// Checks if a cell has changed since the document was last saved
+//
+// --------------------------------------------------------------------------
+
+gboolean doc_cell_is_dirty( mapter_doc *doc, doc_cell *cell )
+{
+  return( cell->changed > doc->saved_changes );
+}
+
+// --------------------------------------------------------------------------
+// doc_saved
+//
+// Records that the document has been saved as it was at the specified
+// change count, anything changed after that is still unsaved
+// Background saves can finish out of order so the count never goes back
+//
+// --------------------------------------------------------------------------
+
+void doc_saved( mapter_doc *doc, guint changes )
+{
+  doc->saved_changes = MAX( doc->saved_changes, changes );
+}
+
+// --------------------------------------------------------------------------
+// doc_decode
+//
+// Decodes the selected text of every cell so that it's ready for use
+// Each cell is independent so large grids are split into blocks of rows
+// which are decoded in parallel
+//
+// --------------------------------------------------------------------------
+
+void doc_decode( mapter_doc *doc, guint fields )
+{
+  g_info( "doc.c / doc_decode");
+  guint threads = g_get_num_processors();
+  if( ( threads < 2 ) || ( ( doc->rows * doc->columns ) < DECODE_PARALLEL_CELLS ) )
+  {
+    // Not worth starting any threads
+    doc_decode_block block = { doc, 0, doc->rows, fields };
+    doc_decode_worker( &block, NULL );
+  }
+  else
+  {
+    // A few blocks per thread to even out the load
+    gint rows_per_block = MAX( 1, doc->rows / ( threads * DECODE_BLOCKS_PER_THREAD ) );
+    gint block_count = ( doc->rows + rows_per_block - 1 ) / rows_per_block;
+    doc_decode_block *blocks = g_new( doc_decode_block, block_count );
+    GThreadPool *pool = g_thread_pool_new( doc_decode_worker, NULL, threads, FALSE, NULL );
+    g_info( "  Decoding %d blocks of %d rows on %u threads", block_count, rows_per_block, threads );
+    for( gint i=0; i<block_count; i++ )
+    {
+      blocks[i].doc = doc;
+      blocks[i].first_row = i * rows_per_block;
+      blocks[i].last_row = MIN( doc->rows, ( i + 1 ) * rows_per_block );
+      blocks[i].fields = fields;
+      g_thread_pool_push( pool, &blocks[i], NULL );
+    }
+    // Wait for all the blocks to finish
+    g_thread_pool_free( pool, FALSE, TRUE );
+    g_free( blocks );
+  }
+  g_info( "doc.c / ~doc_decode");
+}
+
+// --------------------------------------------------------------------------
+// doc_decode_worker
+//
+// Decodes a block of rows, called from the thread pool
+//
+// --------------------------------------------------------------------------
+
+void doc_decode_worker( gpointer data, gpointer user_data )
+{
+  doc_decode_block *block = (doc_decode_block *) data;
+  mapter_doc *doc = block->doc;
+  for( gint i=( block->first_row * doc->columns ); i<( block->last_row * doc->columns ); i++ )
+  {
+    doc_cell *cell = &doc->cells[i];
+    if( block->fields & DECODE_SUMMARY )
+    {
+      doc_text_get( &cell->summary );
+    }
+    if( block->fields & DECODE_HEADING )
+    {
+      doc_text_get( &cell->heading );
+    }
+    if( block->fields & DECODE_BODY )
+    {
+      doc_text_get( &cell->body );
+    }
+  }
+}
+
+// --------------------------------------------------------------------------
+// doc_insert_row
+//
+// Inserts a new row of blank cells at the specified position
+//
+// --------------------------------------------------------------------------
+
+void doc_insert_row( mapter_doc *doc, gint row )
+{
+  g_info( "doc.c / doc_insert_row");
+  g_info( "  Inserting row at %d", row );
+  // Check if the row is in range
+  if( row < 0 )
+  {
+    // Too low so set it to the first row
+    g_info( "  ERROR - row out of range: %d, setting to 0", row );
+    row = 0;
+  }
+  else if( row > doc->rows )
+  {
+    // Too high so set it to the last row
+    g_info( "  ERROR - row out of range: %d, setting to %d", row, doc->rows );
+    row = doc->rows;
+  }
+  doc->cells = g_renew( doc_cell, doc->cells, ( doc->rows + 1 ) * doc->columns );
+  // Move the following rows down and blank the new one
+  memmove( &doc->cells[ ( row + 1 ) * doc->columns ],
+           &doc->cells[ row * doc->columns ],
+           ( doc->rows - row ) * doc->columns * sizeof( doc_cell ) );
+  memset( &doc->cells[ row * doc->columns ], 0, doc->columns * sizeof( doc_cell ) );
+  doc->rows++;
+  g_info( "doc.c / ~doc_insert_row");
+}
+
+// --------------------------------------------------------------------------
+// doc_insert_column
+//
+// Inserts a new column of blank cells at the specified position
+//
+// --------------------------------------------------------------------------
+
+void doc_insert_column( mapter_doc *doc, gint column )
+{
+  g_info( "doc.c / doc_insert_column");
+  g_info( "  Inserting column at %d", column );
+  // Check if the column is in range
+  if( column < 0 )
+  {
+    // Too low so set it to the first column
+    g_info( "  ERROR - column out of range: %d, setting to 0", column );
+    column = 0;
+  }
+  else if( column > doc->columns )
+  {
+    // Too high so set it to the last column
+    g_info( "  ERROR - column out of range: %d, setting to %d", column, doc->columns );
+    column = doc->columns;
+  }
+  // Every row changes position so copy into a new set of cells
+  gint new_columns = doc->columns + 1;
+  doc_cell *cells = g_new0( doc_cell, doc->rows * new_columns );
+  for( gint r=0; r<doc->rows; r++ )
+  {
+    memcpy( &cells[ r * new_columns ],
+            &doc->cells[ r * doc->columns ],
+            column * sizeof( doc_cell ) );
+    memcpy( &cells[ ( r * new_columns ) + column + 1 ],
+            &doc->cells[ ( r * doc->columns ) + column ],
+            ( doc->columns - column ) * sizeof( doc_cell ) );
+  }
+  g_free( doc->cells );
+  doc->cells = cells;
+  doc->columns = new_columns;
+  g_info( "doc.c / ~doc_insert_column");
+}
+
+// --------------------------------------------------------------------------
+// doc_delete_row
+//
+// Deletes the row of cells at the specified position
+//
+// --------------------------------------------------------------------------
+
+void doc_delete_row( mapter_doc *doc, gint row )
+{
+  g_info( "doc.c / doc_delete_row");
+  g_info( "  Deleting row at %d", row );
+  if( ( row >= 0 ) && ( row < doc->rows ) )
+  {
+    for( gint c=0; c<doc->columns; c++ )
+    {
+      doc_cell_clear( &doc->cells[ ( row * doc->columns ) + c ] );
+    }
+    // Move the following rows up
+    memmove( &doc->cells[ row * doc->columns ],
+             &doc->cells[ ( row + 1 ) * doc->columns ],
+             ( doc->rows - row - 1 ) * doc->columns * sizeof( doc_cell ) );
+    doc->rows--;
+  }
+  else
+  {
+    g_info( "  ERROR - ignoring row out of range: %d", row );
+  }
+  g_info( "doc.c / ~doc_delete_row");
+}
+
+// --------------------------------------------------------------------------
+// doc_delete_column
+//
+// Deletes the column of cells at the specified position
+//
+// --------------------------------------------------------------------------
+
+void doc_delete_column( mapter_doc *doc, gint column )
+{
+  g_info( "doc.c / doc_delete_column");
+  g_info( "  Deleting column at %d", column );
+  if( ( column >= 0 ) && ( column < doc->columns ) )
+  {
+    gint new_columns = doc->columns - 1;
+    for( gint r=0; r<doc->rows; r++ )
+    {
+      doc_cell_clear( &doc->cells[ ( r * doc->columns ) + column ] );
+      // Close up the gap, everything shifts down by one per row
+      memmove( &doc->cells[ r * new_columns ],
+               &doc->cells[ r * doc->columns ],
+               column * sizeof( doc_cell ) );
+      memmove( &doc->cells[ ( r * new_columns ) + column ],
+               &doc->cells[ ( r * doc->columns ) + column + 1 ],
+               ( new_columns - column ) * sizeof( doc_cell ) );
+    }
+    doc->columns = new_columns;
+  }
+  else
+  {
+    g_info( "  ERROR - ignoring column out of range: %d", column );
+  }
+  g_info( "doc.c / ~doc_delete_column");
+}
+
+// --------------------------------------------------------------------------
+// doc_add_note
+//
+// Adds a copy of the note to the end of the notes
+//
+// --------------------------------------------------------------------------
+
+void doc_add_note( mapter_doc *doc, gint level, const gchar *heading, const gchar *text )
+{
+  doc_note note = { level, { NULL, NULL, 0, FALSE }, { NULL, NULL, 0, FALSE }, 0 };
+  doc_text_set( &note.heading, heading );
+  doc_text_set( &note.text, text );
+  g_array_append_val( doc->notes, note );
+}
+
+// --------------------------------------------------------------------------
+// doc_clear_notes
+//
+// Deletes all the notes
+//
+// --------------------------------------------------------------------------
+
+void doc_clear_notes( mapter_doc *doc )
+{
+  g_info( "doc.c / doc_clear_notes");
+  if( doc->notes->len > 0 )
+  {
+    g_array_remove_range( doc->notes, 0, doc->notes->len );
+  }
+  g_info( "doc.c / ~doc_clear_notes");
+}
+
+// --------------------------------------------------------------------------
+// json_get_int
+//
+// Reads an integer from a JSON number value
+// Returns FALSE if the value isn't a number
+//
+// --------------------------------------------------------------------------
+
+gboolean json_get_int( struct json_value_s *value, gint *result )
+{
+  struct json_number_s *number = json_value_as_number( value );
+  if( number == NULL )
+  {
+    return FALSE;
+  }
+  *result = atoi( number->number );
+  return TRUE;
+}
+
+// --------------------------------------------------------------------------
+// json_get_text
+//
+// Reads the string from a JSON string value
+// Returns NULL if the value isn't a string
+//
+// --------------------------------------------------------------------------
+
+const gchar *json_get_text( struct json_value_s *value )
+{
+  struct json_string_s *string = json_value_as_string( value );
+  if( string == NULL )
+  {
+    return NULL;
+  }
+  return string->string;
+}
+
+// --------------------------------------------------------------------------
+// doc_read_json
+//
+// Builds a new document from a buffer holding a JSON mapter file
+//
+// --------------------------------------------------------------------------
+
+result_return doc_read_json( const gchar *json_string, gsize json_length, mapter_doc **doc_out )
+{
+  result_return file_process = { TRUE, "" };
+  struct json_value_s *json_data_root = NULL;
+  struct json_object_s *json_data_object;
+  struct json_object_element_s *json_data_current;
+  struct json_string_s *json_data_current_name;
+  mapter_doc *doc = NULL;
+  gint new_rows = -1;
+  gint new_columns = -1;
+
+  g_info( "doc.c / doc_read_json");
+  *doc_out = NULL;
+
+  // Parse data
+  if( ( json_data_root = json_parse( json_string, json_length ) ) == NULL )
+  {
+    g_info( "  ERROR: Open file parse failed #1" );
+    file_process.result = FALSE;
+    file_process.message = "Open file parse failed #1";
+    goto error_exit;
+  }
+  if( ( json_data_object = json_value_as_object( json_data_root ) ) == NULL )
+  {
+    g_info( "  ERROR: Open file parse failed #2" );
+    file_process.result = FALSE;
+    file_process.message = "Open file parse failed #2";
+    goto error_exit;
+  }
+  // Start with an empty document, the cells are added when the grid is found
+  doc = doc_new( 0, 0 );
+  json_data_current = json_data_object->start;
+  // Loop through the top level objects
+  while( json_data_current != NULL )
+  {
+    json_data_current_name = json_data_current->name;
+    if( strcmp( json_data_current_name->string, VERSION ) == 0 )
+    {
+      // Check that the version is <= current supported version
+      gint version_no = 0;
+      if( json_get_int( json_data_current->value, &version_no ) == FALSE )
+      {
+        g_info( "  ERROR: Open file parse failed #3" );
+        file_process.result = FALSE;
+        file_process.message = "Open file parse failed #3";
+        goto error_exit;
+      }
+      g_info( "  Version number: %d", version_no );
+      if( version_no > SAVE_FILE_VERSION_NUMBER )
+      {
+        g_info( "  ERROR: Save file version number is unsupported" );
+        file_process.result = FALSE;
+        file_process.message = "Save file version number is unsupported";
+        goto error_exit;
+      }
+    }
+    else if( strcmp( json_data_current_name->string, ROWS ) == 0 )
+    {
+      // Check that rows >= minimum rows
+      if( json_get_int( json_data_current->value, &new_rows ) == FALSE )
+      {
+        new_rows = -1;
+      }
+      g_info( "  Rows: %d", new_rows );
+      if( new_rows < MIN_GRID_ROWS )
+      {
+        g_info( "  ERROR: Row specification too small" );
+        file_process.result = FALSE;
+        file_process.message = "Row specification too small";
+        goto error_exit;
+      }
+    }
+    else if( strcmp( json_data_current_name->string, COLUMNS ) == 0 )
+    {
+      // Check that columns >= minimum columns
+      if( json_get_int( json_data_current->value, &new_columns ) == FALSE )
+      {
+        new_columns = -1;
+      }
+      g_info( "  Columns: %d", new_columns );
+      if( new_columns < MIN_GRID_COLUMNS )
+      {
+        g_info( "  ERROR: Column specification too small" );
+        file_process.result = FALSE;
+        file_process.message = "Column specification too small";
+        goto error_exit;
+      }
+    }
+    else if( strcmp( json_data_current_name->string, TEXT_GRID ) == 0 )
+    {
+      struct json_array_s* array = json_value_as_array( json_data_current->value );
+      g_info( "  Reading text array" );
+      // Check that there is the correct number of elements
+      if( ( array == NULL ) || ( new_rows < MIN_GRID_ROWS ) || ( new_columns < MIN_GRID_COLUMNS ) ||
+          ( array->length != (gsize)( new_rows * new_columns ) ) )
+      {
+        g_info( "  ERROR: Array size does not match" );
+        file_process.result = FALSE;
+        file_process.message = "Array size does not match";
+        goto error_exit;
+      }
+      // Set up the cells at the required dimensions
+      g_free( doc->cells );
+      doc->cells = g_new0( doc_cell, new_rows * new_columns );
+      doc->rows = new_rows;
+      doc->columns = new_columns;
+      struct json_array_element_s* text_array_element = array->start;
+      // Loop through text grid
+      doc_cell *cell = doc->cells;
+      while( text_array_element != NULL )
+      {
+        // Get the object at this entry
+        struct json_object_s *text_array_element_object = json_value_as_object( text_array_element->value );
+        struct json_object_element_s *text_array_element_object_current = NULL;
+        if( text_array_element_object != NULL )
+        {
+          text_array_element_object_current = text_array_element_object->start;
+        }
+        // Loop through each object in each array element
+        while( text_array_element_object_current != NULL )
+        {
+          const gchar *name = ( text_array_element_object_current->name )->string;
+          const gchar *text = json_get_text( text_array_element_object_current->value );
+          if( strcmp( name, CELL_BACKGROUND_COLOUR ) == 0 )
+          {
+            gint colour = NONE;
+            json_get_int( text_array_element_object_current->value, &colour );
+            cell->colour = colour;
+          }
+          else if( ( strcmp( name, TEXT_SUMMARY ) == 0 ) && ( text != NULL ) )
+          {
+            doc_text_set( &cell->summary, text );
+          }
+          else if( ( strcmp( name, TEXT_HEADING ) == 0 ) && ( text != NULL ) )
+          {
+            doc_text_set( &cell->heading, text );
+          }
+          else if( ( strcmp( name, TEXT_BODY ) == 0 ) && ( text != NULL ) )
+          {
+            doc_text_set( &cell->body, text );
+          }
+          else
+          {
+            g_info( "ERROR - ignoring entry: %s", name );
+          }
+          // Step on
+          text_array_element_object_current = text_array_element_object_current->next;
+        }
+        cell++;
+        text_array_element = text_array_element->next;
+      }
+    }
+    else if( strcmp( json_data_current_name->string, TREE_NOTES ) == 0 )
+    {
+      g_info( "  Reading tree array" );
+      // Replace any existing notes
+      doc_clear_notes( doc );
+      struct json_array_s* array = json_value_as_array( json_data_current->value );
+      struct json_array_element_s* tree_array_element = ( array != NULL ) ? array->start : NULL;
+      // Loop through tree
+      int count = 0;
+      while( tree_array_element != NULL )
+      {
+        // Get the data at this row, which must be index, heading and text in that order
+        struct json_object_s *tree_array_element_object = json_value_as_object( tree_array_element->value );
+        struct json_object_element_s *element = ( tree_array_element_object != NULL ) ? tree_array_element_object->start : NULL;
+        const gchar *values[3] = { NULL, NULL, NULL };
+        const gchar *names[3] = { TREE_INDEX, TREE_HEADING, TREE_TEXT };
+        gint i;
+        for( i=0; i<3; i++ )
+        {
+          if( ( element == NULL ) || ( strcmp( element->name->string, names[i] ) != 0 ) ||
+              ( ( values[i] = json_get_text( element->value ) ) == NULL ) )
+          {
+            break;
+          }
+          element = element->next;
+        }
+        if( ( i < 3 ) || ( element != NULL ) )
+        {
+          // Error so stop here but keep the notes read so far
+          g_info( "  ERROR when reading tree entry: %d abandoning import", count );
+          break;
+        }
+        // Level = no of ':' characters in index string
+        const gchar *ptr = values[0];
+        gint level = 0;
+        while( *ptr != '\0' )
+        {
+          if( *ptr == INDEX_SEPARATOR )
+          {
+            level++;
+          }
+          ptr++;
+        }
+        doc_add_note( doc, level, values[1], values[2] );
+        // Next row
+        tree_array_element = tree_array_element->next;
+        count++;
+      }
+    }
+    else if( strcmp( json_data_current_name->string, GENERAL_NOTES ) == 0 )
+    {
+      // Older files have a single block of notes so make it a single
+      // top level tree entry
+      const gchar *text = json_get_text( json_data_current->value );
+      doc_clear_notes( doc );
+      doc_add_note( doc, 0, IMPORTED_NOTES_HEADING, ( text != NULL ) ? text : "" );
+    }
+    else
+    {
+      g_info( "  WARNING: Unknown JSON entry found and ignored: %s", json_data_current_name->string );
+    }
+    // Step on
+    json_data_current = json_data_current->next;
+  }
+
+  if( doc->cells == NULL )
+  {
+    g_info( "  ERROR: No text grid found" );
+    file_process.result = FALSE;
+    file_process.message = "No text grid found";
+    goto error_exit;
+  }
+
+  // Hand the document over
+  *doc_out = doc;
+  doc = NULL;
+
+  error_exit: // Destination if an error was found during the parsing
+  doc_free( doc );
+  free( json_data_root );
+
+  g_info( "doc.c / ~doc_read_json");
+  return( file_process );
+}
+
+// --------------------------------------------------------------------------
+// json_scan_space
+//
+// Steps over any white space, returns FALSE at the end of the buffer
+//
+// --------------------------------------------------------------------------
+
+gboolean json_scan_space( json_scanner *scanner )
+{
+  while( ( scanner->ptr < scanner->end ) && g_ascii_isspace( *scanner->ptr ) )
+  {
+    scanner->ptr++;
+  }
+  return( scanner->ptr < scanner->end );
+}
+
+// --------------------------------------------------------------------------
+// json_scan_char
+//
+// Steps over the next character if it's the one specified
+//
+// --------------------------------------------------------------------------
+
+gboolean json_scan_char( json_scanner *scanner, gchar c )
+{
+  if( ( json_scan_space( scanner ) == TRUE ) && ( *scanner->ptr == c ) )
+  {
+    scanner->ptr++;
+    return TRUE;
+  }
+  return FALSE;
+}
+
+// --------------------------------------------------------------------------
+// json_scan_string
+//
+// Finds the contents of the next string without decoding it
+// Sets escaped to TRUE if there are any escapes in it
+//
+// --------------------------------------------------------------------------
+
+gboolean json_scan_string( json_scanner *scanner, doc_text *text, gboolean *escaped )
+{
+  if( json_scan_char( scanner, '"' ) == FALSE )
+  {
+    return FALSE;
+  }
+  const gchar *start = scanner->ptr;
+  *escaped = FALSE;
+  while( scanner->ptr < scanner->end )
+  {
+    guchar c = *scanner->ptr;
+    if( c == '"' )
+    {
+      text->raw = start;
+      text->raw_length = scanner->ptr - start;
+      text->escaped = TRUE;
+      scanner->ptr++;
+      return TRUE;
+    }
+    else if( c == '\\' )
+    {
+      // Check the escape is valid so the text can be written back out as is
+      *escaped = TRUE;
+      scanner->ptr++;
+      if( scanner->ptr >= scanner->end )
+      {
+        return FALSE;
+      }
+      if( *scanner->ptr == 'u' )
+      {
+        if( ( scanner->end - scanner->ptr ) < 5 )
+        {
+          return FALSE;
+        }
+        for( gint i=1; i<=4; i++ )
+        {
+          if( g_ascii_isxdigit( scanner->ptr[i] ) == FALSE )
+          {
+            return FALSE;
+          }
+        }
+        scanner->ptr += 4;
+      }
+      else if( strchr( "\"\\/bfnrt", *scanner->ptr ) == NULL )
+      {
+        return FALSE;
+      }
+    }
+    else if( c < 0x20 )
+    {
+      // Control characters have to be escaped
+      return FALSE;
+    }
+    scanner->ptr++;
+  }
+  return FALSE;
+}
+
+// --------------------------------------------------------------------------
+// json_scan_int
+//
+// Reads the next number as an integer
+//
+// --------------------------------------------------------------------------
+
+gboolean json_scan_int( json_scanner *scanner, gint *value )
+{
+  if( json_scan_space( scanner ) == FALSE )
+  {
+    return FALSE;
+  }
+  const gchar *start = scanner->ptr;
+  if( *scanner->ptr == '-' )
+  {
+    scanner->ptr++;
+  }
+  if( ( scanner->ptr == scanner->end ) || ( g_ascii_isdigit( *scanner->ptr ) == FALSE ) )
+  {
+    return FALSE;
+  }
+  while( ( scanner->ptr < scanner->end ) && ( strchr( "0123456789.eE+-", *scanner->ptr ) != NULL ) )
+  {
+    scanner->ptr++;
+  }
+  // Same conversion as the full read, the buffer is zero terminated
+  *value = atoi( start );
+  return TRUE;
+}
+
+// --------------------------------------------------------------------------
+// json_scan_skip
+//
+// Steps over the next value whatever it is
+//
+// --------------------------------------------------------------------------
+
+gboolean json_scan_skip( json_scanner *scanner )
+{
+  doc_text text;
+  gboolean escaped;
+  gint value;
+
+  if( json_scan_space( scanner ) == FALSE )
+  {
+    return FALSE;
+  }
+  switch( *scanner->ptr )
+  {
+    case '"':
+      return json_scan_string( scanner, &text, &escaped );
+    case '{':
+    case '[':
+    {
+      // Objects and arrays, keep track of the nesting until the end
+      gchar close = ( *scanner->ptr == '{' ) ? '}' : ']';
+      scanner->ptr++;
+      if( json_scan_char( scanner, close ) == TRUE )
+      {
+        return TRUE;
+      }
+      do
+      {
+        if( ( close == '}' ) &&
+            ( ( json_scan_string( scanner, &text, &escaped ) == FALSE ) || ( json_scan_char( scanner, ':' ) == FALSE ) ) )
+        {
+          return FALSE;
+        }
+        if( json_scan_skip( scanner ) == FALSE )
+        {
+          return FALSE;
+        }
+      } while( json_scan_char( scanner, ',' ) == TRUE );
+      return json_scan_char( scanner, close );
+    }
+    case 't':
+    case 'f':
+    case 'n':
+    {
+      const gchar *words[] = { "true", "false", "null" };
+      for( gint i=0; i<3; i++ )
+      {
+        gsize word_length = strlen( words[i] );
+        if( ( ( scanner->end - scanner->ptr ) >= word_length ) &&
+            ( strncmp( scanner->ptr, words[i], word_length ) == 0 ) )
+        {
+          scanner->ptr += word_length;
+          return TRUE;
+        }
+      }
+      return FALSE;
+    }
+    default:
+      return json_scan_int( scanner, &value );
+  }
+}
+
+// --------------------------------------------------------------------------
+// json_scan_key
+//
+// Reads the next object key and the ':' after it, the key is returned as
+// a zero terminated copy in the buffer passed in. Keys with escapes in them
+// aren't expected so they are treated as an error
+//
+// --------------------------------------------------------------------------
+
+gboolean json_scan_key( json_scanner *scanner, gchar *key, gsize key_size )
+{
+  doc_text text;
+  gboolean escaped;
+  if( ( json_scan_string( scanner, &text, &escaped ) == FALSE ) ||
+      ( escaped == TRUE ) ||
+      ( json_scan_char( scanner, ':' ) == FALSE ) )
+  {
+    return FALSE;
+  }
+  // Anything too long can't be one of ours
+  gsize length = MIN( text.raw_length, key_size - 1 );
+  memcpy( key, text.raw, length );
+  key[length] = '\0';
+  return TRUE;
+}
+
+// --------------------------------------------------------------------------
+// json_scan_cell
+//
+// Reads a single entry of the text grid
+//
+// --------------------------------------------------------------------------
+
+gboolean json_scan_cell( json_scanner *scanner, doc_cell *cell )
+{
+  gchar key[ MAX_SCAN_KEY ];
+  gboolean escaped;
+  gint colour;
+
+  if( json_scan_char( scanner, '{' ) == FALSE )
+  {
+    return FALSE;
+  }
+  if( json_scan_char( scanner, '}' ) == TRUE )
+  {
+    return TRUE;
+  }
+  do
+  {
+    if( json_scan_key( scanner, key, sizeof( key ) ) == FALSE )
+    {
+      return FALSE;
+    }
+    if( strcmp( key, CELL_BACKGROUND_COLOUR ) == 0 )
+    {
+      if( json_scan_int( scanner, &colour ) == FALSE )
+      {
+        return FALSE;
+      }
+      cell->colour = colour;
+    }
+    else if( strcmp( key, TEXT_SUMMARY ) == 0 )
+    {
+      doc_text_clear( &cell->summary );
+      if( json_scan_string( scanner, &cell->summary, &escaped ) == FALSE )
+      {
+        return FALSE;
+      }
+    }
+    else if( strcmp( key, TEXT_HEADING ) == 0 )
+    {
+      doc_text_clear( &cell->heading );
+      if( json_scan_string( scanner, &cell->heading, &escaped ) == FALSE )
+      {
+        return FALSE;
+      }
+    }
+    else if( strcmp( key, TEXT_BODY ) == 0 )
+    {
+      doc_text_clear( &cell->body );
+      if( json_scan_string( scanner, &cell->body, &escaped ) == FALSE )
+      {
+        return FALSE;
+      }
+    }
+    else if( json_scan_skip( scanner ) == FALSE )
+    {
+      return FALSE;
+    }
+  } while( json_scan_char( scanner, ',' ) == TRUE );
+
+  return json_scan_char( scanner, '}' );
+}
+
+// --------------------------------------------------------------------------
+// json_scan_note
+//
+// Reads a single entry of the notes tree which must be the index, heading
+// and text in that order
+//
+// --------------------------------------------------------------------------
+
+gboolean json_scan_note( json_scanner *scanner, doc_note *note )
+{
+  gchar key[ MAX_SCAN_KEY ];
+  doc_text index = { NULL, NULL, 0, FALSE };
+  gboolean escaped;
+
+  if( ( json_scan_char( scanner, '{' ) == FALSE ) ||
+      ( json_scan_key( scanner, key, sizeof( key ) ) == FALSE ) ||
+      ( strcmp( key, TREE_INDEX ) != 0 ) ||
+      ( json_scan_string( scanner, &index, &escaped ) == FALSE ) ||
+      ( escaped == TRUE ) ||
+      ( json_scan_char( scanner, ',' ) == FALSE ) ||
+      ( json_scan_key( scanner, key, sizeof( key ) ) == FALSE ) ||
+      ( strcmp( key, TREE_HEADING ) != 0 ) ||
+      ( json_scan_string( scanner, &note->heading, &escaped ) == FALSE ) ||
+      ( json_scan_char( scanner, ',' ) == FALSE ) ||
+      ( json_scan_key( scanner, key, sizeof( key ) ) == FALSE ) ||
+      ( strcmp( key, TREE_TEXT ) != 0 ) ||
+      ( json_scan_string( scanner, &note->text, &escaped ) == FALSE ) ||
+      ( json_scan_char( scanner, '}' ) == FALSE ) )
+  {
+    return FALSE;
+  }
+  // Level = no of ':' characters in index string
+  note->level = 0;
+  for( gsize i=0; i<index.raw_length; i++ )
+  {
+    if( index.raw[i] == INDEX_SEPARATOR )
+    {
+      note->level++;
+    }
+  }
+  return TRUE;
+}
+
+// --------------------------------------------------------------------------
+// json_scan_doc
+//
+// Scans a complete mapter file
+// Returns NULL if there's anything that isn't expected
+//
+// --------------------------------------------------------------------------
+
+mapter_doc *json_scan_doc( json_scanner *scanner )
+{
+  gchar key[ MAX_SCAN_KEY ];
+  gint version_no = 0;
+  gint new_rows = -1;
+  gint new_columns = -1;
+  gboolean escaped;
+  mapter_doc *doc = doc_new( 0, 0 );
+
+  if( json_scan_char( scanner, '{' ) == FALSE )
+  {
+    goto error_exit;
+  }
+  do
+  {
+    if( json_scan_key( scanner, key, sizeof( key ) ) == FALSE )
+    {
+      goto error_exit;
+    }
+    if( strcmp( key, VERSION ) == 0 )
+    {
+      if( ( json_scan_int( scanner, &version_no ) == FALSE ) ||
+          ( version_no > SAVE_FILE_VERSION_NUMBER ) )
+      {
+        goto error_exit;
+      }
+    }
+    else if( strcmp( key, ROWS ) == 0 )
+    {
+      if( ( json_scan_int( scanner, &new_rows ) == FALSE ) || ( new_rows < MIN_GRID_ROWS ) )
+      {
+        goto error_exit;
+      }
+    }
+    else if( strcmp( key, COLUMNS ) == 0 )
+    {
+      if( ( json_scan_int( scanner, &new_columns ) == FALSE ) || ( new_columns < MIN_GRID_COLUMNS ) )
+      {
+        goto error_exit;
+      }
+    }
+    else if( ( strcmp( key, TEXT_GRID ) == 0 ) && ( doc->cells == NULL ) &&
+             ( new_rows >= MIN_GRID_ROWS ) && ( new_columns >= MIN_GRID_COLUMNS ) )
+    {
+      g_info( "  Scanning text array" );
+      g_free( doc->cells );
+      doc->cells = g_new0( doc_cell, new_rows * new_columns );
+      doc->rows = new_rows;
+      doc->columns = new_columns;
+      gint count = 0;
+      if( json_scan_char( scanner, '[' ) == FALSE )
+      {
+        goto error_exit;
+      }
+      if( json_scan_char( scanner, ']' ) == FALSE )
+      {
+        do
+        {
+          if( ( count == ( new_rows * new_columns ) ) ||
+              ( json_scan_cell( scanner, &doc->cells[ count ] ) == FALSE ) )
+          {
+            goto error_exit;
+          }
+          count++;
+        } while( json_scan_char( scanner, ',' ) == TRUE );
+        if( json_scan_char( scanner, ']' ) == FALSE )
+        {
+          goto error_exit;
+        }
+      }
+      // Check that there is the correct number of elements
+      if( count != ( new_rows * new_columns ) )
+      {
+        goto error_exit;
+      }
+    }
+    else if( strcmp( key, TREE_NOTES ) == 0 )
+    {
+      g_info( "  Scanning tree array" );
+      doc_clear_notes( doc );
+      if( json_scan_char( scanner, '[' ) == FALSE )
+      {
+        goto error_exit;
+      }
+      if( json_scan_char( scanner, ']' ) == FALSE )
+      {
+        do
+        {
+          doc_note note = { 0, { NULL, NULL, 0, FALSE }, { NULL, NULL, 0, FALSE }, 0 };
+          if( json_scan_note( scanner, &note ) == FALSE )
+          {
+            goto error_exit;
+          }
+          g_array_append_val( doc->notes, note );
+        } while( json_scan_char( scanner, ',' ) == TRUE );
+        if( json_scan_char( scanner, ']' ) == FALSE )
+        {
+          goto error_exit;
+        }
+      }
+    }
+    else if( strcmp( key, GENERAL_NOTES ) == 0 )
+    {
+      // Older files have a single block of notes
+      doc_note note = { 0, { NULL, NULL, 0, FALSE }, { NULL, NULL, 0, FALSE }, 0 };
+      if( json_scan_string( scanner, &note.text, &escaped ) == FALSE )
+      {
+        goto error_exit;
+      }
+      doc_text_set( &note.heading, IMPORTED_NOTES_HEADING );
+      doc_clear_notes( doc );
+      g_array_append_val( doc->notes, note );
+    }
+    else if( ( strcmp( key, TEXT_GRID ) == 0 ) || ( json_scan_skip( scanner ) == FALSE ) )
+    {
+      // Text grid in the wrong place or an unknown entry that can't be read
+      goto error_exit;
+    }
+  } while( json_scan_char( scanner, ',' ) == TRUE );
+
+  if( ( json_scan_char( scanner, '}' ) == FALSE ) ||
+      ( json_scan_space( scanner ) == TRUE ) ||
+      ( doc->cells == NULL ) )
+  {
+    goto error_exit;
+  }
+  g_info( "  Scanned - Rows: %d, Columns: %d, Notes: %d", doc->rows, doc->columns, doc->notes->len );
+  // The summaries are shown straight away so decode them now
+  doc_decode( doc, DECODE_SUMMARY );
+  return doc;
+
+  error_exit: // Destination if anything unexpected was found
+  g_info( "  Scan stopped at offset: %ld", (glong)( scanner->ptr - scanner->start ) );
+  doc_free( doc );
+  return NULL;
+}
+
+// --------------------------------------------------------------------------
+// doc_load_json
+//
+// Builds a new document from a buffer holding a JSON mapter file, the
+// buffer must be zero terminated
+//
+// The file is scanned once to find where each entry is and only the
+// summaries are decoded, the headings, bodies and notes are left in the
+// buffer until they are first used. Anything the scan doesn't expect is
+// passed to doc_read_json to be read in full and to report any errors
+//
+// --------------------------------------------------------------------------
+
+result_return doc_load_json( GBytes *source, mapter_doc **doc_out )
+{
+  result_return file_process;
+  gsize length;
+  const gchar *json_string = g_bytes_get_data( source, &length );
+
+  g_info( "doc.c / doc_load_json");
+  // Ignore the zero terminator
+  if( length > 0 )
+  {
+    length--;
+  }
+  json_scanner scanner = { json_string, json_string, json_string + length };
+  mapter_doc *doc = json_scan_doc( &scanner );
+  if( doc != NULL )
+  {
+    // The unused text points into the buffer so keep it
+    doc->source = g_bytes_ref( source );
+    *doc_out = doc;
+    file_process = (result_return) { TRUE, "" };
+  }
+  else
+  {
+    g_info( "  Scan failed, reading in full" );
+    file_process = doc_read_json( json_string, length, doc_out );
+  }
+  if( file_process.result == TRUE )
+  {
+    // Carry on saving the file in the way that it was found
+    ( *doc_out )->compact = json_is_compact( json_string, length );
+  }
+  g_info( "doc.c / ~doc_load_json");
+  return( file_process );
+}
+
+// --------------------------------------------------------------------------
+// json_is_compact
+//
+// Checks whether a JSON mapter file was written without any layout
+//
+// --------------------------------------------------------------------------
+
+gboolean json_is_compact( const gchar *json_string, gsize json_length )
+{
+  return( ( json_length > 1 ) && ( json_string[0] == '{' ) && ( json_string[1] == '"' ) );
+}
+
+// --------------------------------------------------------------------------
+// json_decode_len
+//
+// Decodes the contents of a JSON string into a new zero terminated string
+//
+// --------------------------------------------------------------------------
+
+gchar *json_decode_len( const gchar *input_str, gsize length )
+{
+  const gchar *ip = input_str;
+  const gchar *end = input_str + length;
+  GString *output = g_string_sized_new( length );
+  while( ip < end )
+  {
+    // Copy everything up to the next escape in one go
+    const gchar *escape = memchr( ip, '\\', end - ip );
+    if( escape == NULL )
+    {
+      escape = end;
+    }
+    g_string_append_len( output, ip, escape - ip );
+    ip = escape + 1;
+    if( ip >= end )
+    {
+      break;
+    }
+    switch( *ip )
+    {
+      case 'b':
+        g_string_append_c( output, '\b' );
+        break;
+      case 'f':
+        g_string_append_c( output, '\f' );
+        break;
+      case 'n':
+        g_string_append_c( output, '\n' );
+        break;
+      case 'r':
+        g_string_append_c( output, '\r' );
+        break;
+      case 't':
+        g_string_append_c( output, '\t' );
+        break;
+      case 'u':
+        if( ( end - ip ) > 4 )
+        {
+          gunichar ch = json_decode_hex( ip + 1 );
+          ip += 4;
+          // Characters outside the BMP are sent as a surrogate pair
+          if( ( ch >= 0xD800 ) && ( ch <= 0xDBFF ) && ( ( end - ip ) > 6 ) &&
+              ( ip[1] == '\\' ) && ( ip[2] == 'u' ) )
+          {
+            gunichar low = json_decode_hex( ip + 3 );
+            if( ( low >= 0xDC00 ) && ( low <= 0xDFFF ) )
+            {
+              ch = 0x10000 + ( ( ch - 0xD800 ) << 10 ) + ( low - 0xDC00 );
+              ip += 6;
+            }
+          }
+          g_string_append_unichar( output, ch );
+        }
+        break;
+      default:
+        // '"', '\\' and '/' are just themselves
+        g_string_append_c( output, *ip );
+        break;
+    }
+    ip++;
+  }
+  return g_string_free( output, FALSE );
+}
+
+// --------------------------------------------------------------------------
+// json_decode_hex
+//
+// Converts the 4 hex digits of a \u escape
+//
+// --------------------------------------------------------------------------
+
+gunichar json_decode_hex( const gchar *hex )
+{
+  gunichar value = 0;
+  for( gint i=0; i<4; i++ )
+  {
+    value = ( value << 4 ) | MAX( g_ascii_xdigit_value( hex[i] ), 0 );
+  }
+  return value;
+}
+
+// --------------------------------------------------------------------------
+// json_encode_text
+//
+// JSON encodes a document text entry without decoding it first
+// Text that was never used since being read from a JSON file is still
+// encoded so it's written out as it is
+//
+// --------------------------------------------------------------------------
+
+void json_encode_text( output_writer *writer, doc_text *text )
+{
+  gsize length;
+  if( ( text->raw != NULL ) && ( text->escaped == TRUE ) )
+  {
+    writer_write( writer, text->raw, text->raw_length );
+    return;
+  }
+  const gchar *str = doc_text_peek( text, &length );
+  writer_json( writer, str, length );
+}
+
+// --------------------------------------------------------------------------
+// doc_note_index
+//
+// Steps the index counters for each level of the tree on to the next note
+// and returns its level, the index is rebuilt from these as the notes are
+// in depth first order
+//
+// --------------------------------------------------------------------------
+
+gint doc_note_index( GArray *index, doc_note *note )
+{
+  // A note can only be one level deeper than the previous one
+  gint level = CLAMP( note->level, 0, (gint)index->len );
+  if( level == (gint)index->len )
+  {
+    // First child at a new level
+    gint start = -1;
+    g_array_append_val( index, start );
+  }
+  else
+  {
+    // Back up to this level
+    g_array_set_size( index, level + 1 );
+  }
+  g_array_index( index, gint, level )++;
+  return level;
+}
+
+// --------------------------------------------------------------------------
+// doc_write_note_index
+//
+// Writes the index string of a note, e.g. 0:2:1
+//
+// --------------------------------------------------------------------------
+
+void doc_write_note_index( output_writer *writer, GArray *index )
+{
+  for( guint i=0; i<index->len; i++ )
+  {
+    writer_printf( writer, ( i == 0 ) ? "%d" : ":%d", g_array_index( index, gint, i ) );
+  }
+}
+
+// --------------------------------------------------------------------------
+// doc_write_indented
+//
+// Writes the document as indented JSON with every entry of every cell
+//
+// --------------------------------------------------------------------------
+
+void doc_write_indented( output_writer *writer, mapter_doc *doc )
+{
+  // Header
+  writer_puts( writer, "{\n" );
+
+  // Version number
+  writer_printf( writer, "\t\"%s\": %d,\n", VERSION, SAVE_FILE_VERSION_NUMBER );
+
+  // Rows and columns
+  writer_printf( writer, "\t\"%s\": %d,\n", ROWS, doc->rows );
+  writer_printf( writer, "\t\"%s\": %d,\n", COLUMNS, doc->columns );
+
+  // Array of text entries from the Planning Grid tab
+  writer_printf( writer, "\t\"%s\": [\n", TEXT_GRID );
+  for( gint i=0; i<( doc->rows * doc->columns ); i++ )
+  {
+    doc_cell *cell = &doc->cells[i];
+    if( i > 0 )
+    {
+      // If it's not the first time then print the ,
+      writer_puts( writer, ",\n" );
+    }
+    writer_puts( writer, "\t\t{\n" );
+    // Cell background colour
+    writer_printf( writer, "\t\t\t\"%s\": %i,\n", CELL_BACKGROUND_COLOUR, cell->colour );
+    // Summary
+    writer_puts( writer, "\t\t\t\"" TEXT_SUMMARY "\": \"" );
+    json_encode_text( writer, &cell->summary );
+    writer_puts( writer, "\",\n" );
+    // Heading
+    writer_puts( writer, "\t\t\t\"" TEXT_HEADING "\": \"" );
+    json_encode_text( writer, &cell->heading );
+    writer_puts( writer, "\",\n" );
+    // Body
+    writer_puts( writer, "\t\t\t\"" TEXT_BODY "\": \"" );
+    json_encode_text( writer, &cell->body );
+    writer_puts( writer, "\"\n\t\t}" );
+  }
+  writer_puts( writer, "\n\t],\n" );  // Close text_grid
+
+  // General Notes Tab
+  writer_printf( writer, "\t\"%s\": [\n", TREE_NOTES );
+  GArray *index = g_array_new( FALSE, TRUE, sizeof( gint ) );
+  for( guint n=0; n<doc->notes->len; n++ )
+  {
+    doc_note *note = &g_array_index( doc->notes, doc_note, n );
+    doc_note_index( index, note );
+    if( n > 0 )
+    {
+      writer_puts( writer, ",\n" );
+    }
+    // Output it
+    writer_puts( writer, "\t\t{\n" );
+    writer_printf( writer, "\t\t\"%s\": \"", TREE_INDEX );
+    doc_write_note_index( writer, index );
+    writer_puts( writer, "\",\n" );
+    writer_puts( writer, "\t\t\"" TREE_HEADING "\": \"" );
+    json_encode_text( writer, &note->heading );
+    writer_puts( writer, "\",\n" );
+    writer_puts( writer, "\t\t\"" TREE_TEXT "\": \"" );
+    json_encode_text( writer, &note->text );
+    writer_puts( writer, "\"\n" );
+    writer_puts( writer, "\t\t}" );
+  }
+  g_array_free( index, TRUE );
+  writer_puts( writer, "\n\t]\n" );
+
+  // Footer
+  writer_puts( writer, "}\n" );
+}
+
+// --------------------------------------------------------------------------
+// doc_write_compact
+//
+// Writes the document as JSON with no layout, cell entries that hold the
+// default value, i.e. no colour or no text, are left out as they are
+// defaults when the file is read
+//
+// --------------------------------------------------------------------------
+
+void doc_write_compact( output_writer *writer, mapter_doc *doc )
+{
+  const gchar *names[3] = { TEXT_SUMMARY, TEXT_HEADING, TEXT_BODY };
+  gsize length;
+  gboolean escaped;
+
+  writer_printf( writer, "{\"%s\":%d,\"%s\":%d,\"%s\":%d,\"%s\":[",
+                 VERSION, SAVE_FILE_VERSION_NUMBER, ROWS, doc->rows, COLUMNS, doc->columns, TEXT_GRID );
+  for( gint i=0; i<( doc->rows * doc->columns ); i++ )
+  {
+    doc_cell *cell = &doc->cells[i];
+    doc_text *texts[3] = { &cell->summary, &cell->heading, &cell->body };
+    // Comma before each entry in the cell apart from the first
+    const gchar *separator = "";
+    writer_puts( writer, ( i > 0 ) ? ",{" : "{" );
+    if( cell->colour != NONE )
+    {
+      writer_printf( writer, "\"%s\":%i", CELL_BACKGROUND_COLOUR, cell->colour );
+      separator = ",";
+    }
+    for( gint t=0; t<3; t++ )
+    {
+      // Only the length is needed, so encoded text is left as it is
+      doc_text_source( texts[t], &length, &escaped );
+      if( length > 0 )
+      {
+        writer_printf( writer, "%s\"%s\":\"", separator, names[t] );
+        json_encode_text( writer, texts[t] );
+        writer_puts( writer, "\"" );
+        separator = ",";
+      }
+    }
+    writer_puts( writer, "}" );
+  }
+
+  // The notes must have all their entries
+  writer_printf( writer, "],\"%s\":[", TREE_NOTES );
+  GArray *index = g_array_new( FALSE, TRUE, sizeof( gint ) );
+  for( guint n=0; n<doc->notes->len; n++ )
+  {
+    doc_note *note = &g_array_index( doc->notes, doc_note, n );
+    doc_note_index( index, note );
+    writer_puts( writer, ( n > 0 ) ? ",{\"" TREE_INDEX "\":\"" : "{\"" TREE_INDEX "\":\"" );
+    doc_write_note_index( writer, index );
+    writer_puts( writer, "\",\"" TREE_HEADING "\":\"" );
+    json_encode_text( writer, &note->heading );
+    writer_puts( writer, "\",\"" TREE_TEXT "\":\"" );
+    json_encode_text( writer, &note->text );
+    writer_puts( writer, "\"}" );
+  }
+  g_array_free( index, TRUE );
+  writer_puts( writer, "]}\n" );
+}
+
+// --------------------------------------------------------------------------
+// doc_write_json
+//
+// Writes the document to the specified file as JSON, either compact or
+// laid out depending on the document
+//
+// --------------------------------------------------------------------------
+
+result_return doc_write_json( FILE *output_file, mapter_doc *doc )
+{
+  result_return write_result = { TRUE, "" };
+  g_info( "doc.c / doc_write_json");
+  output_writer *writer = writer_new( output_file );
+  if( doc->compact == TRUE )
+  {
+    doc_write_compact( writer, doc );
+  }
+  else
+  {
+    doc_write_indented( writer, doc );
+  }
+  if( writer_free( writer ) == FALSE )
+  {
+    g_info( "  ERROR: Could not write file" );
+    write_result.result = FALSE;
+    write_result.message = "Could not write file";
+  }
+  g_info( "doc.c / ~doc_write_json");
+  return write_result;
+}
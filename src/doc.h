@@ -0,0 +1,186 @@
+// doc.h - header file for doc.c
+//         part of the mapter program
+// Copyright (C) 2020 John Davies
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef DOC_H
+#define DOC_H
+
+#include <stdio.h>
+
+// Heading given to the notes from older files that had a single block of notes
+#define IMPORTED_NOTES_HEADING "Imported Text"
+
+// Text held by the document model
+// Text loaded from a file can be left in the file buffer until it's first
+// used, in which case "raw" points into that buffer and "text" is NULL
+typedef struct {
+  gchar *text;            // Decoded GRefString or NULL if not decoded yet
+  const gchar *raw;       // Undecoded text in the source buffer
+  gsize raw_length;
+  gboolean escaped;       // raw is the contents of a JSON string
+} doc_text;
+
+// A single cell of the text grid
+typedef struct {
+  background_colour_type colour;
+  doc_text summary;
+  doc_text heading;
+  doc_text body;
+  guint changed;          // Change count when last changed, 0 if never
+} doc_cell;
+
+// A single entry of the notes tree, entries are held in depth first order
+typedef struct {
+  gint level;             // Depth in the tree, 0 = top level
+  doc_text heading;
+  doc_text text;
+  guint changed;          // Change count when last changed, 0 if never
+} doc_note;
+
+// Cell text selection for doc_decode
+#define DECODE_SUMMARY 0x01
+#define DECODE_HEADING 0x02
+#define DECODE_BODY 0x04
+
+// Grids smaller than this are decoded without any extra threads
+#define DECODE_PARALLEL_CELLS 512
+#define DECODE_BLOCKS_PER_THREAD 4
+
+// Position while scanning a JSON file
+typedef struct {
+  const gchar *start;
+  const gchar *ptr;
+  const gchar *end;
+} json_scanner;
+
+// Longest key that the JSON scan needs to recognise
+#define MAX_SCAN_KEY 32
+
+// The complete mapter document
+typedef struct {
+  gint rows;
+  gint columns;
+  doc_cell *cells;        // rows * columns cells in row order
+  GArray *notes;          // doc_note entries
+  GBytes *source;         // Buffer that any raw text points into
+  gboolean compact;       // Save as JSON without layout or default values
+  // Every change to the document is counted, anything changed after the
+  // count of the last save is unsaved
+  guint changes;
+  guint saved_changes;
+  guint structure_changed;  // Rows or columns inserted or deleted
+  guint notes_changed;    // Any note, the notes changed since are stamped
+  guint notes_structure_changed;  // Notes added or deleted
+  guint notes_captured;   // Notes changed count when copied from the tree
+  guint format_changed;   // Compact or not, only saved with the file
+} mapter_doc;
+
+// Which way round the grid is read as chapters of sections
+typedef enum { ROWS_AS_CHAPTERS = 0, COLUMNS_AS_CHAPTERS } doc_order;
+
+// A name from a header cell, looked up once when a traversal is set up
+typedef struct {
+  const gchar *text;
+  gsize length;
+} doc_name;
+
+// Reads the grid as chapters of sections in either order, chapter and
+// section 0 are the headers. The cells are in a single array so either
+// order is just a different step between cells. The names in the headers
+// are resolved up front so the chapters can be written, on any thread,
+// without going back to the header cells for each section
+typedef struct {
+  doc_cell *cells;
+  gint chapters;          // Including the header row or column
+  gint sections;
+  gint chapter_step;      // Cells between the same section of two chapters
+  gint section_step;      // Cells between two sections of a chapter
+  doc_name *titles;       // Of each chapter, title 0 is the whole work's
+  doc_name *series;       // Series name of each section
+  GArray *notes;          // doc_note entries of the document, for an appendix
+} doc_traversal;
+
+// A block of rows decoded by one doc_decode task
+typedef struct {
+  mapter_doc *doc;
+  gint first_row;
+  gint last_row;          // One past the last row of the block
+  guint fields;           // DECODE_ flags
+} doc_decode_block;
+
+void doc_note_clear( gpointer );
+void doc_cell_clear( doc_cell * );
+
+mapter_doc *doc_new( gint, gint );
+void doc_free( mapter_doc * );
+doc_cell *doc_get_cell( mapter_doc *, gint, gint );
+void doc_traverse( mapter_doc *, doc_order, doc_traversal * );
+void doc_traversal_clear( doc_traversal * );
+doc_cell *doc_traversal_cell( doc_traversal *, gint, gint );
+void doc_traversal_name( doc_name *, doc_text * );
+
+const gchar *doc_text_get( doc_text * );
+const gchar *doc_text_peek( doc_text *, gsize * );
+const gchar *doc_text_source( doc_text *, gsize *, gboolean * );
+void doc_text_set( doc_text *, const gchar * );
+void doc_text_clear( doc_text * );
+void doc_text_share( doc_text *, const doc_text * );
+mapter_doc *doc_snapshot( mapter_doc * );
+
+guint doc_changed( mapter_doc * );
+void doc_cell_changed( mapter_doc *, doc_cell * );
+void doc_structure_changed( mapter_doc * );
+void doc_notes_changed( mapter_doc * );
+void doc_note_changed( mapter_doc *, gint );
+gboolean doc_is_dirty( mapter_doc * );
+gboolean doc_unjournalled( mapter_doc * );
+gboolean doc_cell_is_dirty( mapter_doc *, doc_cell * );
+void doc_saved( mapter_doc *, guint );
+
+void doc_decode( mapter_doc *, guint );
+void doc_decode_worker( gpointer, gpointer );
+
+void doc_insert_row( mapter_doc *, gint );
+void doc_insert_column( mapter_doc *, gint );
+void doc_delete_row( mapter_doc *, gint );
+void doc_delete_column( mapter_doc *, gint );
+
+void doc_add_note( mapter_doc *, gint, const gchar *, const gchar * );
+void doc_clear_notes( mapter_doc * );
+
+gboolean json_scan_space( json_scanner * );
+gboolean json_scan_char( json_scanner *, gchar );
+gboolean json_scan_string( json_scanner *, doc_text *, gboolean * );
+gboolean json_scan_int( json_scanner *, gint * );
+gboolean json_scan_skip( json_scanner * );
+gboolean json_scan_key( json_scanner *, gchar *, gsize );
+gboolean json_scan_cell( json_scanner *, doc_cell * );
+gboolean json_scan_note( json_scanner *, doc_note * );
+mapter_doc *json_scan_doc( json_scanner * );
+result_return doc_load_json( GBytes *, mapter_doc ** );
+result_return doc_read_json( const gchar *, gsize, mapter_doc ** );
+result_return doc_write_json( FILE *, mapter_doc * );
+gboolean json_is_compact( const gchar *, gsize );
+gint doc_note_index( GArray *, doc_note * );
+void doc_write_note_index( output_writer *, GArray * );
+void doc_write_indented( output_writer *, mapter_doc * );
+void doc_write_compact( output_writer *, mapter_doc * );
+
+void json_encode_text( output_writer *, doc_text * );
+gchar *json_decode_len( const gchar *, gsize );
+gunichar json_decode_hex( const gchar * );
+
+#endif
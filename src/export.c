@@ -0,0 +1,776 @@
+// export.c - exports a mapter document as plain text
+//            part of the mapter program
+// Copyright (C) 2020 John Davies
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// The export only reads the document model and writes to an output
+// writer, nothing here touches the widgets so it can be used from the
+// command line or from any thread
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <zlib.h>
+#include <gtk/gtk.h>
+#include <glib/gstdio.h>
+#include "main.h"
+#include "doc.h"
+#include "config.h"
+#include "file.h"
+#include "save.h"
+#include "writer.h"
+#include "template.h"
+#include "export.h"
+#include "incremental.h"
+#include "zip.h"
+#include "package.h"
+#include "outline.h"
+
+// Line ends are doubled when carriage returns are duplicated
+
+const line_transform export_double_lines = LINE_TRANSFORM( "", "\n\n" );
+
+// --------------------------------------------------------------------------
+// export_files
+//
+// Entry point for the --export option, none of GTK is used
+// IN OUT [ --title ] [ --series ] [ --single-cr ] [ --columns ] [ --split ]
+//        [ --incremental ] [ --notes ] [ --outline FILE ]
+//        [ --format NAME | --template FILE ]
+//
+// --------------------------------------------------------------------------
+
+gint export_files( gint count, gchar **args )
+{
+  export_options options = EXPORT_DEFAULT_OPTIONS;
+  const gchar *file_paths[2] = { NULL, NULL };
+  const gchar *format = EXPORT_FORMAT_TEXT;
+  const gchar *template_path = NULL;
+  const gchar *outline_path = NULL;
+  gboolean split = FALSE;
+  gboolean exported;
+  gint files = 0;
+  mapter_doc *doc;
+
+  g_info( "export.c / export_files");
+  for( gint i=0; i<count; i++ )
+  {
+    if( strcmp( args[i], EXPORT_TITLE_OPTION ) == 0 )
+    {
+      options.title = TRUE;
+    }
+    else if( strcmp( args[i], EXPORT_SERIES_OPTION ) == 0 )
+    {
+      options.add_series = TRUE;
+    }
+    else if( strcmp( args[i], EXPORT_SINGLE_CR_OPTION ) == 0 )
+    {
+      options.dup_cr = FALSE;
+    }
+    else if( strcmp( args[i], EXPORT_COLUMNS_OPTION ) == 0 )
+    {
+      options.order = COLUMNS_AS_CHAPTERS;
+    }
+    else if( strcmp( args[i], EXPORT_SPLIT_OPTION ) == 0 )
+    {
+      split = TRUE;
+    }
+    else if( strcmp( args[i], EXPORT_INCREMENTAL_OPTION ) == 0 )
+    {
+      options.incremental = TRUE;
+    }
+    else if( strcmp( args[i], EXPORT_NOTES_OPTION ) == 0 )
+    {
+      options.notes = TRUE;
+    }
+    else if( ( strcmp( args[i], EXPORT_OUTLINE_OPTION ) == 0 ) && ( i + 1 < count ) )
+    {
+      outline_path = args[ ++i ];
+    }
+    else if( ( strcmp( args[i], EXPORT_FORMAT_OPTION ) == 0 ) && ( i + 1 < count ) )
+    {
+      format = args[ ++i ];
+    }
+    else if( ( strcmp( args[i], EXPORT_TEMPLATE_OPTION ) == 0 ) && ( i + 1 < count ) )
+    {
+      template_path = args[ ++i ];
+    }
+    else if( files < 2 )
+    {
+      file_paths[ files++ ] = args[i];
+    }
+    else
+    {
+      files++;
+    }
+  }
+  if( files != 2 )
+  {
+    fprintf( stderr, "Usage: %s %s IN OUT [ %s ] [ %s ] [ %s ] [ %s ] [ %s ] [ %s ] [ %s ] [ %s FILE ] "
+             "[ %s NAME | %s FILE ]\n",
+             APP_NAME, EXPORT_OPTION, EXPORT_TITLE_OPTION, EXPORT_SERIES_OPTION, EXPORT_SINGLE_CR_OPTION,
+             EXPORT_COLUMNS_OPTION, EXPORT_SPLIT_OPTION, EXPORT_INCREMENTAL_OPTION, EXPORT_NOTES_OPTION,
+             EXPORT_OUTLINE_OPTION, EXPORT_FORMAT_OPTION, EXPORT_TEMPLATE_OPTION );
+    return EXIT_FAILURE;
+  }
+  // The template is compiled once before anything is exported
+  result_return result = ( template_path != NULL ) ? template_load( template_path, &options.template ) :
+                                                     export_format( format, &options );
+  if( result.result == FALSE )
+  {
+    fprintf( stderr, "%s: %s\n", ( template_path != NULL ) ? template_path : format, result.message );
+    return EXIT_FAILURE;
+  }
+  result = load_document( file_paths[0], &doc );
+  if( result.result == FALSE )
+  {
+    fprintf( stderr, "%s: %s\n", file_paths[0], result.message );
+    template_free( options.template );
+    return EXIT_FAILURE;
+  }
+  if( split == TRUE )
+  {
+    // OUT is a directory with a file for each chapter
+    GString *report = g_string_new( NULL );
+    exported = export_split( doc, &options, file_paths[1], report );
+    fputs( report->str, stderr );
+    g_string_free( report, TRUE );
+  }
+  else
+  {
+    result = export_file( doc, &options, file_paths[1] );
+    if( result.result == FALSE )
+    {
+      fprintf( stderr, "%s: %s\n", file_paths[1], result.message );
+    }
+    exported = result.result;
+  }
+  if( outline_path != NULL )
+  {
+    // The notes on their own as well
+    result = outline_file( doc, outline_path );
+    if( result.result == FALSE )
+    {
+      fprintf( stderr, "%s: %s\n", outline_path, result.message );
+    }
+    exported = exported && result.result;
+  }
+  doc_free( doc );
+  template_free( options.template );
+
+  g_info( "export.c / ~export_files");
+  return( ( exported == TRUE ) ? EXIT_SUCCESS : EXIT_FAILURE );
+}
+
+// --------------------------------------------------------------------------
+// export_file
+//
+// Exports a document to the specified file, which is only replaced once
+// the whole export has been written
+//
+// --------------------------------------------------------------------------
+
+result_return export_file( mapter_doc *doc, const export_options *options, const gchar *file_path )
+{
+  doc_traversal traversal;
+
+  g_info( "export.c / export_file");
+  // A package is compressed as a whole so it's always written in full
+  if( ( options->incremental == TRUE ) && ( options->package == PACKAGE_NONE ) )
+  {
+    g_info( "export.c / ~export_file");
+    return incremental_export( doc, options, file_path );
+  }
+  doc_traverse( doc, options->order, &traversal );
+  result_return export_result = export_write( file_path, &traversal, options, options->title,
+                                              1, traversal.chapters );
+  doc_traversal_clear( &traversal );
+  g_info( "export.c / ~export_file");
+  return export_result;
+}
+
+// --------------------------------------------------------------------------
+// export_write
+//
+// Exports a range of chapters to a file in the same way as export_file
+//
+// --------------------------------------------------------------------------
+
+result_return export_write( const gchar *file_path, doc_traversal *traversal, const export_options *options,
+                            gboolean title, gint first, gint last )
+{
+  save_target *target;
+
+  g_info( "export.c / export_write");
+  if( options->package != PACKAGE_NONE )
+  {
+    g_info( "export.c / ~export_write");
+    return package_write( file_path, traversal, options, title, first, last );
+  }
+  g_info( "  Export filename: %s", file_path );
+  result_return export_result = save_begin( file_path, FALSE, &target );
+  if( export_result.result == TRUE )
+  {
+    output_writer *writer = writer_new( target->file );
+    export_chapters( traversal, options, title, first, last, writer );
+    if( writer_free( writer ) == TRUE )
+    {
+      export_result = save_finish( target, 0 );
+    }
+    else
+    {
+      save_abort( target );
+      export_result.result = FALSE;
+      export_result.message = "Could not write export file";
+    }
+  }
+
+  g_info( "export.c / ~export_write");
+  return export_result;
+}
+
+// --------------------------------------------------------------------------
+// export_split
+//
+// Exports each chapter to its own file in a directory, with the title in
+// a file of its own first and the notes in one at the end if they're
+// wanted. The files are written in parallel, each worker streams straight
+// to its file so only a buffer per thread is needed however large the
+// document. Any files that couldn't be written are listed in the report
+//
+// --------------------------------------------------------------------------
+
+gboolean export_split( mapter_doc *doc, const export_options *options, const gchar *directory, GString *report )
+{
+  doc_traversal traversal;
+  gchar *settings = NULL;
+  gchar *manifest_path = NULL;
+  GArray *previous = NULL;
+  gint failed = 0;
+  gint unchanged = 0;
+
+  g_info( "export.c / export_split");
+  g_info( "  Export directory: %s", directory );
+  if( g_mkdir_with_parents( directory, EXPORT_SPLIT_MODE ) != 0 )
+  {
+    g_string_append_printf( report, "%s: %s\n", directory, g_strerror( errno ) );
+    g_info( "export.c / ~export_split");
+    return FALSE;
+  }
+  // Text is decoded the first time it's used, so do it all now and then
+  // the workers only ever read the document
+  doc_decode( doc, DECODE_SUMMARY | DECODE_HEADING | DECODE_BODY );
+  doc_traverse( doc, options->order, &traversal );
+  const gchar *extension = ( options->template != NULL ) ? options->template->extension :
+                                                           TEMPLATE_DEFAULT_EXTENSION;
+  // The notes only go in their own file, numbered after the last chapter
+  export_options chapter_options = *options;
+  chapter_options.notes = FALSE;
+  gint notes = ( ( options->notes == TRUE ) && ( traversal.notes->len > 0 ) ) ? 1 : 0;
+  gint first = ( options->title == TRUE ) ? 0 : 1;
+  gint count = traversal.chapters - first + notes;
+  // Numbered to the same width so that the files list in order
+  gint digits = g_snprintf( NULL, 0, "%d", traversal.chapters - 1 + notes );
+  if( options->incremental == TRUE )
+  {
+    settings = incremental_settings( &traversal, &chapter_options );
+    manifest_path = g_build_filename( directory, INCREMENTAL_SPLIT_NAME, NULL );
+    previous = incremental_load( manifest_path );
+    g_remove( manifest_path );
+  }
+
+  export_split_job *jobs = g_new0( export_split_job, count );
+  GThreadPool *pool = g_thread_pool_new( export_split_worker, NULL, g_get_num_processors(), FALSE, NULL );
+  for( gint i=0; i<count; i++ )
+  {
+    jobs[i].traversal = &traversal;
+    jobs[i].chapter = first + i;
+    jobs[i].options = ( jobs[i].chapter < traversal.chapters ) ? &chapter_options : options;
+    gchar *name = export_split_name( &traversal, jobs[i].chapter, digits, extension );
+    jobs[i].file_path = g_build_filename( directory, name, NULL );
+    if( settings != NULL )
+    {
+      jobs[i].hash = incremental_hash( settings, &traversal, jobs[i].chapter );
+    }
+    if( ( jobs[i].hash != NULL ) && ( incremental_unchanged( previous, name, jobs[i].hash, jobs[i].file_path ) == TRUE ) )
+    {
+      // Left as it is
+      jobs[i].result.result = TRUE;
+      unchanged++;
+    }
+    else
+    {
+      g_thread_pool_push( pool, &jobs[i], NULL );
+    }
+    g_free( name );
+  }
+  // Wait for them all to finish
+  g_thread_pool_free( pool, FALSE, TRUE );
+
+  GArray *current = incremental_new();
+  for( gint i=0; i<count; i++ )
+  {
+    GStatBuf info;
+    if( jobs[i].result.result == FALSE )
+    {
+      g_string_append_printf( report, "%s: %s\n", jobs[i].file_path, jobs[i].result.message );
+      failed++;
+    }
+    else if( ( jobs[i].hash != NULL ) && ( g_stat( jobs[i].file_path, &info ) == 0 ) )
+    {
+      gchar *name = g_path_get_basename( jobs[i].file_path );
+      incremental_add( current, jobs[i].hash, info.st_size, name );
+      g_array_index( current, incremental_entry, current->len - 1 ).modified = incremental_modified( &info );
+      g_free( name );
+    }
+    g_free( jobs[i].file_path );
+    g_free( jobs[i].hash );
+  }
+  g_free( jobs );
+  if( options->incremental == TRUE )
+  {
+    // A file that couldn't be replaced is still there from last time
+    if( failed == 0 )
+    {
+      incremental_remove_stale( previous, current, directory );
+    }
+    incremental_save( manifest_path, current );
+  }
+  g_array_free( current, TRUE );
+  if( previous != NULL )
+  {
+    g_array_free( previous, TRUE );
+  }
+  g_free( manifest_path );
+  g_free( settings );
+  doc_traversal_clear( &traversal );
+  if( failed > 0 )
+  {
+    g_string_append_printf( report, "%d of %d files could not be exported\n", failed, count );
+  }
+
+  g_info( "  Exported %d files, %d unchanged, %d failed", count - failed - unchanged, unchanged, failed );
+  g_info( "export.c / ~export_split");
+  return( failed == 0 );
+}
+
+// --------------------------------------------------------------------------
+// export_split_worker
+//
+// Thread pool function to export a single file of a split export
+//
+// --------------------------------------------------------------------------
+
+void export_split_worker( gpointer data, gpointer user_data )
+{
+  export_split_job *job = (export_split_job *) data;
+  if( job->chapter == 0 )
+  {
+    job->result = export_write( job->file_path, job->traversal, job->options, TRUE, 1, 1 );
+  }
+  else if( job->chapter == job->traversal->chapters )
+  {
+    // Just the notes, which are written with the closing
+    job->result = export_write( job->file_path, job->traversal, job->options, FALSE, 1, 1 );
+  }
+  else
+  {
+    job->result = export_write( job->file_path, job->traversal, job->options, FALSE,
+                                job->chapter, job->chapter + 1 );
+  }
+}
+
+// --------------------------------------------------------------------------
+// export_split_name
+//
+// Returns the file name for a chapter of a split export, the chapter
+// number followed by its title with anything that isn't a letter or a
+// digit replaced by a dash, e.g. 03-The-Somme.txt. The chapter after the
+// last is the notes
+//
+// --------------------------------------------------------------------------
+
+gchar *export_split_name( doc_traversal *traversal, gint chapter, gint digits, const gchar *extension )
+{
+  const gchar *title = ( chapter < traversal->chapters ) ? traversal->titles[ chapter ].text :
+                                                           OUTLINE_APPENDIX_TITLE;
+  GString *name = g_string_new( NULL );
+
+  g_string_printf( name, "%0*d-", digits, chapter );
+  for( gint length=0; ( *title != '\0' ) && ( length < EXPORT_SPLIT_NAME_LENGTH ); length++ )
+  {
+    gunichar ch = g_utf8_get_char( title );
+    if( g_unichar_isalnum( ch ) == TRUE )
+    {
+      g_string_append_unichar( name, ch );
+    }
+    else if( name->str[ name->len - 1 ] != '-' )
+    {
+      g_string_append_c( name, '-' );
+    }
+    title = g_utf8_next_char( title );
+  }
+  // Also drops the dash after the number if there's no title
+  while( name->str[ name->len - 1 ] == '-' )
+  {
+    g_string_truncate( name, name->len - 1 );
+  }
+  g_string_append_printf( name, ".%s", extension );
+  return g_string_free( name, FALSE );
+}
+
+// --------------------------------------------------------------------------
+// export_format
+//
+// Compiles the template for one of the export formats and sets the
+// package for EPUB and ODT, plain text doesn't have a template
+//
+// --------------------------------------------------------------------------
+
+result_return export_format( const gchar *name, export_options *options )
+{
+  options->template = NULL;
+  options->package = PACKAGE_NONE;
+  if( strcmp( name, EXPORT_FORMAT_TEXT ) == 0 )
+  {
+    return( (result_return) { TRUE, "" } );
+  }
+  options->package = package_lookup( name );
+  if( options->package != PACKAGE_NONE )
+  {
+    return package_template( options->package, &options->template );
+  }
+  return template_find( name, &options->template );
+}
+
+// --------------------------------------------------------------------------
+// export_document
+//
+// Writes the whole document, the header row or column holds the series
+// names and the other holds the chapter titles, cell 0,0 is the title of
+// the whole work
+//
+// --------------------------------------------------------------------------
+
+void export_document( mapter_doc *doc, const export_options *options, output_writer *writer )
+{
+  doc_traversal traversal;
+
+  g_info( "export.c / export_document");
+  g_info( "  title = %s, add_series = %s, dup_cr = %s, columns = %s", btoa( options->title ),
+          btoa( options->add_series ), btoa( options->dup_cr ),
+          btoa( options->order == COLUMNS_AS_CHAPTERS ) );
+  doc_traverse( doc, options->order, &traversal );
+  export_chapters( &traversal, options, options->title, 1, traversal.chapters, writer );
+  doc_traversal_clear( &traversal );
+  g_info( "export.c / ~export_document");
+}
+
+// --------------------------------------------------------------------------
+// export_chapters
+//
+// Writes the chapters from first up to but not including last, in the
+// format selected in the options, with the title first if it's wanted.
+// The opening and closing are always written so that the chapters make a
+// complete file
+//
+// --------------------------------------------------------------------------
+
+void export_chapters( doc_traversal *traversal, const export_options *options, gboolean title,
+                      gint first, gint last, output_writer *writer )
+{
+  export_opening( traversal, options, title, writer );
+  for( gint ch=first; ch<last; ch++ )
+  {
+    export_chapter( traversal, options, ch, writer );
+  }
+  export_closing( traversal, options, writer );
+}
+
+// --------------------------------------------------------------------------
+// export_opening
+//
+// Writes what comes before the first chapter, the start of the template
+// and the title if it's wanted
+//
+// --------------------------------------------------------------------------
+
+void export_opening( doc_traversal *traversal, const export_options *options, gboolean title,
+                     output_writer *writer )
+{
+  doc_cell *title_cell = doc_traversal_cell( traversal, 0, 0 );
+
+  if( options->template != NULL )
+  {
+    template_values values = { { NULL }, { 0 } };
+    template_set( &values, FIELD_TITLE, traversal->titles[0].text, traversal->titles[0].length );
+    template_run( options->template, TEMPLATE_BEGIN, &values, writer );
+    if( title == TRUE )
+    {
+      template_run( options->template, TEMPLATE_TITLE, &values, writer );
+      export_paragraphs( options->template, &values, &title_cell->body, options->dup_cr, writer );
+    }
+  }
+  else if( title == TRUE )
+  {
+    // The title line is written even if it's empty
+    writer_puts( writer, doc_text_get( &title_cell->heading ) );
+    writer_puts( writer, "\n\n" );
+    export_body( writer, &title_cell->body, FALSE );
+  }
+}
+
+// --------------------------------------------------------------------------
+// export_chapter
+//
+// Writes a single chapter in the format selected in the options
+//
+// --------------------------------------------------------------------------
+
+void export_chapter( doc_traversal *traversal, const export_options *options, gint chapter,
+                     output_writer *writer )
+{
+  if( options->template != NULL )
+  {
+    export_formatted( traversal, options, chapter, writer );
+  }
+  else
+  {
+    export_plain( traversal, options, chapter, writer );
+  }
+}
+
+// --------------------------------------------------------------------------
+// export_piece
+//
+// Writes one piece of an export, piece 0 is the opening, then each
+// chapter and the last piece, numbered the same as the chapter count, is
+// the closing
+//
+// --------------------------------------------------------------------------
+
+void export_piece( doc_traversal *traversal, const export_options *options, gint piece, output_writer *writer )
+{
+  if( piece == 0 )
+  {
+    export_opening( traversal, options, options->title, writer );
+  }
+  else if( piece == traversal->chapters )
+  {
+    export_closing( traversal, options, writer );
+  }
+  else
+  {
+    export_chapter( traversal, options, piece, writer );
+  }
+}
+
+// --------------------------------------------------------------------------
+// export_closing
+//
+// Writes what comes after the last chapter, the notes if they're wanted
+// and then the end of the template
+//
+// --------------------------------------------------------------------------
+
+void export_closing( doc_traversal *traversal, const export_options *options, output_writer *writer )
+{
+  outline_appendix( traversal, options, writer );
+  if( options->template != NULL )
+  {
+    template_values values = { { NULL }, { 0 } };
+    template_set( &values, FIELD_TITLE, traversal->titles[0].text, traversal->titles[0].length );
+    template_run( options->template, TEMPLATE_END, &values, writer );
+  }
+}
+
+// --------------------------------------------------------------------------
+// export_plain
+//
+// Writes a chapter as plain text
+//
+// --------------------------------------------------------------------------
+
+void export_plain( doc_traversal *traversal, const export_options *options, gint chapter,
+                   output_writer *writer )
+{
+  // Chapter title is in the header, column headers usually only have
+  // a summary so the title looked up by the traversal falls back to that
+  doc_cell *header = doc_traversal_cell( traversal, chapter, 0 );
+  if( options->order == COLUMNS_AS_CHAPTERS )
+  {
+    doc_name *name = &traversal->titles[ chapter ];
+    if( name->length > 0 )
+    {
+      writer_write( writer, name->text, name->length );
+      writer_puts( writer, "\n\n" );
+    }
+  }
+  else
+  {
+    export_text( writer, &header->heading );
+  }
+  // Now the sections
+  for( gint s=1; s<traversal->sections; s++ )
+  {
+    doc_cell *cell = doc_traversal_cell( traversal, chapter, s );
+    if( *doc_text_get( &cell->heading ) != '\0' )
+    {
+      if( options->add_series == TRUE )
+      {
+        writer_write( writer, traversal->series[s].text, traversal->series[s].length );
+        writer_puts( writer, " - " );
+      }
+      export_text( writer, &cell->heading );
+    }
+    export_body( writer, &cell->body, options->dup_cr );
+  }
+  writer_puts( writer, "\n" );
+}
+
+// --------------------------------------------------------------------------
+// export_text
+//
+// Writes a heading followed by a blank line, nothing is written if the
+// heading is empty
+//
+// --------------------------------------------------------------------------
+
+void export_text( output_writer *writer, doc_text *text )
+{
+  const gchar *str = doc_text_get( text );
+  if( *str != '\0' )
+  {
+    writer_puts( writer, str );
+    writer_puts( writer, "\n\n" );
+  }
+}
+
+// --------------------------------------------------------------------------
+// export_body
+//
+// Writes body text followed by a blank line, nothing is written if the
+// body is empty. With dup_cr every line is followed by a blank line
+//
+// --------------------------------------------------------------------------
+
+void export_body( output_writer *writer, doc_text *text, gboolean dup_cr )
+{
+  gsize length;
+  const gchar *str = doc_text_peek( text, &length );
+  if( length == 0 )
+  {
+    return;
+  }
+  if( dup_cr == TRUE )
+  {
+    writer_lines( writer, str, length, &export_double_lines );
+  }
+  else
+  {
+    writer_write( writer, str, length );
+  }
+  writer_puts( writer, "\n\n" );
+}
+
+// --------------------------------------------------------------------------
+// export_formatted
+//
+// Writes a chapter using a template, each cell with a heading is a section
+// in the chapter
+//
+// --------------------------------------------------------------------------
+
+void export_formatted( doc_traversal *traversal, const export_options *options, gint chapter,
+                       output_writer *writer )
+{
+  template_values values = { { NULL }, { 0 } };
+  gchar row[ 16 ];
+  gchar column[ 16 ];
+  const gchar *text;
+
+  export_template *template = options->template;
+  template_set( &values, FIELD_TITLE, traversal->titles[0].text, traversal->titles[0].length );
+
+  // The row and column fields are always the position in the grid
+  gchar *chapter_field = ( options->order == COLUMNS_AS_CHAPTERS ) ? column : row;
+  gchar *section_field = ( options->order == COLUMNS_AS_CHAPTERS ) ? row : column;
+  template_field chapter_id = ( options->order == COLUMNS_AS_CHAPTERS ) ? FIELD_COLUMN : FIELD_ROW;
+  template_field section_id = ( options->order == COLUMNS_AS_CHAPTERS ) ? FIELD_ROW : FIELD_COLUMN;
+  template_set( &values, chapter_id, chapter_field, g_snprintf( chapter_field, sizeof( row ), "%d", chapter ) );
+  template_set( &values, FIELD_CHAPTER, traversal->titles[ chapter ].text, traversal->titles[ chapter ].length );
+  if( traversal->titles[ chapter ].length > 0 )
+  {
+    template_run( template, TEMPLATE_CHAPTER, &values, writer );
+  }
+  for( gint s=1; s<traversal->sections; s++ )
+  {
+    doc_cell *cell = doc_traversal_cell( traversal, chapter, s );
+    template_set( &values, section_id, section_field, g_snprintf( section_field, sizeof( row ), "%d", s ) );
+    template_set( &values, FIELD_SERIES, traversal->series[s].text, traversal->series[s].length );
+    text = doc_text_get( &cell->heading );
+    template_set( &values, FIELD_HEADING, text, strlen( text ) );
+    if( *text != '\0' )
+    {
+      template_run( template, ( options->add_series == TRUE ) ? TEMPLATE_SERIES_SECTION : TEMPLATE_SECTION,
+                    &values, writer );
+    }
+    export_paragraphs( template, &values, &cell->body, options->dup_cr, writer );
+  }
+}
+
+// --------------------------------------------------------------------------
+// export_paragraphs
+//
+// Writes each paragraph of body text using the paragraph template. With
+// dup_cr every line is a paragraph, otherwise they're separated by a
+// blank line
+//
+// --------------------------------------------------------------------------
+
+void export_paragraphs( export_template *template, template_values *values, doc_text *text,
+                        gboolean dup_cr, output_writer *writer )
+{
+  const gchar *separator = ( dup_cr == TRUE ) ? "\n" : "\n\n";
+  gsize separator_length = strlen( separator );
+  const gchar *str = doc_text_get( text );
+
+  while( *str != '\0' )
+  {
+    const gchar *end = strstr( str, separator );
+    if( end == NULL )
+    {
+      end = str + strlen( str );
+    }
+    // Extra blank lines don't make empty paragraphs
+    const gchar *start = str;
+    while( ( start < end ) && ( *start == '\n' ) )
+    {
+      start++;
+    }
+    const gchar *last = end;
+    while( ( last > start ) && ( last[-1] == '\n' ) )
+    {
+      last--;
+    }
+    if( last > start )
+    {
+      template_set( values, FIELD_TEXT, start, last - start );
+      template_run( template, TEMPLATE_PARAGRAPH, values, writer );
+    }
+    str = ( *end == '\0' ) ? end : end + separator_length;
+  }
+}
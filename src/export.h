@@ -0,0 +1,89 @@
+// export.h - header file for export.c
+//            part of the mapter program
+// Copyright (C) 2020 John Davies
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef EXPORT_H
+#define EXPORT_H
+
+// Command line options
+#define EXPORT_OPTION "--export"
+#define EXPORT_TITLE_OPTION "--title"
+#define EXPORT_SERIES_OPTION "--series"
+#define EXPORT_SINGLE_CR_OPTION "--single-cr"
+#define EXPORT_COLUMNS_OPTION "--columns"
+#define EXPORT_SPLIT_OPTION "--split"
+#define EXPORT_INCREMENTAL_OPTION "--incremental"
+#define EXPORT_FORMAT_OPTION "--format"
+#define EXPORT_TEMPLATE_OPTION "--template"
+#define EXPORT_NOTES_OPTION "--notes"
+#define EXPORT_OUTLINE_OPTION "--outline"
+
+// Plain text doesn't use a template
+#define EXPORT_FORMAT_TEXT "text"
+
+// Formats written as a zip of several files rather than a single file,
+// see package.c
+typedef enum { PACKAGE_NONE = 0, PACKAGE_EPUB, PACKAGE_ODT } export_package;
+
+// What goes into an export, the defaults match the export dialog
+typedef struct {
+  gboolean title;         // Heading and body of cell 0,0 at the start
+  gboolean dup_cr;        // Blank line after every line of the body text
+  gboolean add_series;    // Series name in front of each section heading
+  doc_order order;        // Whether the rows or the columns are the chapters
+  gboolean incremental;   // Only export the chapters changed since the last export
+  export_template *template;  // Format to export in, NULL for plain text
+  export_package package;     // Container the template output goes into
+  gboolean notes;         // Notes tree added at the end as an appendix
+} export_options;
+
+#define EXPORT_DEFAULT_OPTIONS { FALSE, TRUE, FALSE, ROWS_AS_CHAPTERS, FALSE, NULL, PACKAGE_NONE, FALSE }
+
+// Most characters of a chapter title used in a split export file name
+#define EXPORT_SPLIT_NAME_LENGTH 60
+// Permissions of a split export directory that has to be created
+#define EXPORT_SPLIT_MODE 0755
+
+// One file of a split export, written by a worker thread
+typedef struct {
+  doc_traversal *traversal;
+  const export_options *options;
+  gint chapter;           // 0 for the title, one after the last for the notes
+  gchar *file_path;
+  gchar *hash;            // Of the contents for an incremental export
+  result_return result;
+} export_split_job;
+
+gint export_files( gint, gchar ** );
+result_return export_file( mapter_doc *, const export_options *, const gchar * );
+result_return export_write( const gchar *, doc_traversal *, const export_options *, gboolean, gint, gint );
+gboolean export_split( mapter_doc *, const export_options *, const gchar *, GString * );
+void export_split_worker( gpointer, gpointer );
+gchar *export_split_name( doc_traversal *, gint, gint, const gchar * );
+result_return export_format( const gchar *, export_options * );
+void export_document( mapter_doc *, const export_options *, output_writer * );
+void export_chapters( doc_traversal *, const export_options *, gboolean, gint, gint, output_writer * );
+void export_opening( doc_traversal *, const export_options *, gboolean, output_writer * );
+void export_chapter( doc_traversal *, const export_options *, gint, output_writer * );
+void export_piece( doc_traversal *, const export_options *, gint, output_writer * );
+void export_closing( doc_traversal *, const export_options *, output_writer * );
+void export_plain( doc_traversal *, const export_options *, gint, output_writer * );
+void export_formatted( doc_traversal *, const export_options *, gint, output_writer * );
+void export_paragraphs( export_template *, template_values *, doc_text *, gboolean, output_writer * );
+void export_text( output_writer *, doc_text * );
+void export_body( output_writer *, doc_text *, gboolean );
+
+#endif
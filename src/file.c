@@ -20,12 +20,33 @@
 #include <string.h>
 #include <gtk/gtk.h>
 #include "main.h"
+#include "doc.h"
+#include "binfile.h"
+#include "compress.h"
+#include "config.h"
+#include "save.h"
+#include "journal.h"
+#include "template.h"
+#include "export.h"
+#include "outline.h"
 #include "file.h"
 #include "grid.h"
 #include "list.h"
 #include "util.h"
-#include "json.h"
 #include "tree.h"
+#include "preview.h"
+
+// Background save that's running and the one waiting to follow it
+
+GThread *save_thread = NULL;
+save_job *pending_save = NULL;
+// Number of the save that's running, each save gets the next number so a
+// finished save can't be mistaken for a later one
+guint save_generation = 0;
+
+// Autosave timer, 0 if not running
+
+guint autosave_timer = 0;
 
 // --------------------------------------------------------------------------
 // on_about_activate
@@ -64,9 +85,8 @@ void on_dlg_about_response( GtkDialog *dialog, gint response_id, app_widgets *ap
 
 void on_export_activate( GtkMenuItem *menuitem, app_widgets *app_wdgts )
 {
-  gboolean use_cell_0_0;
-  gboolean dup_cr;
-  gboolean add_series;
+  export_options options;
+  gboolean split;                 // A folder with a file for each chapter
   gchar *file_path = NULL;        // Name of file to open from dialog box
 
   g_info( "file.c / on_export_activate");
@@ -77,100 +97,60 @@ void on_export_activate( GtkMenuItem *menuitem, app_widgets *app_wdgts )
   if( gtk_dialog_run( GTK_DIALOG( app_wdgts->w_dlg_export_options ) ) == GTK_RESPONSE_OK )
   {
     // Get the options
-    use_cell_0_0 = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON( app_wdgts->b_chkbtn_export_title ) );
-    dup_cr = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON( app_wdgts->b_chkbtn_export_dup_cr ) );
-    add_series = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON( app_wdgts->b_chkbtn_export_series ) );
+    options.title = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON( app_wdgts->b_chkbtn_export_title ) );
+    options.dup_cr = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON( app_wdgts->b_chkbtn_export_dup_cr ) );
+    options.add_series = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON( app_wdgts->b_chkbtn_export_series ) );
+    options.order = ( gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON( app_wdgts->b_chkbtn_export_columns ) ) == TRUE ) ?
+                    COLUMNS_AS_CHAPTERS : ROWS_AS_CHAPTERS;
+    split = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON( app_wdgts->b_chkbtn_export_split ) );
+    options.incremental = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON( app_wdgts->b_chkbtn_export_incremental ) );
+    options.notes = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON( app_wdgts->b_chkbtn_export_notes ) );
+    if( options.notes == TRUE )
+    {
+      // Pick up the notes from the General Notes tab
+      capture_tree_notes( list_get_document(), app_wdgts );
+    }
+    // The built in formats always compile
+    export_format( gtk_combo_box_get_active_id( GTK_COMBO_BOX( app_wdgts->w_cmb_export_format ) ), &options );
     // Close the dialog
     gtk_widget_hide(app_wdgts->w_dlg_export_options );
 
-    // Show the "Export" dialog box
+    // Show the "Export" dialog box, choosing a folder for a split export
+    gtk_file_chooser_set_action( GTK_FILE_CHOOSER( app_wdgts->w_dlg_export ),
+                                 ( split == TRUE ) ? GTK_FILE_CHOOSER_ACTION_CREATE_FOLDER :
+                                                     GTK_FILE_CHOOSER_ACTION_SAVE );
     gtk_widget_show( app_wdgts->w_dlg_export );
     // Check return value from Export dialog box to see if user clicked the Export button
     if( gtk_dialog_run( GTK_DIALOG( app_wdgts->w_dlg_export ) ) == GTK_RESPONSE_OK )
     {
       // Get the export file name
       file_path = gtk_file_chooser_get_filename( GTK_FILE_CHOOSER( app_wdgts->w_dlg_export ) );
-      g_info( "  Export filename: %s\n", file_path );
-      if( file_path != NULL )
+      if( ( file_path != NULL ) && ( split == TRUE ) )
       {
-        g_info( "  use_cell_0_0 = %s", btoa( use_cell_0_0 ) );
-        g_info( "  add_series = %s", btoa( add_series ) );
-        // Open export file
-        FILE *output_file = fopen( file_path, "w" );
-        if( output_file != NULL )
+        // Any files that couldn't be written are listed together
+        GString *report = g_string_new( NULL );
+        if( export_split( list_get_document(), &options, file_path, report ) == FALSE )
         {
-          // And export the data
-          // Title
-          if( use_cell_0_0 == TRUE )
-          {
-            gchar *title = list_get_text( HEADER_LIST, 0, 0, app_wdgts );
-            gchar *body = list_get_text( BODY_LIST, 0, 0, app_wdgts );
-            if( title != NULL )
-            {
-              fprintf( output_file, "%s\n\n", title );
-            }
-            if( ( body != NULL ) && ( strlen( body ) > 0 ) )
-            {
-              fprintf( output_file, "%s\n\n", body );
-            }
-          }
-
-          // Rows as chapters
-          g_info( "  Use rows as chapters" );
-          for( gint r=1; r<app_wdgts->current_grid_rows; r++ )
-          {
-            // Chapter title is in column 0
-            gchar *chapter = list_get_text( HEADER_LIST, r, 0, app_wdgts );
-            if( ( chapter != NULL ) && ( strlen( chapter ) > 0 ) )
-            {
-              fprintf( output_file, "%s\n\n", chapter );
-            }
-            // Now the sections
-            for( gint c=1; c<app_wdgts->current_grid_columns; c++ )
-            {
-              gchar *header = list_get_text( HEADER_LIST, r, c, app_wdgts );
-              gchar *body = list_get_text( BODY_LIST, r, c, app_wdgts );
-              // Header
-              if( ( header != NULL ) && ( strlen( header ) > 0 ) )
-              {
-                if( add_series == TRUE )
-                {
-                  fprintf( output_file, "%s - ", fetch_cell_contents( app_wdgts->w_text_grid, 0, c  ) );
-                }
-                fprintf( output_file, "%s\n\n", header );
-              }
-              // Body
-              if( ( body != NULL ) && ( strlen( body ) > 0 ) )
-              {
-                // Check if the CRs need to be duplicated
-                if( dup_cr )
-                {
-                    // Loop through the body text
-                    gchar *ptr = body;
-                    while( *ptr != '\0' )
-                    {
-                      fprintf( output_file, "%c", *ptr );
-                      if( *ptr == '\n' )
-                      {
-                        fprintf( output_file, "\n" );
-                      }
-                      ptr++;
-                    }
-                    fprintf( output_file, "\n\n" );
-                }
-                else
-                {
-                  // Just output the body in one go
-                  fprintf( output_file, "%s\n\n", body );
-                }
-              }
-            }
-            fprintf( output_file, "\n" );
-          }
+          g_info( "  ERROR: %s", report->str );
+          GtkWidget *dialog_box = gtk_message_dialog_new( GTK_WINDOW( app_wdgts->w_dlg_open ),
+                                        GTK_DIALOG_DESTROY_WITH_PARENT,
+                                        GTK_MESSAGE_ERROR,
+                                        GTK_BUTTONS_CLOSE,
+                                        NULL );
+          gtk_message_dialog_set_markup( GTK_MESSAGE_DIALOG (dialog_box), EXPORT_ERROR );
+          gtk_message_dialog_format_secondary_text( GTK_MESSAGE_DIALOG( dialog_box ), "%s", report->str );
+          gtk_dialog_run( GTK_DIALOG( dialog_box ) );
+          gtk_widget_destroy( dialog_box );
         }
-        else
+        g_string_free( report, TRUE );
+      }
+      else if( file_path != NULL )
+      {
+        // And export the data
+        result_return export_result = export_file( list_get_document(), &options, file_path );
+        if( export_result.result == FALSE )
         {
-          g_info( "  ERROR: Could not open file" );
+          g_info( "  ERROR: %s", export_result.message );
           // Show error if necessary
           GtkWidget *dialog_box = gtk_message_dialog_new( GTK_WINDOW( app_wdgts->w_dlg_open ),
                                         GTK_DIALOG_DESTROY_WITH_PARENT,
@@ -181,12 +161,12 @@ void on_export_activate( GtkMenuItem *menuitem, app_widgets *app_wdgts )
           gtk_dialog_run( GTK_DIALOG( dialog_box ) );
           gtk_widget_destroy( dialog_box );
         }
-        fclose( output_file );
       }
       g_free(file_path);
     }
     // Close the export dialog box
     gtk_widget_hide( app_wdgts->w_dlg_export );
+    template_free( options.template );
   }
   else
   {
@@ -197,25 +177,67 @@ void on_export_activate( GtkMenuItem *menuitem, app_widgets *app_wdgts )
 }
 
 // --------------------------------------------------------------------------
-// open_file
+// on_export_notes_activate
 //
-// Opens and loads a saved mapter file
+// Exports the notes tree on its own, the format is picked from the file
+// name extension
 //
 // --------------------------------------------------------------------------
 
-result_return open_file( gchar* file_path, app_widgets *app_wdgts )
+void on_export_notes_activate( GtkMenuItem *menuitem, app_widgets *app_wdgts )
+{
+  gchar *file_path = NULL;
+
+  g_info( "file.c / on_export_notes_activate");
+  mapter_doc *doc = list_get_document();
+  capture_tree_notes( doc, app_wdgts );
+  gtk_file_chooser_set_action( GTK_FILE_CHOOSER( app_wdgts->w_dlg_export ), GTK_FILE_CHOOSER_ACTION_SAVE );
+  gtk_widget_show( app_wdgts->w_dlg_export );
+  if( gtk_dialog_run( GTK_DIALOG( app_wdgts->w_dlg_export ) ) == GTK_RESPONSE_OK )
+  {
+    file_path = gtk_file_chooser_get_filename( GTK_FILE_CHOOSER( app_wdgts->w_dlg_export ) );
+    if( file_path != NULL )
+    {
+      result_return outline_result = outline_file( doc, file_path );
+      if( outline_result.result == FALSE )
+      {
+        g_info( "  ERROR: %s", outline_result.message );
+        GtkWidget *dialog_box = gtk_message_dialog_new( GTK_WINDOW( app_wdgts->w_dlg_open ),
+                                      GTK_DIALOG_DESTROY_WITH_PARENT,
+                                      GTK_MESSAGE_ERROR,
+                                      GTK_BUTTONS_CLOSE,
+                                      NULL );
+        gtk_message_dialog_set_markup( GTK_MESSAGE_DIALOG (dialog_box), OUTLINE_ERROR );
+        gtk_message_dialog_format_secondary_text( GTK_MESSAGE_DIALOG( dialog_box ), "%s", outline_result.message );
+        gtk_dialog_run( GTK_DIALOG( dialog_box ) );
+        gtk_widget_destroy( dialog_box );
+      }
+    }
+    g_free( file_path );
+  }
+  gtk_widget_hide( app_wdgts->w_dlg_export );
+  g_info( "file.c / ~on_export_notes_activate");
+}
+
+// --------------------------------------------------------------------------
+// load_document
+//
+// Loads a saved mapter file in any of the supported formats
+// Doesn't use any widgets so it can be used without the GUI
+//
+// --------------------------------------------------------------------------
+
+result_return load_document( const gchar *file_path, mapter_doc **document )
 {
   char *json_string = NULL;
   long json_length;
+  gchar magic[ BINARY_MAGIC_SIZE ];
+  gsize magic_length;
   result_return file_process = { TRUE, "" };
-  struct json_value_s *json_data_root = NULL;
-  struct json_object_s *json_data_object;
-  struct json_object_element_s *json_data_current;
-  struct json_string_s *json_data_current_name;
-  gint new_rows = -1;
-  gint new_columns = -1;
+  mapter_doc *doc = NULL;
+  GBytes *source = NULL;
 
-  g_info( "file.c / open_file");
+  g_info( "file.c / load_document");
 
   // Open the file for reading
   FILE *input_file = fopen( file_path, "r" );
@@ -226,6 +248,41 @@ result_return open_file( gchar* file_path, app_widgets *app_wdgts )
     file_process.message = "Could not open file for reading";
     goto error_exit;
   }
+  // Check the type of file from the first few bytes
+  magic_length = fread( magic, 1, BINARY_MAGIC_SIZE, input_file );
+  if( compress_check_magic( magic, magic_length ) == TRUE )
+  {
+    // Compressed so decompress it all then check what's inside
+    g_info( "  Compressed file found" );
+    if( ( file_process = compress_read( file_path, &source ) ).result == TRUE )
+    {
+      const gchar *data = g_bytes_get_data( source, &magic_length );
+      if( binary_check_magic( data, magic_length ) == TRUE )
+      {
+        g_info( "  Binary file found" );
+        file_process = binary_read_bytes( source, &doc );
+      }
+      else
+      {
+        file_process = doc_load_json( source, &doc );
+      }
+    }
+    goto error_exit;
+  }
+  if( compress_check_zstd_magic( magic, magic_length ) == TRUE )
+  {
+    g_info( "  ERROR: zstd compressed files are not supported" );
+    file_process.result = FALSE;
+    file_process.message = "zstd compressed files are not supported, use gzip instead";
+    goto error_exit;
+  }
+  // Binary files are read straight from the file
+  if( binary_check_magic( magic, magic_length ) == TRUE )
+  {
+    g_info( "  Binary file found" );
+    file_process = binary_read( file_path, &doc );
+    goto error_exit;
+  }
   // Calculate the length of the file
   if( fseek( input_file, 0, SEEK_END ) != 0 )
   {
@@ -249,7 +306,7 @@ result_return open_file( gchar* file_path, app_widgets *app_wdgts )
     goto error_exit;
   }
   // Allocate memory to hold the file
-  if( ( json_string = malloc( json_length + 1 ) ) == NULL )
+  if( ( json_string = g_try_malloc( json_length + 1 ) ) == NULL )
   {
     g_info( "  ERROR: Open file could not allocate buffer" );
     file_process.result = FALSE;
@@ -261,7 +318,6 @@ result_return open_file( gchar* file_path, app_widgets *app_wdgts )
   if( bytes_read != json_length )
   {
     g_info( "  ERROR: Open file wrong number of bytes read ( got: %ld, expected: %ld )", bytes_read, json_length );
-    free( json_string );
     file_process.result = FALSE;
     file_process.message = "Open file wrong number of bytes read";
     goto error_exit;
@@ -269,370 +325,155 @@ result_return open_file( gchar* file_path, app_widgets *app_wdgts )
   // Zero terminate the string as fread doesn't do this
   json_string[json_length] = '\0';
 
-  // Parse data
-  if( ( json_data_root = json_parse( json_string, json_length ) ) == NULL )
+  // Parse data, the document keeps the buffer until all the text in it
+  // has been used
+  g_info( "  Reading file: %s ( %ld bytes )", file_path, json_length );
+  source = g_bytes_new_take( g_steal_pointer( &json_string ), json_length + 1 );
+  file_process = doc_load_json( source, &doc );
+
+  error_exit: // Destination if an error was found during the file opening
+  if( input_file != NULL )
   {
-    free( json_string );
-    free( json_data_root );
-    g_info( "  ERROR: Open file parse failed #1" );
-    file_process.result = FALSE;
-    file_process.message = "Open file parse failed #1";
-    goto error_exit;
+    fclose( input_file );
   }
-  if( ( json_data_object = json_value_as_object( json_data_root ) ) == NULL )
+  g_free( json_string );
+  if( source != NULL )
   {
-    free( json_string );
-    free( json_data_root );
-    g_info( "  ERROR: Open file parse failed #2" );
-    file_process.result = FALSE;
-    file_process.message = "Open file parse failed #2";
-    goto error_exit;
+    g_bytes_unref( source );
   }
-  json_data_current = json_data_object->start;
-  // Loop through the top level objects
-  g_info( "  Reading file: %s ( %ld bytes )", file_path, json_length );
-  while( json_data_current != NULL )
+
+  *document = doc;
+
+  g_info( "file.c / ~load_document");
+  return( file_process );
+}
+
+// --------------------------------------------------------------------------
+// open_file
+//
+// Opens and loads a saved mapter file
+//
+// --------------------------------------------------------------------------
+
+result_return open_file( gchar* file_path, app_widgets *app_wdgts )
+{
+  mapter_doc *doc;
+  glong journal_length = 0;
+  result_return journal_result = { TRUE, "" };
+
+  g_info( "file.c / open_file");
+  result_return file_process = load_document( file_path, &doc );
+  if( file_process.result == TRUE )
   {
-    json_data_current_name = json_data_current->name;
-    if( strcmp( json_data_current_name->string, VERSION ) == 0 )
+    // Finish with the current file first
+    save_unjournalled( app_wdgts );
+    save_wait();
+    journal_close();
+    // Pick up any edits that weren't saved into the file
+    if( save_settings_cache.use_journal == TRUE )
     {
-      // Check that the version is <= current supported version
-      gint version_no = atoi( json_value_as_number( json_data_current->value )->number );
-      g_info( "  Version number: %d", version_no );
-      if( version_no > SAVE_FILE_VERSION_NUMBER )
-      {
-        free( json_string );
-        free( json_data_root );
-        g_info( "  ERROR: Save file version number is unsupported" );
-        file_process.result = FALSE;
-        file_process.message = "Save file version number is unsupported";
-        goto error_exit;
-      }
+      journal_result = journal_replay( file_path, doc, &journal_length );
     }
-    else if( strcmp( json_data_current_name->string, ROWS ) == 0 )
+    // Replace the current document
+    show_document( doc, app_wdgts );
+    update_file_path( file_path, app_wdgts );
+    update_window_title( app_wdgts );
+    if( save_settings_cache.use_journal == TRUE )
     {
-      // Check that rows >= minimum rows
-      new_rows = atoi( json_value_as_number( json_data_current->value )->number );
-      g_info( "  Rows: %d", new_rows );
-      if( new_rows < MIN_GRID_ROWS )
-      {
-        free( json_string );
-        free( json_data_root );
-        g_info( "  ERROR: Row specification too small" );
-        file_process.result = FALSE;
-        file_process.message = "Row specification too small";
-        goto error_exit;
-      }
+      journal_start( file_path, journal_length );
     }
-    else if( strcmp( json_data_current_name->string, COLUMNS ) == 0 )
+    // The file is open but any unsaved edits were set aside
+    if( journal_result.result == FALSE )
     {
-      // Check that columns >= minimum columns
-      new_columns = atoi( json_value_as_number( json_data_current->value )->number );
-      g_info( "  Columns: %d", new_columns );
-      if( new_columns < MIN_GRID_COLUMNS )
-      {
-        free( json_string );
-        free( json_data_root );
-        g_info( "  ERROR: Column specification too small" );
-        file_process.result = FALSE;
-        file_process.message = "Column specification too small";
-        goto error_exit;
-      }
+      GtkWidget *dialog_box = gtk_message_dialog_new( GTK_WINDOW( app_wdgts->w_window_main ),
+                                    GTK_DIALOG_DESTROY_WITH_PARENT,
+                                    GTK_MESSAGE_WARNING,
+                                    GTK_BUTTONS_CLOSE,
+                                    NULL );
+      gtk_message_dialog_set_markup( GTK_MESSAGE_DIALOG (dialog_box), journal_result.message );
+      gtk_dialog_run( GTK_DIALOG( dialog_box ) );
+      gtk_widget_destroy( dialog_box );
     }
-    else if( strcmp( json_data_current_name->string, TEXT_GRID ) == 0 )
-    {
-      struct json_array_s* array = json_value_as_array( json_data_current->value );
-      g_info( "  Reading text array" );
-      // Check that there is the correct number of elements
-      if( array->length != ( new_rows * new_columns ) )
-      {
-        free( json_string );
-        free( json_data_root );
-        g_info( "  ERROR: Array size does not match" );
-        file_process.result = FALSE;
-        file_process.message = "Array size does not match";
-        goto error_exit;
-      }
-      // Clear the existing grid and set up a new one of the required dimensions
-      fill_grid( new_rows, new_columns, app_wdgts );
-      app_wdgts->current_grid_rows = new_rows;
-      app_wdgts->current_grid_columns = new_columns;
-      struct json_array_element_s* text_array_element = array->start;
-      // Loop through text grid
-      gint row_idx = 0;
-      gint col_idx = 0;
-      while( text_array_element != NULL )
-      {
-        // Get the object at this entry
-        struct json_object_s *text_array_element_object = json_value_as_object( text_array_element->value );
-        struct json_object_element_s *text_array_element_object_current = text_array_element_object->start;
-        // Loop through each object in each array element
-        // Get destination cell
-        GtkWidget *dest = gtk_grid_get_child_at( GTK_GRID( app_wdgts->w_text_grid ), col_idx, row_idx ); // event box
-        while( text_array_element_object_current != NULL )
-        {
-          const gchar *name = ( text_array_element_object_current->name )->string;
-          if( strcmp( name, CELL_BACKGROUND_COLOUR ) == 0 )
-          {
-            // Set up destination
-            app_wdgts->edit_grid_column = col_idx;
-            app_wdgts->edit_grid_row = row_idx;
-            set_cell_background( atoi( json_value_as_number( text_array_element_object_current->value )->number ), app_wdgts );
-          }
-          else if( strcmp( name, TEXT_SUMMARY ) == 0 )
-          {
-            dest = gtk_bin_get_child( GTK_BIN( dest ) ); // frame
-            dest = gtk_bin_get_child( GTK_BIN( dest ) ); // label
+  }
 
-            // Update text element
-            gtk_label_set_text( GTK_LABEL( dest ),
-                            json_value_as_string( text_array_element_object_current->value )->string );
-          }
-          else if( strcmp( name, TEXT_HEADING ) == 0 )
-          {
-            list_put_text( HEADER_LIST, row_idx, col_idx,
-                    (gchar *)json_value_as_string( text_array_element_object_current->value )->string,
-                    app_wdgts );
-          }
-          else if( strcmp( name, TEXT_BODY ) == 0 )
-          {
-            list_put_text( BODY_LIST, row_idx, col_idx,
-                    (gchar *)json_value_as_string( text_array_element_object_current->value )->string,
-                    app_wdgts );
-          }
-          else
-          {
-            g_info( "ERROR - ignoring entry: %s", name );
-          }
-          // Step on
-          text_array_element_object_current = text_array_element_object_current->next;
-        }
-        col_idx++;
-        if( col_idx == new_columns )
-        {
-          col_idx = 0;
-          row_idx++;
-        }
-        text_array_element = text_array_element->next;
-      }
-      // Set the initial edit point to be top left
-      app_wdgts->edit_grid_column = 0;
-      app_wdgts->edit_grid_row = 0;
-    }
-    else if( strcmp( json_data_current_name->string, TREE_NOTES ) == 0 )
-    {
-      g_info( "  Reading tree array" );
-      // Clear the existing tree
-      app_wdgts->stop_node_processing = TRUE;
-      gtk_tree_store_clear( app_wdgts->w_notes_treestore );
-      app_wdgts->stop_node_processing = FALSE;
-      app_wdgts->current_node_status = FALSE;
-      // Clear the text view
-      gtk_text_buffer_set_text( gtk_text_view_get_buffer( GTK_TEXT_VIEW( app_wdgts->w_notes_textview ) ), "", -1 );
-      // Start to parse JSON
-      struct json_array_s* array = json_value_as_array( json_data_current->value );
-      struct json_array_element_s* tree_array_element = array->start;
-      // Loop through tree
-      int count = 0;
-      gboolean first_entry = TRUE;
-      gint current_level = 0;
-      // Linked list for storing tree level iterator
-      GSList *import_tree = NULL;
-      while( tree_array_element != NULL )
-      {
-        // Get the data at this row
-        struct json_object_s *tree_array_element_object = json_value_as_object( tree_array_element->value );
-        struct json_object_element_s *tree_array_element_object_current = tree_array_element_object->start;
-
-        const gchar *name;
-        gchar *index;
-        gchar *heading;
-        gchar *text;
-
-        // Index
-        name = ( tree_array_element_object_current->name )->string;
-        if( strcmp( name, TREE_INDEX ) != 0 )
-        {
-          // Error so exit
-          g_info( "  ERROR when reading tree index: %d, abandoning import", count );
-          free( index );
-          free( heading );
-          free( text );
-          break;
-        }
-        index = strdup( json_value_as_string( tree_array_element_object_current->value )->string );
-        tree_array_element_object_current = tree_array_element_object_current->next;
-        // Heading
-        name = ( tree_array_element_object_current->name )->string;
-        if( strcmp( name, TREE_HEADING ) != 0 )
-        {
-          // Error so exit
-          g_info( "  ERROR when reading tree heading: %d, abandoning import", count );
-          free( index );
-          free( heading );
-          free( text );
-          break;
-        }
-        heading = strdup( json_value_as_string( tree_array_element_object_current->value )->string );
-        tree_array_element_object_current = tree_array_element_object_current->next;
-        // Text
-        name = ( tree_array_element_object_current->name )->string;
-        if( strcmp( name, TREE_TEXT ) != 0 )
-        {
-          // Error so exit
-          g_info( "  ERROR when reading tree text: %d, abandoning import", count );
-          free( index );
-          free( heading );
-          free( text );
-          break;
-        }
-        text = strdup( json_value_as_string( tree_array_element_object_current->value )->string );
-        tree_array_element_object_current = tree_array_element_object_current->next;
-        // Check end
-        if( tree_array_element_object_current != NULL )
-        {
-          g_info( "  ERROR when reading tree entry: %d abandoning import", count );
-          free( index );
-          free( heading );
-          free( text );
-          break;
-        }
-        // Process this row
-        // Calculate level = no of ':' characters in index string
-        gchar *ptr = index;
-        gint level = 0;
-        while( *ptr != '\0' )
-        {
-          if( *ptr == INDEX_SEPARATOR )
-          {
-            level++;
-          }
-          ptr++;
-        }
-        // Dynamically create a tree iter so that it can be stored in the liked list
-        void *iter_ptr = g_malloc( sizeof( GtkTreeIter ) );
-        if( iter_ptr == NULL )
-        {
-          // Something went wrong so abandon import
-          g_info( "  ERROR when allocating memory: %d abandoning import", count );
-          break;
-        }
+  g_info( "file.c / ~open_file");
+  return( file_process );
+}
 
-        // Process the data according to the previous level
-        if( first_entry == TRUE )
-        {
-          // This is the first entry so just add at top layer
-          gtk_tree_store_append( app_wdgts->w_notes_treestore, iter_ptr, NULL );
-          gtk_tree_store_set( app_wdgts->w_notes_treestore, iter_ptr, 0, heading, 1, text, -1);
-          // Add to linked list
-          import_tree = g_slist_append( import_tree, iter_ptr );
-          first_entry = FALSE;
-          current_level = 0;
-        }
-        else if( level == current_level )
-        {
-          // Add at the same level
-          if( level == 0 )
-          {
-            // Add at the top level
-            gtk_tree_store_append( app_wdgts->w_notes_treestore, iter_ptr, NULL );
-            gtk_tree_store_set( app_wdgts->w_notes_treestore, iter_ptr, 0, heading, 1, text, -1);
-          }
-          else
-          {
-            // Add at the relevant level
-            gtk_tree_store_append( app_wdgts->w_notes_treestore, iter_ptr, g_slist_nth_data( import_tree, level-1 ) );
-            gtk_tree_store_set( app_wdgts->w_notes_treestore, iter_ptr, 0, heading, 1, text, -1);
-          }
-          // Replace the entry in the list
-          // Add new one
-          import_tree = g_slist_insert( import_tree, iter_ptr, level+1 );
-          // Remove old one
-          GSList * temp_tree_ptr = g_slist_nth( import_tree, level );
-          import_tree = g_slist_delete_link( import_tree, temp_tree_ptr );
-        }
-        else if( level > current_level )
-        {
-          // Add child
-          gtk_tree_store_append( app_wdgts->w_notes_treestore, iter_ptr, g_slist_nth_data( import_tree, level-1 ) );
-          gtk_tree_store_set( app_wdgts->w_notes_treestore, iter_ptr, 0, heading, 1, text, -1);
-          // Add to linked list
-          import_tree = g_slist_append( import_tree, iter_ptr );
-          current_level = level;
-        }
-        else
-        {
-          // Move up level
-          if( level == 0 )
-          {
-            // Add at the top level
-            gtk_tree_store_append( app_wdgts->w_notes_treestore, iter_ptr, NULL );
-            gtk_tree_store_set( app_wdgts->w_notes_treestore, iter_ptr, 0, heading, 1, text, -1);
-          }
-          else
-          {
-            // Add at the relevant level
-            gtk_tree_store_append( app_wdgts->w_notes_treestore, iter_ptr, g_slist_nth_data( import_tree, level-1 ) );
-            gtk_tree_store_set( app_wdgts->w_notes_treestore, iter_ptr, 0, heading, 1, text, -1);
-          }
-          // Replace linked list element and remove all the linked list elements after this level
-          // Add new one
-          import_tree = g_slist_insert( import_tree, iter_ptr, level+1 );
-          // Remove old one
-          GSList *temp_tree_ptr = g_slist_nth( import_tree, level );
-          import_tree = g_slist_delete_link( import_tree, temp_tree_ptr );
-          // Remove remainder
-          gint length = g_slist_length( import_tree );
-          for( int i = level+1; i<length; i++)
-          {
-            temp_tree_ptr = g_slist_nth( import_tree, i );
-            g_free( g_slist_nth_data( import_tree, i ) ); // Free the data
-            import_tree = g_slist_delete_link( import_tree, temp_tree_ptr );
-          }
-          current_level = level;
-        }
+// --------------------------------------------------------------------------
+// show_document
+//
+// Sets up the grid and the notes tree from a newly loaded document
+// The document is then owned by the list
+//
+// --------------------------------------------------------------------------
 
-        // Free up copies of strings
-        free( index );
-        free( heading );
-        free( text );
-        // Next row
-        tree_array_element = tree_array_element->next;
-        count++;
-      }
-      // Import finished so clean up linked list
-      g_slist_free_full( import_tree, g_free );
-    }
-    else if( strcmp( json_data_current_name->string, GENERAL_NOTES ) == 0 )
-    {
-      // Clear the existing tree
-      app_wdgts->stop_node_processing = TRUE;
-      gtk_tree_store_clear( app_wdgts->w_notes_treestore );
-      app_wdgts->stop_node_processing = FALSE;
-      app_wdgts->current_node_status = FALSE;
-      // Clear the text view
-      gtk_text_buffer_set_text( gtk_text_view_get_buffer( GTK_TEXT_VIEW( app_wdgts->w_notes_textview ) ), "", -1 );
-      // Create just a single top level tree entry
-      import_single_header( (gchar *) json_value_as_string( json_data_current->value )->string, app_wdgts );
-    }
-    else
+void show_document( mapter_doc *doc, app_widgets *app_wdgts )
+{
+  g_info( "file.c / show_document");
+  // Clear the existing grid and set up a new one of the required dimensions
+  fill_grid( doc->rows, doc->columns, app_wdgts );
+  list_set_document( doc );
+  for( gint r=0; r<doc->rows; r++ )
+  {
+    for( gint c=0; c<doc->columns; c++ )
     {
-      g_info( "  WARNING: Unknown JSON entry found and ignored: %s", json_data_current_name->string );
+      doc_cell *cell = doc_get_cell( doc, r, c );
+      GtkWidget *dest = gtk_grid_get_child_at( GTK_GRID( app_wdgts->w_text_grid ), c, r ); // event box
+      dest = gtk_bin_get_child( GTK_BIN( dest ) ); // frame
+      dest = gtk_bin_get_child( GTK_BIN( dest ) ); // label
+      gtk_label_set_text( GTK_LABEL( dest ), doc_text_get( &cell->summary ) );
+      // Set up destination
+      app_wdgts->edit_grid_column = c;
+      app_wdgts->edit_grid_row = r;
+      set_cell_background( cell->colour, app_wdgts );
     }
-    // Step on
-    json_data_current = json_data_current->next;
   }
+  // Set the initial edit point to be top left
+  app_wdgts->edit_grid_column = 0;
+  app_wdgts->edit_grid_row = 0;
+  // The notes are kept in the document to save them from until they change
+  load_tree_notes( doc, app_wdgts );
+  show_compact( app_wdgts );
+  g_info( "file.c / ~show_document");
+}
 
-  // Tidy up
-  update_file_path( file_path, app_wdgts );
-  update_window_title( app_wdgts );
+// --------------------------------------------------------------------------
+// show_compact
+//
+// Sets the "Compact File" menu entry to match the current document
+//
+// --------------------------------------------------------------------------
 
-  error_exit: // Destination if an error was found during the file opening
-  free( json_string );
-  free( json_data_root );
+void show_compact( app_widgets *app_wdgts )
+{
+  gtk_check_menu_item_set_active( GTK_CHECK_MENU_ITEM( app_wdgts->m_compact ),
+                                  list_get_document()->compact );
+}
 
-  g_info( "file.c / ~open_file");
-  return( file_process );
+// --------------------------------------------------------------------------
+// on_compact_toggled
+//
+// Chooses whether the current document is saved as compact JSON, the
+// change is saved with the next save
+//
+// --------------------------------------------------------------------------
+
+void on_compact_toggled( GtkCheckMenuItem *menuitem, app_widgets *app_wdgts )
+{
+  mapter_doc *doc = list_get_document();
+  gboolean compact = gtk_check_menu_item_get_active( menuitem );
+
+  g_info( "file.c / on_compact_toggled" );
+  // Nothing to do when the menu is just being set up to match the document
+  if( doc->compact != compact )
+  {
+    g_info( "  Compact: %d", compact );
+    doc->compact = compact;
+    doc->format_changed = doc_changed( doc );
+    document_changed( app_wdgts );
+  }
+  g_info( "file.c / ~on_compact_toggled" );
 }
 
 // --------------------------------------------------------------------------
@@ -679,219 +520,353 @@ void on_open_activate( GtkMenuItem *menuitem, app_widgets *app_wdgts )
 }
 
 // --------------------------------------------------------------------------
-// json_encode
+// save_file
 //
-// JSON encodes the specified string and outputs to the specified file
+// Saves the current project to a mapter file
 //
 // --------------------------------------------------------------------------
 
-void json_encode( FILE* output_file, const gchar *input_str)
+result_return save_file( app_widgets *app_wdgts )
 {
-  gchar *ip = (gchar *) input_str;
-  g_info( "file.c / json_encode");
-  // Print only the first 20 characters
-  g_info( "  %.20s", input_str );
-  while( *ip != '\0' )
+  result_return file_process = { TRUE, "" };
+  mapter_doc *doc = list_get_document();
+
+  g_info( "file.c / save_file");
+  g_info( "  Save: %s\n", app_wdgts->current_file_path );
+  glong position = journal_position();
+  guint changes = doc->changes;
+  // Pick up the notes from the General Notes tab
+  capture_tree_notes( doc, app_wdgts );
+  file_process = save_document( doc, app_wdgts->current_file_path, config_backups() );
+  if( file_process.result == TRUE )
   {
-    switch( *ip )
-    {
-      // Special cases
-      case '"':
-        fprintf( output_file, "\\\"" );
-        break;
-      case '\\':
-        fprintf( output_file, "\\\\" );
-        break;
-      case '\b':
-        fprintf( output_file, "\\b" );
-        break;
-      case '\f':
-        fprintf( output_file, "\\f" );
-        break;
-      case '\n':
-        fprintf( output_file, "\\n" );
-        break;
-      case '\r':
-        fprintf( output_file, "\\r" );
-        break;
-      case '\t':
-        fprintf( output_file, "\\t" );
-        break;
-      default:
-        if( ( *ip > 0 ) && ( *ip < 0x20 ) )
-        {
-          // Encode with \uxxxx
-          fprintf( output_file, "\\u%04X", *ip );
-        }
-        else
-        {
-            // Normal character
-            fprintf( output_file, "%c", *ip );
-        }
-        break;
-    }
-    ip++;
+    doc_saved( doc, changes );
+    journal_saved( app_wdgts->current_file_path, position );
   }
-  g_info( "file.c / ~json_encode");
+  update_window_title( app_wdgts );
+
+  g_info( "file.c / ~save_file" );
+  return( file_process );
 }
 
 // --------------------------------------------------------------------------
-// save_file
+// save_document
 //
-// Saves the current project to a mapter file
+// Writes a document to the specified file, the format depends on the
+// file name. Doesn't use any widgets so it can be called from any thread
 //
 // --------------------------------------------------------------------------
 
-result_return save_file( app_widgets *app_wdgts )
+result_return save_document( mapter_doc *doc, const gchar *file_path, gint backups )
 {
   result_return file_process = { TRUE, "" };
-  // Save these as they will need to be restored later
-  gint save_r = app_wdgts->edit_grid_row;
-  gint save_c = app_wdgts->edit_grid_column;
 
-  g_info( "file.c / save_file");
-  g_info( "  Save: %s\n", app_wdgts->current_file_path );
-  // Open file for writing
-  FILE *output_file = fopen( app_wdgts->current_file_path, "w" );
-  if( output_file != NULL )
+  g_info( "file.c / save_document");
+  // Write to a temporary file, compressing it on the way if required
+  save_target *target;
+  file_process = save_begin( file_path, g_str_has_suffix( file_path, GZIP_EXTENSION ), &target );
+  if( file_process.result == TRUE )
   {
-    gint rows = app_wdgts->current_grid_rows;
-    gint columns = app_wdgts->current_grid_columns;
-    // Header
-    fprintf( output_file, "{\n" );
-
-    // Version number
-    fprintf( output_file, "\t\"%s\": %d,\n", VERSION, SAVE_FILE_VERSION_NUMBER );
-
-    // Rows and columns
-    fprintf( output_file, "\t\"%s\": %d,\n", ROWS, rows );
-    fprintf( output_file, "\t\"%s\": %d,\n", COLUMNS, columns );
-
-    // Array of text entries from the Planning Grid tab
-    fprintf( output_file, "\t\"%s\": [\n", TEXT_GRID );
-    gboolean first = TRUE;
-    GtkWidget *child;
-    background_colour_type back;
-    for( gint r=0; r<rows; r++ )
+    // Binary or JSON depending on the file name
+    if( is_binary_file_name( file_path ) == TRUE )
     {
-      for( gint c=0; c<columns; c++ )
-      {
-        if( first == FALSE )
-        {
-          // If it's not the first time then print the ,
-          fprintf( output_file, ",\n" );
-        }
-        first = FALSE;
-        fprintf( output_file, "\t\t{\n" );
-        // Cell background colour
-        fprintf( output_file, "\t\t\t\"%s\": ", CELL_BACKGROUND_COLOUR );
-        // Set up editing data to retrieve the colour
-        app_wdgts->edit_grid_row = r;
-        app_wdgts->edit_grid_column = c;
-        back = get_cell_background( app_wdgts );
-        fprintf( output_file, "%i,\n", back );
-        // Summary
-        fprintf( output_file, "\t\t\t\"%s\": \"", TEXT_SUMMARY );
-        // Fetch the text contents of this cell
-        child = gtk_grid_get_child_at( GTK_GRID( app_wdgts->w_text_grid ), c, r ); // GtkEventBox
-        child = gtk_bin_get_child( GTK_BIN( child ) ); // GtkFrame
-        child = gtk_bin_get_child( GTK_BIN( child ) ); // GtkTextView
-        // And output it
-        json_encode( output_file, gtk_label_get_text( GTK_LABEL( child ) ) );
-        fprintf( output_file, "\",\n" );
-        // Heading
-        fprintf( output_file, "\t\t\t\"%s\": \"", TEXT_HEADING );
-        json_encode( output_file, list_get_text( HEADER_LIST, r, c, app_wdgts ) );
-        fprintf( output_file, "\",\n" );
-        // Body
-        fprintf( output_file, "\t\t\t\"%s\": \"", TEXT_BODY );
-        json_encode( output_file, list_get_text( BODY_LIST, r, c, app_wdgts ) );
-        fprintf( output_file, "\"\n\t\t}" );
+      file_process = binary_write( target->file, doc );
+    }
+    else
+    {
+      file_process = doc_write_json( target->file, doc );
+    }
 
-      }
+    // Only replace the existing file if everything was written
+    if( file_process.result == TRUE )
+    {
+      file_process = save_finish( target, backups );
     }
-    fprintf( output_file, "\n\t],\n" );  // Close text_grid
-
-    // General Notes Tab
-    fprintf( output_file, "\t\"%s\": [\n", TREE_NOTES );
-    // Save the currently selected node just in case there are outstanding edits
-    GtkTreeModel *model;
-    GtkTextIter start;
-    GtkTextIter end;
-    if( gtk_tree_selection_get_selected( GTK_TREE_SELECTION( app_wdgts->w_notes_treestore_selection ), &model, &app_wdgts->current_node ) != FALSE )
+    else
     {
-      // Get the text buffer
-      gtk_text_buffer_get_start_iter( gtk_text_view_get_buffer( GTK_TEXT_VIEW( app_wdgts->w_notes_textview ) ), &start );
-      gtk_text_buffer_get_end_iter( gtk_text_view_get_buffer( GTK_TEXT_VIEW( app_wdgts->w_notes_textview ) ), &end );
-        // Copy text to tree
-      gtk_tree_store_set( app_wdgts->w_notes_treestore, &app_wdgts->current_node,
-                    1, gtk_text_buffer_get_text( gtk_text_view_get_buffer( GTK_TEXT_VIEW( app_wdgts->w_notes_textview ) ), &start, &end, FALSE ),
-                    -1 );
+      save_abort( target );
     }
-    // Loop through the tree structure
-    gtk_tree_model_foreach( GTK_TREE_MODEL( app_wdgts->w_notes_treestore ), print_row, output_file );
-    fprintf( output_file, "\n\t]\n" );
+  }
 
-    // Footer
-    fprintf( output_file, "}\n" );
+  g_info( "file.c / ~save_document" );
+  return( file_process );
+}
 
-    // Close file and tidy up
-    fclose( output_file );
-    update_window_title( app_wdgts );
+// --------------------------------------------------------------------------
+// save_file_background
+//
+// Saves the current project on a separate thread so that editing can
+// carry on. The thread works on a snapshot of the document taken now
+// If a save is already running then this one is started when it finishes,
+// replacing any other save that was waiting as this one is newer
+//
+// --------------------------------------------------------------------------
+
+void save_file_background( app_widgets *app_wdgts )
+{
+  mapter_doc *doc = list_get_document();
+
+  g_info( "file.c / save_file_background");
+  g_info( "  Save: %s", app_wdgts->current_file_path );
+  save_job *job = g_new( save_job, 1 );
+  // Pick up the notes from the General Notes tab
+  capture_tree_notes( doc, app_wdgts );
+  job->doc = doc_snapshot( doc );
+  job->file_path = g_strdup( app_wdgts->current_file_path );
+  job->backups = config_backups();
+  job->journal_position = journal_position();
+  job->app_wdgts = app_wdgts;
+  if( save_thread != NULL )
+  {
+    g_info( "  Save already running, this one will follow it" );
+    if( pending_save != NULL )
+    {
+      save_job_free( pending_save );
+    }
+    pending_save = job;
   }
   else
   {
-    g_info( "  ERROR: Could not open file for writing: %s", app_wdgts->current_file_path );
-    file_process.result = FALSE;
-    file_process.message = "Could not open file for writing";
+    save_start( job );
   }
-  // Restore the editing settings
-  app_wdgts->edit_grid_row = save_r;
-  app_wdgts->edit_grid_column = save_c;
+  g_info( "file.c / ~save_file_background");
+}
 
-  g_info( "file.c / ~save_file" );
-  return( file_process );
+// --------------------------------------------------------------------------
+// document_changed
+//
+// Called whenever the document is changed by the user
+//
+// --------------------------------------------------------------------------
+
+void document_changed( app_widgets *app_wdgts )
+{
+  update_window_title( app_wdgts );
+  autosave_schedule( app_wdgts );
+  preview_schedule( app_wdgts );
+}
+
+// --------------------------------------------------------------------------
+// autosave_schedule
+//
+// Starts the autosave timer if it isn't already running
+// A burst of edits is saved together when the timer runs out, so nothing
+// is ever more than the autosave interval old
+//
+// --------------------------------------------------------------------------
+
+void autosave_schedule( app_widgets *app_wdgts )
+{
+  if( ( autosave_timer == 0 ) && ( save_settings_cache.autosave_interval > 0 ) )
+  {
+    g_info( "  Autosave in %d seconds", save_settings_cache.autosave_interval );
+    autosave_timer = g_timeout_add_seconds( save_settings_cache.autosave_interval, autosave_timeout, app_wdgts );
+  }
 }
 
 // --------------------------------------------------------------------------
-// print_row
+// autosave_timeout
 //
-// Prints a single row from the tree to the JSON file
+// Called when the autosave timer runs out, saves in the background if
+// there's anything to save and the file has a name to save it to
 //
 // --------------------------------------------------------------------------
 
-gboolean print_row( GtkTreeModel *model, GtkTreePath  *path, GtkTreeIter  *iter, gpointer output_file )
+gboolean autosave_timeout( gpointer data )
 {
-  gchar *heading;
-  gchar *text;
-  gchar *iter_path;
-  // Get the data from the tree
-  gtk_tree_model_get( model, iter, 0, &heading, 1, &text, -1 );
-  iter_path = gtk_tree_model_get_string_from_iter( model, iter );
-  // Check if this is not the first one, i.e. path != "0"
-  // If so then print the separating comma
-  if( !( ( iter_path[0] == '0' ) && ( iter_path[1] == '\0' ) ) )
+  app_widgets *app_wdgts = (app_widgets *) data;
+
+  g_info( "file.c / autosave_timeout");
+  autosave_timer = 0;
+  if( ( doc_is_dirty( list_get_document() ) == TRUE ) &&
+      ( strlen( app_wdgts->current_file_path ) > 0 ) )
   {
-    fprintf( output_file, ",\n" );
+    save_file_background( app_wdgts );
   }
-  // Output it
-  fprintf( output_file, "\t\t{\n" );
-  fprintf( output_file, "\t\t\"index\": \"" );
-  json_encode( output_file, iter_path );
-  fprintf( output_file, "\",\n" );
-  fprintf( output_file, "\t\t\"heading\": \"" );
-  json_encode( output_file, heading );
-  fprintf( output_file, "\",\n" );
-  fprintf( output_file, "\t\t\"text\": \"" );
-  json_encode( output_file, text );
-  fprintf( output_file, "\"\n" );
-  fprintf( output_file, "\t\t}" );
-  // Free up resources
-  g_free( heading );
-  g_free( text );
-  g_free( iter_path );
-
-  return FALSE;
+  else
+  {
+    g_info( "  Nothing to save" );
+  }
+  g_info( "file.c / ~autosave_timeout");
+  return G_SOURCE_REMOVE;
+}
+
+// --------------------------------------------------------------------------
+// save_start
+//
+// Starts the thread for a background save, numbering the save so that
+// save_complete knows it's the one that's running
+//
+// --------------------------------------------------------------------------
+
+void save_start( save_job *job )
+{
+  job->generation = ++save_generation;
+  save_thread = g_thread_new( "save", save_worker, job );
+}
+
+// --------------------------------------------------------------------------
+// save_worker
+//
+// Thread function that writes the snapshot and then lets the main loop
+// know that it's finished, the job is returned when the thread is joined
+//
+// --------------------------------------------------------------------------
+
+gpointer save_worker( gpointer data )
+{
+  save_job *job = (save_job *) data;
+  g_info( "file.c / save_worker");
+  job->result = save_document( job->doc, job->file_path, job->backups );
+  g_idle_add( save_complete, GUINT_TO_POINTER( job->generation ) );
+  g_info( "file.c / ~save_worker");
+  return job;
+}
+
+// --------------------------------------------------------------------------
+// save_complete
+//
+// Called on the main loop when a background save has finished
+// Does nothing if save_wait has already dealt with it, the thread of a
+// later save could have the same address so the save's number is checked
+//
+// --------------------------------------------------------------------------
+
+gboolean save_complete( gpointer data )
+{
+  g_info( "file.c / save_complete");
+  if( ( save_thread != NULL ) && ( GPOINTER_TO_UINT( data ) == save_generation ) )
+  {
+    save_job *job = g_thread_join( g_steal_pointer( &save_thread ) );
+    // Start the next one straight away so the dialog doesn't hold it up
+    if( pending_save != NULL )
+    {
+      save_start( g_steal_pointer( &pending_save ) );
+    }
+    save_finished( job, TRUE );
+  }
+  g_info( "file.c / ~save_complete");
+  return G_SOURCE_REMOVE;
+}
+
+// --------------------------------------------------------------------------
+// save_finished
+//
+// Tidies up after a background save, showing any error if required
+//
+// --------------------------------------------------------------------------
+
+void save_finished( save_job *job, gboolean report )
+{
+  app_widgets *app_wdgts = job->app_wdgts;
+
+  g_info( "file.c / save_finished");
+  if( job->result.result == TRUE )
+  {
+    // The document can't have been replaced while the save was running
+    doc_saved( list_get_document(), job->doc->changes );
+    journal_saved( job->file_path, job->journal_position );
+  }
+  else
+  {
+    g_info( "  ERROR: could not save: %s", job->file_path );
+  }
+  if( report == TRUE )
+  {
+    if( job->result.result == FALSE )
+    {
+      GtkWidget *dialog_box = gtk_message_dialog_new( GTK_WINDOW( app_wdgts->w_window_main ),
+                                    GTK_DIALOG_DESTROY_WITH_PARENT,
+                                    GTK_MESSAGE_ERROR,
+                                    GTK_BUTTONS_CLOSE,
+                                    NULL );
+      gtk_message_dialog_set_markup( GTK_MESSAGE_DIALOG (dialog_box), job->result.message );
+      gtk_dialog_run( GTK_DIALOG( dialog_box ) );
+      gtk_widget_destroy( dialog_box );
+    }
+    update_window_title( app_wdgts );
+  }
+  save_job_free( job );
+  g_info( "file.c / ~save_finished");
+}
+
+// --------------------------------------------------------------------------
+// save_job_free
+//
+// Frees a background save and the snapshot that it holds
+//
+// --------------------------------------------------------------------------
+
+void save_job_free( save_job *job )
+{
+  doc_free( job->doc );
+  g_free( job->file_path );
+  g_free( job );
+}
+
+// --------------------------------------------------------------------------
+// save_wait
+//
+// Finishes any background saves without going back to the main loop,
+// used before the document is closed and when the program exits
+//
+// --------------------------------------------------------------------------
+
+void save_wait( void )
+{
+  g_info( "file.c / save_wait");
+  if( save_thread != NULL )
+  {
+    save_finished( g_thread_join( g_steal_pointer( &save_thread ) ), FALSE );
+  }
+  if( pending_save != NULL )
+  {
+    save_job *job = g_steal_pointer( &pending_save );
+    job->result = save_document( job->doc, job->file_path, job->backups );
+    save_finished( job, FALSE );
+  }
+  g_info( "file.c / ~save_wait");
+}
+
+// --------------------------------------------------------------------------
+// save_unjournalled
+//
+// The journal only holds edits to the cells, so when it's relied on to
+// keep the edits the file is written if anything else has changed since
+// it was last saved. Used before the file is closed
+//
+// --------------------------------------------------------------------------
+
+void save_unjournalled( app_widgets *app_wdgts )
+{
+  g_info( "file.c / save_unjournalled");
+  if( ( journal_is_open() == TRUE ) && ( doc_unjournalled( list_get_document() ) == TRUE ) )
+  {
+    save_wait();
+    save_file( app_wdgts );
+  }
+  g_info( "file.c / ~save_unjournalled");
+}
+
+// --------------------------------------------------------------------------
+// is_binary_file_name
+//
+// Checks if the file name is for a binary file, ignoring any compression
+// extension
+//
+// --------------------------------------------------------------------------
+
+gboolean is_binary_file_name( const gchar *file_path )
+{
+  gboolean result;
+  gchar *name = g_strdup( file_path );
+  if( g_str_has_suffix( name, GZIP_EXTENSION ) )
+  {
+    name[ strlen( name ) - strlen( GZIP_EXTENSION ) ] = '\0';
+  }
+  result = g_str_has_suffix( name, BINARY_EXTENSION );
+  g_free( name );
+  return result;
 }
 
 // --------------------------------------------------------------------------
@@ -916,6 +891,8 @@ void on_save_as_activate(GtkMenuItem *menuitem, app_widgets *app_wdgts)
         file_name = gtk_file_chooser_get_filename( GTK_FILE_CHOOSER( app_wdgts->w_dlg_save_as ) );
         if (file_name != NULL)
         {
+          // A background save still running would finish for the old name
+          save_wait();
           update_file_path( file_name, app_wdgts );
           save_response = save_file( app_wdgts );
           // Show error if necessary
@@ -949,8 +926,6 @@ void on_save_as_activate(GtkMenuItem *menuitem, app_widgets *app_wdgts)
 
 void on_save_activate(GtkMenuItem *menuitem, app_widgets *app_wdgts)
 {
-  result_return save_response;
-
   g_info( "file.c / on_save_activate" );
 
   // Check if this file has been saved already
@@ -961,22 +936,8 @@ void on_save_activate(GtkMenuItem *menuitem, app_widgets *app_wdgts)
   }
   else
   {
-    // Yes so just save
-    save_response = save_file( app_wdgts );
-    // Show error if necessary
-    if( save_response.result == FALSE )
-    {
-      g_info( "  ERROR: could not save: %s", app_wdgts->current_file_path );
-      // Show error if necessary
-      GtkWidget *dialog_box = gtk_message_dialog_new( GTK_WINDOW( app_wdgts->w_dlg_open ),
-                                    GTK_DIALOG_DESTROY_WITH_PARENT,
-                                    GTK_MESSAGE_ERROR,
-                                    GTK_BUTTONS_CLOSE,
-                                    NULL );
-      gtk_message_dialog_set_markup( GTK_MESSAGE_DIALOG (dialog_box), save_response.message );
-      gtk_dialog_run( GTK_DIALOG( dialog_box ) );
-      gtk_widget_destroy( dialog_box );
-    }
+    // Yes so save it in the background, any error is shown when it's done
+    save_file_background( app_wdgts );
   }
   g_info( "file.c / ~on_save_activate" );
 }
@@ -1006,6 +967,10 @@ void on_new_activate( GtkMenuItem *menuitem, app_widgets *app_wdgts )
     rows = gtk_spin_button_get_value_as_int( GTK_SPIN_BUTTON( app_wdgts->w_spin_rows ) );
     columns = gtk_spin_button_get_value_as_int( GTK_SPIN_BUTTON( app_wdgts->w_spin_columns ) );
     g_info( "  New: rows=%d, cols=%d", rows, columns );
+    // Finish with the current file first
+    save_unjournalled( app_wdgts );
+    save_wait();
+    journal_close();
     fill_grid( rows, columns, app_wdgts );
     update_file_path( "", app_wdgts );
     update_window_title( app_wdgts );
@@ -1017,7 +982,9 @@ void on_new_activate( GtkMenuItem *menuitem, app_widgets *app_wdgts )
       app_wdgts->current_node_status = FALSE;
       gtk_tree_store_remove( app_wdgts->w_notes_treestore, &iter );
     }
-    gtk_text_buffer_set_text( gtk_text_view_get_buffer( GTK_TEXT_VIEW( app_wdgts->w_notes_textview ) ), "", -1 );
+    tree_note_iters_reset();
+    show_notes_text( "", app_wdgts );
+    show_compact( app_wdgts );
   }
 
   gtk_widget_hide(app_wdgts->w_dlg_get_row_col );
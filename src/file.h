@@ -34,10 +34,22 @@
 #define TREE_TEXT "text"
 #define INDEX_SEPARATOR ':'
 
+// A save being carried out in the background
+typedef struct {
+  mapter_doc *doc;                // Snapshot owned by the save
+  gchar *file_path;
+  gint backups;                   // Previous versions to keep
+  glong journal_position;         // Journal records before this are in the snapshot
+  result_return result;
+  app_widgets *app_wdgts;
+  guint generation;               // Number of the save, see save_complete
+} save_job;
+
 void on_about_activate( GtkMenuItem *, app_widgets * );
 void on_dlg_about_response( GtkDialog *, gint, app_widgets * );
 
 void on_export_activate( GtkMenuItem *, app_widgets * );
+void on_export_notes_activate( GtkMenuItem *, app_widgets * );
 
 void on_open_activate( GtkMenuItem *, app_widgets * );
 void on_save_activate( GtkMenuItem *, app_widgets * );
@@ -45,10 +57,23 @@ void on_save_as_activate( GtkMenuItem *, app_widgets * );
 void on_new_activate( GtkMenuItem *, app_widgets * );
 
 result_return open_file( gchar*, app_widgets * );
+result_return load_document( const gchar *, mapter_doc ** );
 result_return save_file( app_widgets * );
-
-void json_encode( FILE*, const gchar *);
-
-gboolean print_row( GtkTreeModel *, GtkTreePath  *, GtkTreeIter  *, gpointer );
+result_return save_document( mapter_doc *, const gchar *, gint );
+void save_file_background( app_widgets * );
+void document_changed( app_widgets * );
+void autosave_schedule( app_widgets * );
+gboolean autosave_timeout( gpointer );
+gpointer save_worker( gpointer );
+void save_start( save_job * );
+gboolean save_complete( gpointer );
+void save_finished( save_job *, gboolean );
+void save_job_free( save_job * );
+void save_wait( void );
+void save_unjournalled( app_widgets * );
+void show_document( mapter_doc *, app_widgets * );
+void show_compact( app_widgets * );
+void on_compact_toggled( GtkCheckMenuItem *, app_widgets * );
+gboolean is_binary_file_name( const gchar * );
 
 #endif
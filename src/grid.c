@@ -20,10 +20,13 @@
 #include <gtkspell/gtkspell.h>
 #include "main.h"
 #include "grid.h"
+#include "doc.h"
 #include "list.h"
 #include "util.h"
 #include "css.h"
 #include "file.h"
+#include "journal.h"
+#include "preview.h"
 
 // --------------------------------------------------------------------------
 // add_row
@@ -53,9 +56,8 @@ void add_row( app_widgets *app_wdgts, gint row )
 
     gtk_grid_attach( GTK_GRID( app_wdgts->w_text_grid ), e_box, c, row, 1, 1 );
   }
-  // Add a row in the linked lists
-  list_insert_row( HEADER_LIST, row, app_wdgts );
-  list_insert_row( BODY_LIST, row, app_wdgts );
+  // Add a row in the document
+  list_insert_row( row, app_wdgts );
   // Update the setting
   app_wdgts->current_grid_rows++;
   g_info( "  New row count: %d", app_wdgts->current_grid_rows );
@@ -129,8 +131,7 @@ void delete_row( GtkWidget *source, app_widgets *app_wdgts )
     }
     gtk_grid_remove_row( GTK_GRID( app_wdgts->w_text_grid ), delete_row );
     // Delete a row from the linked lists
-    list_delete_row( HEADER_LIST, delete_row, app_wdgts );
-    list_delete_row( BODY_LIST, delete_row, app_wdgts );
+    list_delete_row( delete_row, app_wdgts );
     // Update settings
     app_wdgts->current_grid_rows--;
     g_info( "  New row count: %d", app_wdgts->current_grid_rows );
@@ -173,8 +174,7 @@ void add_column( app_widgets *app_wdgts, gint column )
     gtk_grid_attach( GTK_GRID( app_wdgts->w_text_grid ), e_box, column, r, 1, 1 );
   }
   // Add a row in the linked lists
-  list_insert_column( HEADER_LIST, column, app_wdgts );
-  list_insert_column( BODY_LIST, column, app_wdgts );
+  list_insert_column( column, app_wdgts );
   app_wdgts->current_grid_columns++;
   g_info( "  New column count: %d", app_wdgts->current_grid_columns );
   gtk_widget_show_all( app_wdgts->w_text_grid );
@@ -247,8 +247,7 @@ void delete_column( GtkWidget *source, app_widgets *app_wdgts )
     }
     gtk_grid_remove_column( GTK_GRID( app_wdgts->w_text_grid ), delete_column );
     // Delete a column from the linked lists
-    list_delete_column( HEADER_LIST, delete_column, app_wdgts );
-    list_delete_column( BODY_LIST, delete_column, app_wdgts );
+    list_delete_column( delete_column, app_wdgts );
 
     app_wdgts->current_grid_columns--;
     g_info( "  New column count: %d", app_wdgts->current_grid_columns );
@@ -350,8 +349,11 @@ void set_cell_background( background_colour_type colour, app_widgets *app_wdgts
     default:
       // Everything else default to none
       gtk_style_context_add_class( context, "no_background" );
+      colour = NONE;
       break;
   }
+  // And keep the document in step
+  list_put_colour( app_wdgts->edit_grid_row, app_wdgts->edit_grid_column, colour, app_wdgts );
   g_info( "grid.c / ~set_cell_background");
 }
 
@@ -567,15 +569,19 @@ void on_btn_edit_save_clicked( GtkButton *button, app_widgets *app_wdgts )
   // Summary
   gtk_text_buffer_get_start_iter( gtk_text_view_get_buffer( GTK_TEXT_VIEW( app_wdgts->w_edit_summary ) ), &start );
   gtk_text_buffer_get_end_iter( gtk_text_view_get_buffer( GTK_TEXT_VIEW( app_wdgts->w_edit_summary ) ), &end );
-  gtk_label_set_text( GTK_LABEL( app_wdgts->w_current_edit_text_element ),
-                      gtk_text_buffer_get_text( gtk_text_view_get_buffer( GTK_TEXT_VIEW( app_wdgts->w_edit_summary ) ),
-                            &start,
-                            &end,
-                            FALSE ) );
+  gchar *new_text = gtk_text_buffer_get_text( gtk_text_view_get_buffer( GTK_TEXT_VIEW( app_wdgts->w_edit_summary ) ), &start, &end, FALSE );
+  gtk_label_set_text( GTK_LABEL( app_wdgts->w_current_edit_text_element ), new_text );
+  list_put_text( SUMMARY_LIST,
+                 app_wdgts->edit_grid_row,
+                 app_wdgts->edit_grid_column,
+                 new_text,
+                 app_wdgts );
+  // Free up text
+  g_free( new_text );
   // Header
   gtk_text_buffer_get_start_iter( gtk_text_view_get_buffer( GTK_TEXT_VIEW( app_wdgts->w_edit_heading ) ), &start );
   gtk_text_buffer_get_end_iter( gtk_text_view_get_buffer( GTK_TEXT_VIEW( app_wdgts->w_edit_heading ) ), &end );
-  gchar *new_text = gtk_text_buffer_get_text( gtk_text_view_get_buffer( GTK_TEXT_VIEW( app_wdgts->w_edit_heading ) ), &start, &end, FALSE );
+  new_text = gtk_text_buffer_get_text( gtk_text_view_get_buffer( GTK_TEXT_VIEW( app_wdgts->w_edit_heading ) ), &start, &end, FALSE );
   list_put_text( HEADER_LIST,
                  app_wdgts->edit_grid_row,
                  app_wdgts->edit_grid_column,
@@ -595,8 +601,14 @@ void on_btn_edit_save_clicked( GtkButton *button, app_widgets *app_wdgts )
   // Free up text
   g_free( new_text );
 
-  // Now save file
-  on_save_activate( GTK_MENU_ITEM( app_wdgts->m_save ), app_wdgts );
+  // Now save file, with a journal the edits to the cells are already safe
+  // so the file is only rewritten once the journal has grown, or if the
+  // notes or anything else the journal doesn't hold has changed
+  if( ( journal_is_open() == FALSE ) || ( journal_needs_compaction() == TRUE ) ||
+      ( doc_unjournalled( list_get_document() ) == TRUE ) )
+  {
+    on_save_activate( GTK_MENU_ITEM( app_wdgts->m_save ), app_wdgts );
+  }
 
   g_info( "grid.c / ~on_btn_edit_save_clicked");
 }
@@ -1193,9 +1205,9 @@ void fill_grid( gint new_rows, gint new_columns, app_widgets *app_wdgts )
   app_wdgts->current_grid_rows = new_rows;
   app_wdgts->current_grid_columns = new_columns;
 
-  // Set up the linked lists
-  list_init( HEADER_LIST, new_rows, new_columns );
-  list_init( BODY_LIST, new_rows, new_columns );
+  // Set up the document
+  list_init( new_rows, new_columns );
+  preview_schedule( app_wdgts );
 
   // Now set the focus to the correct cell
   gtk_widget_grab_focus( focus_widget );
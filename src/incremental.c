@@ -0,0 +1,530 @@
+// incremental.c - exports only the chapters that have changed since the
+//                 last export, part of the mapter program
+// Copyright (C) 2020 John Davies
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Each export is split into pieces, the opening, each chapter and the
+// closing, and a hash of everything that goes into each piece is kept in
+// a manifest alongside the export. The next export only has to produce the
+// pieces whose hash has changed, the rest are copied from the last export
+// or, in a split export, the files are left as they are
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gtk/gtk.h>
+#include <glib/gstdio.h>
+#include "main.h"
+#include "doc.h"
+#include "save.h"
+#include "writer.h"
+#include "template.h"
+#include "export.h"
+#include "incremental.h"
+
+// --------------------------------------------------------------------------
+// incremental_export
+//
+// Exports a document to a single file reusing the chapters of the last
+// export that haven't changed. The whole file is still replaced in one go
+// as with any other export
+//
+// --------------------------------------------------------------------------
+
+result_return incremental_export( mapter_doc *doc, const export_options *options, const gchar *file_path )
+{
+  doc_traversal traversal;
+  save_target *target;
+  GMappedFile *previous_file = NULL;
+  GHashTable *reusable = g_hash_table_new( g_str_hash, g_str_equal );
+  GStatBuf info;
+  gint reused = 0;
+
+  g_info( "incremental.c / incremental_export");
+  g_info( "  Export filename: %s", file_path );
+  // The pieces are hashed from the decoded text, so do it all now in one go
+  doc_decode( doc, DECODE_SUMMARY | DECODE_HEADING | DECODE_BODY );
+  doc_traverse( doc, options->order, &traversal );
+  gchar *settings = incremental_settings( &traversal, options );
+  gchar *manifest_path = g_strconcat( file_path, INCREMENTAL_SUFFIX, NULL );
+  GArray *previous = incremental_load( manifest_path );
+  // The last export can only be used if it hasn't been changed since
+  if( ( previous != NULL ) && ( previous->len > 0 ) )
+  {
+    incremental_entry *last = &g_array_index( previous, incremental_entry, previous->len - 1 );
+    if( ( g_stat( file_path, &info ) == 0 ) &&
+        ( (guint64) info.st_size == ( last->offset + last->length ) ) &&
+        ( incremental_modified( &info ) == last->modified ) )
+    {
+      previous_file = g_mapped_file_new( file_path, FALSE, NULL );
+    }
+  }
+  if( previous_file != NULL )
+  {
+    for( guint i=0; i<previous->len; i++ )
+    {
+      incremental_entry *entry = &g_array_index( previous, incremental_entry, i );
+      g_hash_table_insert( reusable, entry->hash, entry );
+    }
+  }
+  // It won't match the file once the file starts to change
+  g_remove( manifest_path );
+
+  result_return export_result = save_begin( file_path, FALSE, &target );
+  if( export_result.result == TRUE )
+  {
+    const gchar *previous_data = ( previous_file != NULL ) ? g_mapped_file_get_contents( previous_file ) : NULL;
+    GArray *current = incremental_new();
+    output_writer *writer = writer_new( target->file );
+    // Piece 0 is the opening and the last piece is the closing
+    for( gint piece=0; piece<=traversal.chapters; piece++ )
+    {
+      gchar *hash = incremental_hash( settings, &traversal, piece );
+      guint64 start = writer_position( writer );
+      incremental_entry *entry = g_hash_table_lookup( reusable, hash );
+      if( entry != NULL )
+      {
+        writer_write( writer, previous_data + entry->offset, entry->length );
+        reused++;
+      }
+      else
+      {
+        export_piece( &traversal, options, piece, writer );
+      }
+      incremental_add( current, hash, writer_position( writer ) - start, NULL );
+      g_free( hash );
+    }
+    if( writer_free( writer ) == TRUE )
+    {
+      export_result = save_finish( target, 0 );
+    }
+    else
+    {
+      save_abort( target );
+      export_result.result = FALSE;
+      export_result.message = "Could not write export file";
+    }
+    // The pieces are all in the one file so they all have its time
+    if( ( export_result.result == TRUE ) && ( g_stat( file_path, &info ) == 0 ) )
+    {
+      for( guint i=0; i<current->len; i++ )
+      {
+        g_array_index( current, incremental_entry, i ).modified = incremental_modified( &info );
+      }
+      incremental_save( manifest_path, current );
+    }
+    g_array_free( current, TRUE );
+  }
+  g_info( "  Reused %d of %d pieces", reused, traversal.chapters + 1 );
+
+  if( previous_file != NULL )
+  {
+    g_mapped_file_unref( previous_file );
+  }
+  if( previous != NULL )
+  {
+    g_array_free( previous, TRUE );
+  }
+  g_hash_table_destroy( reusable );
+  g_free( manifest_path );
+  g_free( settings );
+  doc_traversal_clear( &traversal );
+  g_info( "incremental.c / ~incremental_export");
+  return export_result;
+}
+
+// --------------------------------------------------------------------------
+// incremental_settings
+//
+// Returns a hash of everything that can change every piece of an export,
+// i.e. the options, the template and the header cells which hold the title
+// and the series names
+//
+// --------------------------------------------------------------------------
+
+gchar *incremental_settings( doc_traversal *traversal, const export_options *options )
+{
+  incremental_state state;
+
+  incremental_begin( &state );
+  incremental_mix( &state, options->title );
+  incremental_mix( &state, options->dup_cr );
+  incremental_mix( &state, options->add_series );
+  incremental_mix( &state, options->order );
+  incremental_mix( &state, options->notes );
+  incremental_mix( &state, traversal->sections );
+  if( options->template != NULL )
+  {
+    incremental_mix( &state, options->template->escape );
+    for( gint part=0; part<TEMPLATE_PARTS; part++ )
+    {
+      incremental_update( &state, options->template->source[part], strlen( options->template->source[part] ) );
+    }
+  }
+  for( gint s=0; s<traversal->sections; s++ )
+  {
+    incremental_hash_cell( &state, doc_traversal_cell( traversal, 0, s ) );
+  }
+  return incremental_end( &state );
+}
+
+// --------------------------------------------------------------------------
+// incremental_hash
+//
+// Returns the hash of a piece of an export, 0 is the opening, the number
+// of chapters is the closing, which has the notes in it, and anything in
+// between is that chapter
+//
+// --------------------------------------------------------------------------
+
+gchar *incremental_hash( const gchar *settings, doc_traversal *traversal, gint piece )
+{
+  incremental_state state;
+
+  incremental_begin( &state );
+  incremental_update( &state, settings, strlen( settings ) );
+  // Templates can use the chapter number so the same text in another
+  // chapter isn't the same
+  incremental_mix( &state, piece );
+  if( ( piece > 0 ) && ( piece < traversal->chapters ) )
+  {
+    for( gint s=0; s<traversal->sections; s++ )
+    {
+      incremental_hash_cell( &state, doc_traversal_cell( traversal, piece, s ) );
+    }
+  }
+  else if( piece == traversal->chapters )
+  {
+    incremental_hash_notes( &state, traversal->notes );
+  }
+  return incremental_end( &state );
+}
+
+// --------------------------------------------------------------------------
+// incremental_hash_cell
+//
+// Adds the text of a cell to a hash, the background colour isn't exported
+// so it isn't included. The text is always hashed decoded, as the export
+// decodes it anyway, so the hash is the same whether or not the text had
+// been used before
+//
+// --------------------------------------------------------------------------
+
+void incremental_hash_cell( incremental_state *state, doc_cell *cell )
+{
+  doc_text *texts[3] = { &cell->summary, &cell->heading, &cell->body };
+
+  for( gint t=0; t<3; t++ )
+  {
+    const gchar *text = doc_text_get( texts[t] );
+    incremental_update( state, text, strlen( text ) );
+  }
+}
+
+// --------------------------------------------------------------------------
+// incremental_hash_notes
+//
+// Adds the level and text of each note to a hash, in the same way as the
+// text of a cell
+//
+// --------------------------------------------------------------------------
+
+void incremental_hash_notes( incremental_state *state, GArray *notes )
+{
+  for( guint n=0; n<notes->len; n++ )
+  {
+    doc_note *note = &g_array_index( notes, doc_note, n );
+    doc_text *texts[2] = { &note->heading, &note->text };
+    incremental_mix( state, note->level );
+    for( gint t=0; t<2; t++ )
+    {
+      const gchar *text = doc_text_get( texts[t] );
+      incremental_update( state, text, strlen( text ) );
+    }
+  }
+}
+
+// --------------------------------------------------------------------------
+// incremental_begin
+//
+// Starts a new hash
+//
+// --------------------------------------------------------------------------
+
+void incremental_begin( incremental_state *state )
+{
+  state->a = INCREMENTAL_SEED_A;
+  state->b = INCREMENTAL_SEED_B;
+}
+
+// --------------------------------------------------------------------------
+// incremental_update
+//
+// Adds some text to a hash eight bytes at a time, the length is added at
+// the end so that the texts are kept apart
+//
+// --------------------------------------------------------------------------
+
+void incremental_update( incremental_state *state, const gchar *data, gsize length )
+{
+  guint64 word;
+  gsize i;
+
+  for( i=0; ( i + sizeof( word ) ) <= length; i += sizeof( word ) )
+  {
+    memcpy( &word, data + i, sizeof( word ) );
+    incremental_mix( state, word );
+  }
+  if( i < length )
+  {
+    word = 0;
+    memcpy( &word, data + i, length - i );
+    incremental_mix( state, word );
+  }
+  incremental_mix( state, length );
+}
+
+// --------------------------------------------------------------------------
+// incremental_mix
+//
+// Adds a single value to both lanes of a hash, each with its own multiplier
+//
+// --------------------------------------------------------------------------
+
+void incremental_mix( incremental_state *state, guint64 word )
+{
+  state->a = ( state->a ^ word ) * INCREMENTAL_MULTIPLIER_A;
+  state->a ^= state->a >> 32;
+  state->b = ( state->b + word ) * INCREMENTAL_MULTIPLIER_B;
+  state->b ^= state->b >> 29;
+}
+
+// --------------------------------------------------------------------------
+// incremental_end
+//
+// Spreads the last few values through the whole of each lane and returns
+// the hash as hex
+//
+// --------------------------------------------------------------------------
+
+gchar *incremental_end( incremental_state *state )
+{
+  guint64 lanes[2] = { state->a, state->b };
+  for( gint i=0; i<2; i++ )
+  {
+    lanes[i] ^= lanes[i] >> 33;
+    lanes[i] *= INCREMENTAL_FINISH_1;
+    lanes[i] ^= lanes[i] >> 33;
+    lanes[i] *= INCREMENTAL_FINISH_2;
+    lanes[i] ^= lanes[i] >> 33;
+  }
+  return g_strdup_printf( "%016" G_GINT64_MODIFIER "x%016" G_GINT64_MODIFIER "x", lanes[0], lanes[1] );
+}
+
+// --------------------------------------------------------------------------
+// incremental_new
+//
+// Returns an empty list of manifest entries
+//
+// --------------------------------------------------------------------------
+
+GArray *incremental_new( void )
+{
+  GArray *entries = g_array_new( FALSE, TRUE, sizeof( incremental_entry ) );
+  g_array_set_clear_func( entries, incremental_entry_clear );
+  return entries;
+}
+
+// --------------------------------------------------------------------------
+// incremental_entry_clear
+//
+// Frees the memory used by a manifest entry
+// Used as the clear function of the entries array
+//
+// --------------------------------------------------------------------------
+
+void incremental_entry_clear( gpointer element )
+{
+  incremental_entry *entry = (incremental_entry *) element;
+  g_free( entry->hash );
+  g_free( entry->name );
+}
+
+// --------------------------------------------------------------------------
+// incremental_add
+//
+// Adds a piece to a manifest, following on from the previous one
+//
+// --------------------------------------------------------------------------
+
+void incremental_add( GArray *entries, const gchar *hash, guint64 length, const gchar *name )
+{
+  incremental_entry entry = { g_strdup( hash ), 0, length, 0, g_strdup( name ) };
+  if( entries->len > 0 )
+  {
+    incremental_entry *last = &g_array_index( entries, incremental_entry, entries->len - 1 );
+    entry.offset = last->offset + last->length;
+  }
+  g_array_append_val( entries, entry );
+}
+
+// --------------------------------------------------------------------------
+// incremental_load
+//
+// Reads a manifest, returns NULL if there isn't one or it can't be used
+// Each line after the first is: hash length modified name
+//
+// --------------------------------------------------------------------------
+
+GArray *incremental_load( const gchar *manifest_path )
+{
+  gchar *contents;
+  gchar hash[ INCREMENTAL_HASH_LENGTH + 1 ];
+  guint64 length;
+  gint64 modified;
+  gint name_start;
+
+  g_info( "incremental.c / incremental_load");
+  if( g_file_get_contents( manifest_path, &contents, NULL, NULL ) == FALSE )
+  {
+    g_info( "  No manifest: %s", manifest_path );
+    g_info( "incremental.c / ~incremental_load");
+    return NULL;
+  }
+  gchar **lines = g_strsplit( contents, "\n", -1 );
+  GArray *entries = incremental_new();
+  gboolean valid = ( strcmp( lines[0], INCREMENTAL_MAGIC ) == 0 );
+  for( gint i=1; ( valid == TRUE ) && ( lines[i] != NULL ) && ( *lines[i] != '\0' ); i++ )
+  {
+    valid = ( sscanf( lines[i], "%32s %" G_GUINT64_FORMAT " %" G_GINT64_FORMAT " %n",
+                      hash, &length, &modified, &name_start ) == 3 );
+    if( valid == TRUE )
+    {
+      // Names come back to be deleted so they have to be in the directory
+      const gchar *name = lines[i] + name_start;
+      valid = ( strlen( hash ) == INCREMENTAL_HASH_LENGTH ) &&
+              ( strspn( hash, "0123456789abcdef" ) == INCREMENTAL_HASH_LENGTH ) &&
+              ( *name != '\0' ) && ( *name != '.' ) && ( strchr( name, G_DIR_SEPARATOR ) == NULL );
+      incremental_add( entries, hash, length, ( strcmp( name, INCREMENTAL_NO_NAME ) != 0 ) ? name : NULL );
+      g_array_index( entries, incremental_entry, entries->len - 1 ).modified = modified;
+    }
+  }
+  if( valid == FALSE )
+  {
+    g_info( "  ERROR - damaged manifest: %s", manifest_path );
+    g_array_free( g_steal_pointer( &entries ), TRUE );
+  }
+  g_strfreev( lines );
+  g_free( contents );
+  g_info( "incremental.c / ~incremental_load");
+  return entries;
+}
+
+// --------------------------------------------------------------------------
+// incremental_save
+//
+// Writes a manifest, returns FALSE if it couldn't be written which only
+// means that the next export will be a full one
+//
+// --------------------------------------------------------------------------
+
+gboolean incremental_save( const gchar *manifest_path, GArray *entries )
+{
+  GString *contents = g_string_new( INCREMENTAL_MAGIC "\n" );
+  for( guint i=0; i<entries->len; i++ )
+  {
+    incremental_entry *entry = &g_array_index( entries, incremental_entry, i );
+    g_string_append_printf( contents, "%s %" G_GUINT64_FORMAT " %" G_GINT64_FORMAT " %s\n", entry->hash,
+                            entry->length, entry->modified,
+                            ( entry->name != NULL ) ? entry->name : INCREMENTAL_NO_NAME );
+  }
+  gboolean saved = g_file_set_contents( manifest_path, contents->str, contents->len, NULL );
+  if( saved == FALSE )
+  {
+    g_info( "  ERROR - could not write manifest: %s", manifest_path );
+  }
+  g_string_free( contents, TRUE );
+  return saved;
+}
+
+// --------------------------------------------------------------------------
+// incremental_unchanged
+//
+// Returns TRUE if a file of a split export was written from the same hash
+// the last time and hasn't been changed since
+//
+// --------------------------------------------------------------------------
+
+gboolean incremental_unchanged( GArray *entries, const gchar *name, const gchar *hash, const gchar *file_path )
+{
+  GStatBuf info;
+
+  for( guint i=0; ( entries != NULL ) && ( i<entries->len ); i++ )
+  {
+    incremental_entry *entry = &g_array_index( entries, incremental_entry, i );
+    if( ( entry->name != NULL ) && ( strcmp( entry->name, name ) == 0 ) )
+    {
+      return( ( strcmp( entry->hash, hash ) == 0 ) && ( g_stat( file_path, &info ) == 0 ) &&
+              ( (guint64) info.st_size == entry->length ) && ( incremental_modified( &info ) == entry->modified ) );
+    }
+  }
+  return FALSE;
+}
+
+// --------------------------------------------------------------------------
+// incremental_modified
+//
+// Returns the time a file was written to the nanosecond, whole seconds
+// would miss a file that was changed again within the same second
+//
+// --------------------------------------------------------------------------
+
+gint64 incremental_modified( GStatBuf *info )
+{
+  return( ( (gint64) info->st_mtim.tv_sec * G_GINT64_CONSTANT( 1000000000 ) ) + info->st_mtim.tv_nsec );
+}
+
+// --------------------------------------------------------------------------
+// incremental_remove_stale
+//
+// Deletes the files of the last split export that aren't part of this one,
+// e.g. when a chapter has been renamed or deleted
+//
+// --------------------------------------------------------------------------
+
+void incremental_remove_stale( GArray *previous, GArray *current, const gchar *directory )
+{
+  if( previous == NULL )
+  {
+    return;
+  }
+  GHashTable *names = g_hash_table_new( g_str_hash, g_str_equal );
+  for( guint i=0; i<current->len; i++ )
+  {
+    g_hash_table_add( names, g_array_index( current, incremental_entry, i ).name );
+  }
+  for( guint i=0; i<previous->len; i++ )
+  {
+    incremental_entry *entry = &g_array_index( previous, incremental_entry, i );
+    if( ( entry->name != NULL ) && ( g_hash_table_contains( names, entry->name ) == FALSE ) )
+    {
+      gchar *file_path = g_build_filename( directory, entry->name, NULL );
+      g_info( "  Removing: %s", file_path );
+      g_remove( file_path );
+      g_free( file_path );
+    }
+  }
+  g_hash_table_destroy( names );
+}
@@ -0,0 +1,76 @@
+// incremental.h - header file for incremental.c
+//                 part of the mapter program
+// Copyright (C) 2020 John Davies
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+// Kept alongside an export file, e.g. novel.txt.manifest, or in the
+// directory of a split export
+#define INCREMENTAL_SUFFIX ".manifest"
+#define INCREMENTAL_SPLIT_NAME ".manifest"
+// First line of a manifest
+#define INCREMENTAL_MAGIC "MAPTERX"
+// Length of the hex content hashes
+#define INCREMENTAL_HASH_LENGTH 32
+// Constants of the hash, the multipliers are odd and the finish is from
+// MurmurHash3
+#define INCREMENTAL_SEED_A G_GUINT64_CONSTANT( 0x243f6a8885a308d3 )
+#define INCREMENTAL_SEED_B G_GUINT64_CONSTANT( 0x13198a2e03707344 )
+#define INCREMENTAL_MULTIPLIER_A G_GUINT64_CONSTANT( 0x9e3779b97f4a7c15 )
+#define INCREMENTAL_MULTIPLIER_B G_GUINT64_CONSTANT( 0xc2b2ae3d27d4eb4f )
+#define INCREMENTAL_FINISH_1 G_GUINT64_CONSTANT( 0xff51afd7ed558ccd )
+#define INCREMENTAL_FINISH_2 G_GUINT64_CONSTANT( 0xc4ceb9fe1a85ec53 )
+// Stands in for the file name of the pieces of a single file export
+#define INCREMENTAL_NO_NAME "-"
+
+// Hash of the text that goes into a piece of an export. It only has to
+// notice a change so two 64 bit lanes are plenty, it's many times quicker
+// than SHA-256 which would take longer than the export itself
+typedef struct {
+  guint64 a;
+  guint64 b;
+} incremental_state;
+
+// A piece of an earlier export, the opening, a chapter or the closing of
+// a single file or one of the files of a split export
+typedef struct {
+  gchar *hash;            // Of everything that went into the piece
+  guint64 offset;         // Where it starts in a single file
+  guint64 length;
+  gint64 modified;        // Time the file was written, in nanoseconds
+  gchar *name;            // File name in a split export
+} incremental_entry;
+
+result_return incremental_export( mapter_doc *, const export_options *, const gchar * );
+gchar *incremental_settings( doc_traversal *, const export_options * );
+gchar *incremental_hash( const gchar *, doc_traversal *, gint );
+void incremental_hash_cell( incremental_state *, doc_cell * );
+void incremental_hash_notes( incremental_state *, GArray * );
+void incremental_begin( incremental_state * );
+void incremental_update( incremental_state *, const gchar *, gsize );
+void incremental_mix( incremental_state *, guint64 );
+gchar *incremental_end( incremental_state * );
+GArray *incremental_new( void );
+void incremental_entry_clear( gpointer );
+void incremental_add( GArray *, const gchar *, guint64, const gchar * );
+GArray *incremental_load( const gchar * );
+gboolean incremental_save( const gchar *, GArray * );
+gboolean incremental_unchanged( GArray *, const gchar *, const gchar *, const gchar * );
+gint64 incremental_modified( GStatBuf * );
+void incremental_remove_stale( GArray *, GArray *, const gchar * );
+
+#endif
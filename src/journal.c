@@ -0,0 +1,489 @@
+// journal.c - append only journal of the edits made since the last save
+//             part of the mapter program
+// Copyright (C) 2020 John Davies
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Each change to the document is appended to the journal as a single line
+// holding a small JSON array and is flushed to disk straight away, so an
+// edit costs only the size of the change and survives a crash
+// The journal is replayed when the file is next opened and is folded back
+// into the file when it gets too big or when the file is closed
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <gtk/gtk.h>
+#include "main.h"
+#include "doc.h"
+#include "config.h"
+#include "file.h"
+#include "list.h"
+#include "save.h"
+#include "writer.h"
+#include "journal.h"
+
+// The open journal and the file that it belongs to
+
+FILE *journal = NULL;
+output_writer *journal_writer = NULL;
+gchar *journal_base = NULL;
+glong journal_header_length = 0;
+
+// --------------------------------------------------------------------------
+// journal_file_path
+//
+// Returns the name of the journal for the specified file
+//
+// --------------------------------------------------------------------------
+
+gchar *journal_file_path( const gchar *file_path )
+{
+  return g_strconcat( file_path, JOURNAL_EXTENSION, NULL );
+}
+
+// --------------------------------------------------------------------------
+// journal_header
+//
+// Returns the first line of the journal for the specified file
+// This identifies the version of the file that the journal applies to so
+// that a journal isn't replayed onto a file that's been changed since
+//
+// --------------------------------------------------------------------------
+
+gchar *journal_header( const gchar *file_path )
+{
+  struct stat file_stat;
+  if( stat( file_path, &file_stat ) != 0 )
+  {
+    file_stat.st_size = -1;
+    file_stat.st_mtim.tv_sec = 0;
+    file_stat.st_mtim.tv_nsec = 0;
+  }
+  // To the nanosecond, the file could be rewritten within the same second
+  return g_strdup_printf( "%s %" G_GINT64_FORMAT " %" G_GINT64_FORMAT ".%09ld\n", JOURNAL_MAGIC,
+                          (gint64) file_stat.st_size, (gint64) file_stat.st_mtim.tv_sec,
+                          (glong) file_stat.st_mtim.tv_nsec );
+}
+
+// --------------------------------------------------------------------------
+// journal_start
+//
+// Opens the journal for the specified file so that edits can be added
+// If length is 0 then a new journal is started, otherwise the existing
+// journal is kept up to that length
+//
+// --------------------------------------------------------------------------
+
+gboolean journal_start( const gchar *file_path, glong length )
+{
+  g_info( "journal.c / journal_start");
+  journal_stop();
+  gchar *journal_path = journal_file_path( file_path );
+  gchar *header = journal_header( file_path );
+  journal_header_length = strlen( header );
+  if( length <= 0 )
+  {
+    journal = fopen( journal_path, "w" );
+    if( journal != NULL )
+    {
+      fputs( header, journal );
+    }
+  }
+  else if( truncate( journal_path, length ) == 0 )
+  {
+    // Anything after the last complete record is dropped
+    journal = fopen( journal_path, "a" );
+  }
+  if( journal != NULL )
+  {
+    journal_base = g_strdup( file_path );
+    journal_writer = writer_new( journal );
+    journal_append();
+    g_info( "  Journal: %s", journal_path );
+  }
+  else
+  {
+    g_info( "  ERROR - could not open journal: %s", journal_path );
+  }
+  g_free( header );
+  g_free( journal_path );
+  g_info( "journal.c / ~journal_start");
+  return( journal != NULL );
+}
+
+// --------------------------------------------------------------------------
+// journal_stop
+//
+// Closes the journal, it's left on disk
+//
+// --------------------------------------------------------------------------
+
+void journal_stop( void )
+{
+  if( journal != NULL )
+  {
+    writer_free( g_steal_pointer( &journal_writer ) );
+    fclose( g_steal_pointer( &journal ) );
+  }
+  g_free( g_steal_pointer( &journal_base ) );
+}
+
+// --------------------------------------------------------------------------
+// journal_is_open
+//
+// Checks if edits are being written to a journal
+//
+// --------------------------------------------------------------------------
+
+gboolean journal_is_open( void )
+{
+  return( journal != NULL );
+}
+
+// --------------------------------------------------------------------------
+// journal_position
+//
+// Returns the current length of the journal, everything before this has
+// been written to disk
+//
+// --------------------------------------------------------------------------
+
+glong journal_position( void )
+{
+  return( ( journal != NULL ) ? ftell( journal ) : 0 );
+}
+
+// --------------------------------------------------------------------------
+// journal_needs_compaction
+//
+// Checks if the journal has grown enough for the file to be rewritten
+//
+// --------------------------------------------------------------------------
+
+gboolean journal_needs_compaction( void )
+{
+  return( journal_position() > JOURNAL_COMPACT_SIZE );
+}
+
+// --------------------------------------------------------------------------
+// journal_append
+//
+// Makes sure that the records written so far are on the disk
+//
+// --------------------------------------------------------------------------
+
+void journal_append( void )
+{
+  if( ( writer_flush( journal_writer ) == FALSE ) ||
+      ( fflush( journal ) != 0 ) ||
+      ( fdatasync( fileno( journal ) ) != 0 ) )
+  {
+    g_info( "  ERROR - could not write to journal" );
+  }
+}
+
+// --------------------------------------------------------------------------
+// journal_record_text
+//
+// Adds a change to the text of a cell
+//
+// --------------------------------------------------------------------------
+
+void journal_record_text( guint index, gint row, gint column, const gchar *text )
+{
+  if( journal != NULL )
+  {
+    writer_printf( journal_writer, "[%d,%d,%d,%u,\"", JOURNAL_TEXT, row, column, index );
+    writer_json( journal_writer, text, strlen( text ) );
+    writer_puts( journal_writer, "\"]\n" );
+    journal_append();
+  }
+}
+
+// --------------------------------------------------------------------------
+// journal_record_colour
+//
+// Adds a change to the background colour of a cell
+//
+// --------------------------------------------------------------------------
+
+void journal_record_colour( gint row, gint column, background_colour_type colour )
+{
+  if( journal != NULL )
+  {
+    writer_printf( journal_writer, "[%d,%d,%d,%d]\n", JOURNAL_COLOUR, row, column, colour );
+    journal_append();
+  }
+}
+
+// --------------------------------------------------------------------------
+// journal_record_change
+//
+// Adds a row or column being inserted or deleted
+//
+// --------------------------------------------------------------------------
+
+void journal_record_change( gint type, gint position )
+{
+  if( journal != NULL )
+  {
+    writer_printf( journal_writer, "[%d,%d]\n", type, position );
+    journal_append();
+  }
+}
+
+// --------------------------------------------------------------------------
+// journal_apply
+//
+// Applies a single record to the document
+// Returns FALSE if the record isn't valid
+//
+// --------------------------------------------------------------------------
+
+gboolean journal_apply( json_scanner *scanner, mapter_doc *doc )
+{
+  gint type, position, column, value;
+  gboolean escaped;
+  doc_text text = { NULL, NULL, 0, FALSE };
+
+  if( ( json_scan_char( scanner, '[' ) == FALSE ) ||
+      ( json_scan_int( scanner, &type ) == FALSE ) ||
+      ( json_scan_char( scanner, ',' ) == FALSE ) ||
+      ( json_scan_int( scanner, &position ) == FALSE ) )
+  {
+    return FALSE;
+  }
+  switch( type )
+  {
+    case JOURNAL_TEXT:
+    case JOURNAL_COLOUR:
+      if( ( json_scan_char( scanner, ',' ) == FALSE ) ||
+          ( json_scan_int( scanner, &column ) == FALSE ) ||
+          ( json_scan_char( scanner, ',' ) == FALSE ) ||
+          ( json_scan_int( scanner, &value ) == FALSE ) )
+      {
+        return FALSE;
+      }
+      doc_cell *cell = doc_get_cell( doc, position, column );
+      if( cell == NULL )
+      {
+        return FALSE;
+      }
+      if( type == JOURNAL_COLOUR )
+      {
+        cell->colour = ( ( value >= NONE ) && ( value <= NEUTRAL ) ) ? value : NONE;
+        doc_cell_changed( doc, cell );
+        break;
+      }
+      if( ( value < 0 ) || ( value >= MAX_LIST ) ||
+          ( json_scan_char( scanner, ',' ) == FALSE ) ||
+          ( json_scan_string( scanner, &text, &escaped ) == FALSE ) )
+      {
+        return FALSE;
+      }
+      // Decode it now as the journal buffer won't be kept
+      doc_text_get( &text );
+      doc_text *cell_text = list_cell_text( cell, value );
+      doc_text_clear( cell_text );
+      *cell_text = text;
+      doc_cell_changed( doc, cell );
+      break;
+    case JOURNAL_INSERT_ROW:
+      doc_insert_row( doc, position );
+      break;
+    case JOURNAL_INSERT_COLUMN:
+      doc_insert_column( doc, position );
+      break;
+    case JOURNAL_DELETE_ROW:
+      doc_delete_row( doc, position );
+      break;
+    case JOURNAL_DELETE_COLUMN:
+      doc_delete_column( doc, position );
+      break;
+    default:
+      return FALSE;
+  }
+  // Replayed edits aren't in the file yet
+  if( type > JOURNAL_COLOUR )
+  {
+    doc_structure_changed( doc );
+  }
+  // Nothing else should be on the line
+  return( ( json_scan_char( scanner, ']' ) == TRUE ) &&
+          ( json_scan_space( scanner ) == FALSE ) );
+}
+
+// --------------------------------------------------------------------------
+// journal_replay
+//
+// Applies any journal for the specified file to the document just loaded
+// from it. Length is set to the end of the last complete record, or 0 if
+// there's nothing to keep
+//
+// --------------------------------------------------------------------------
+
+result_return journal_replay( const gchar *file_path, mapter_doc *doc, glong *length )
+{
+  result_return journal_result = { TRUE, "" };
+  gchar *contents = NULL;
+  gsize contents_length;
+  gint count = 0;
+
+  g_info( "journal.c / journal_replay");
+  *length = 0;
+  gchar *journal_path = journal_file_path( file_path );
+  gchar *header = journal_header( file_path );
+  if( g_file_get_contents( journal_path, &contents, &contents_length, NULL ) == FALSE )
+  {
+    g_info( "  No journal" );
+    goto error_exit;
+  }
+  if( strncmp( contents, header, strlen( header ) ) != 0 )
+  {
+    // The file has been changed without the journal so it can't be used,
+    // keep it in case it's wanted
+    gchar *stale_path = g_strconcat( journal_path, SAVE_BACKUP_SUFFIX, NULL );
+    g_info( "  ERROR - journal doesn't match file, moving it to: %s", stale_path );
+    rename( journal_path, stale_path );
+    g_free( stale_path );
+    journal_result.result = FALSE;
+    journal_result.message = "The journal of unsaved changes doesn't match the file so it was not used";
+    goto error_exit;
+  }
+  const gchar *line = contents + strlen( header );
+  const gchar *end = contents + contents_length;
+  *length = line - contents;
+  while( line < end )
+  {
+    // A crash part way through a record leaves it without a line end
+    const gchar *line_end = memchr( line, '\n', end - line );
+    if( line_end == NULL )
+    {
+      g_info( "  Incomplete record at: %ld", (glong)( line - contents ) );
+      break;
+    }
+    json_scanner scanner = { line, line, line_end };
+    if( journal_apply( &scanner, doc ) == FALSE )
+    {
+      g_info( "  Invalid record at: %ld", (glong)( line - contents ) );
+      break;
+    }
+    count++;
+    line = line_end + 1;
+    *length = line - contents;
+  }
+  g_info( "  Replayed %d records", count );
+
+error_exit:
+  g_free( contents );
+  g_free( header );
+  g_free( journal_path );
+  g_info( "journal.c / ~journal_replay");
+  return journal_result;
+}
+
+// --------------------------------------------------------------------------
+// journal_saved
+//
+// Called when the document has been saved to the specified file
+// Records before the position are now in the file so are dropped, any
+// records after it were added while a background save was running so
+// are kept
+//
+// --------------------------------------------------------------------------
+
+void journal_saved( const gchar *file_path, glong position )
+{
+  g_info( "journal.c / journal_saved");
+  if( save_settings_cache.use_journal == TRUE )
+  {
+    gchar *contents = NULL;
+    gsize length;
+    gchar *journal_path = journal_file_path( file_path );
+    if( ( journal != NULL ) && ( strcmp( journal_base, file_path ) == 0 ) &&
+        ( position < journal_position() ) &&
+        ( g_file_get_contents( journal_path, &contents, &length, NULL ) == TRUE ) &&
+        ( (gsize) position <= length ) )
+    {
+      g_info( "  Keeping %ld bytes of journal", (glong)( length - position ) );
+      gchar *header = journal_header( file_path );
+      gchar *kept = g_strconcat( header, contents + position, NULL );
+      journal_stop();
+      if( g_file_set_contents( journal_path, kept, -1, NULL ) == TRUE )
+      {
+        journal_start( file_path, strlen( kept ) );
+      }
+      else
+      {
+        journal_start( file_path, 0 );
+      }
+      g_free( kept );
+      g_free( header );
+    }
+    else
+    {
+      journal_start( file_path, 0 );
+    }
+    g_free( contents );
+    g_free( journal_path );
+  }
+  g_info( "journal.c / ~journal_saved");
+}
+
+// --------------------------------------------------------------------------
+// journal_close
+//
+// Closes the journal when its file is closed, folding any records in it
+// back into the file so that the journal can be removed
+// The file on disk plus the journal is all that's needed so this doesn't
+// need the widgets and works as the program exits
+//
+// --------------------------------------------------------------------------
+
+void journal_close( void )
+{
+  mapter_doc *doc = NULL;
+  glong length;
+
+  g_info( "journal.c / journal_close");
+  if( journal != NULL )
+  {
+    gchar *file_path = g_strdup( journal_base );
+    gchar *journal_path = journal_file_path( file_path );
+    gboolean has_records = ( journal_position() > journal_header_length );
+    journal_stop();
+    if( has_records == FALSE )
+    {
+      unlink( journal_path );
+    }
+    else if( ( load_document( file_path, &doc ).result == TRUE ) &&
+             ( journal_replay( file_path, doc, &length ).result == TRUE ) &&
+             ( save_document( doc, file_path, config_backups() ).result == TRUE ) )
+    {
+      g_info( "  Journal folded into: %s", file_path );
+      unlink( journal_path );
+    }
+    else
+    {
+      // Left to be replayed next time
+      g_info( "  ERROR - could not fold journal into: %s", file_path );
+    }
+    doc_free( doc );
+    g_free( journal_path );
+    g_free( file_path );
+  }
+  g_info( "journal.c / ~journal_close");
+}
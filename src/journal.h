@@ -0,0 +1,53 @@
+// journal.h - header file for journal.c
+//             part of the mapter program
+// Copyright (C) 2020 John Davies
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+// The journal is kept alongside the file that it belongs to
+#define JOURNAL_EXTENSION ".journal"
+// First line, followed by the size and modification time of the file, in
+// seconds and nanoseconds
+#define JOURNAL_MAGIC "MAPTERJ"
+// The file is rewritten once the journal gets bigger than this
+#define JOURNAL_COMPACT_SIZE ( 1024 * 1024 )
+
+// Record types, the first value of each record
+#define JOURNAL_TEXT 1            // [ 1, row, column, list, "text" ]
+#define JOURNAL_COLOUR 2          // [ 2, row, column, colour ]
+#define JOURNAL_INSERT_ROW 3      // [ 3, row ]
+#define JOURNAL_INSERT_COLUMN 4   // [ 4, column ]
+#define JOURNAL_DELETE_ROW 5      // [ 5, row ]
+#define JOURNAL_DELETE_COLUMN 6   // [ 6, column ]
+
+gchar *journal_file_path( const gchar * );
+gchar *journal_header( const gchar * );
+gboolean journal_start( const gchar *, glong );
+void journal_stop( void );
+gboolean journal_is_open( void );
+glong journal_position( void );
+gboolean journal_needs_compaction( void );
+void journal_append( void );
+void journal_record_text( guint, gint, gint, const gchar * );
+void journal_record_colour( gint, gint, background_colour_type );
+void journal_record_change( gint, gint );
+gboolean journal_apply( json_scanner *, mapter_doc * );
+result_return journal_replay( const gchar *, mapter_doc *, glong * );
+void journal_saved( const gchar *, glong );
+void journal_close( void );
+
+#endif
@@ -1,5 +1,5 @@
-// list.c - Functions for managing the linked lists that hold the
-//          headings and the text body contents
+// list.c - Functions for managing the document that holds the
+//          summaries, headings and the text body contents
 // Copyright (C) 2020 John Davies
 //
 // This program is free software: you can redistribute it and/or modify
@@ -17,57 +17,125 @@
 
 #include <gtk/gtk.h>
 #include "main.h"
+#include "doc.h"
 #include "list.h"
+#include "file.h"
+#include "journal.h"
+#include "preview.h"
 
-// Single linked lists definition
+// The current document
 
-GSList *lists[ MAX_LIST ];
+mapter_doc *document = NULL;
 
 // --------------------------------------------------------------------------
-// delete_element
+// list_cell_text
 //
-// Frees the memory used by the GString that's passed in
-// Used by list_init
+// Returns the text entry of the cell that matches the list index
 //
 // --------------------------------------------------------------------------
 
-void delete_element( gpointer element )
+doc_text *list_cell_text( doc_cell *cell, guint index )
 {
-  g_string_free( (GString *) element, TRUE );
+  switch( index )
+  {
+    case HEADER_LIST:
+      return &cell->heading;
+    case BODY_LIST:
+      return &cell->body;
+    case SUMMARY_LIST:
+      return &cell->summary;
+    default:
+      break;
+  }
+  return NULL;
 }
 
 // --------------------------------------------------------------------------
 // list_init
 //
-// Initialises the specified list to hold the specified row and columns
-// Any current data in the list are deleted
+// Initialises the document to hold the specified row and columns
+// Any current data in the document are deleted
 //
 // --------------------------------------------------------------------------
 
-void list_init( guint index, gint rows, gint columns )
+void list_init( gint rows, gint columns )
 {
   g_info( "list.c / list_init");
-  if( index < MAX_LIST )
-  {
-    g_info( "  Initialising - Rows: %d, Columns: %d", rows, columns );
-    // Clear and existing data and free any memory
-    g_slist_free_full( g_steal_pointer( &lists[index] ), delete_element );
-    // Create new blank strings, prepend the strings to make it more
-    // efficient then reverse the string later
-    for( gint r=0; r<rows; r++ )
-    {
-      for( gint c=0; c<columns; c++ )
-      {
-        lists[index] = g_slist_prepend( lists[index], g_string_new( NULL ) );
-      }
-    }
-    lists[index] = g_slist_reverse( lists[index] );
-  }
-  else
+  g_info( "  Initialising - Rows: %d, Columns: %d", rows, columns );
+  // Clear any existing data and free any memory
+  list_set_document( doc_new( rows, columns ) );
+  g_info( "list.c / ~list_init");
+}
+
+// --------------------------------------------------------------------------
+// list_set_document
+//
+// Replaces the current document with the one passed in, which is then
+// owned by the list
+//
+// --------------------------------------------------------------------------
+
+void list_set_document( mapter_doc *doc )
+{
+  g_info( "list.c / list_set_document");
+  doc_free( g_steal_pointer( &document ) );
+  document = doc;
+  preview_invalidate();
+  g_info( "list.c / ~list_set_document");
+}
+
+// --------------------------------------------------------------------------
+// list_get_document
+//
+// Returns the current document
+//
+// --------------------------------------------------------------------------
+
+mapter_doc *list_get_document( void )
+{
+  return document;
+}
+
+// --------------------------------------------------------------------------
+// list_notes_changed
+//
+// Records that the notes have been changed
+//
+// --------------------------------------------------------------------------
+
+void list_notes_changed( app_widgets *app_wdgts )
+{
+  doc_notes_changed( document );
+  list_changed( app_wdgts );
+}
+
+// --------------------------------------------------------------------------
+// list_note_changed
+//
+// Records that the heading or text of a single note has been changed
+//
+// --------------------------------------------------------------------------
+
+void list_note_changed( gint index, app_widgets *app_wdgts )
+{
+  doc_note_changed( document, index );
+  list_changed( app_wdgts );
+}
+
+// --------------------------------------------------------------------------
+// list_changed
+//
+// Passes on that the document has been changed, the app can be NULL when
+// the document isn't being shown
+//
+// --------------------------------------------------------------------------
+
+void list_changed( app_widgets *app_wdgts )
+{
+  if( app_wdgts != NULL )
   {
-    g_info( "  ERROR - list index out of range: %d", index );
+    document_changed( app_wdgts );
   }
-  g_info( "list.c / ~list_init");
 }
 
 // --------------------------------------------------------------------------
@@ -77,36 +145,13 @@ void list_init( guint index, gint rows, gint columns )
 //
 // --------------------------------------------------------------------------
 
-void list_insert_row( guint index, gint row, app_widgets *app_wdgts  )
+void list_insert_row( gint row, app_widgets *app_wdgts  )
 {
   g_info( "list.c / list_insert_row");
-  g_info( "Inserting row at %d", row );
-  if( index < MAX_LIST )
-  {
-    // Check if the row is in range
-    if( row < 0 )
-    {
-      // Too low so set it to the first row
-      g_info( "  ERROR - row out of range: %d, setting to 0", row );
-      row = 0;
-    }
-    else if( row > app_wdgts->current_grid_rows )
-    {
-      // Too high so set it to the last row
-      g_info( "  ERROR - row out of range: %d, setting to %d", row, app_wdgts->current_grid_rows );
-      row = app_wdgts->current_grid_rows;
-    }
-
-    // Insert string at the relevant point
-    for( gint c=0; c<app_wdgts->current_grid_columns; c++ )
-    {
-      lists[index] = g_slist_insert( lists[index], g_string_new( NULL ), ( row * app_wdgts->current_grid_columns ) + c );
-    }
-  }
-  else
-  {
-    g_info( "  ERROR - list index out of range: %d", index );
-  }
+  doc_insert_row( document, row );
+  doc_structure_changed( document );
+  journal_record_change( JOURNAL_INSERT_ROW, row );
+  list_changed( app_wdgts );
   g_info( "list.c / ~list_insert_row");
 }
 
@@ -117,38 +162,13 @@ void list_insert_row( guint index, gint row, app_widgets *app_wdgts  )
 //
 // --------------------------------------------------------------------------
 
-void list_insert_column( guint index, gint column, app_widgets *app_wdgts  )
+void list_insert_column( gint column, app_widgets *app_wdgts  )
 {
   g_info( "list.c / list_insert_column");
-  g_info( "Inserting column at %d", column );
-  if( index < MAX_LIST )
-  {
-    // Check if the column is in range
-    if( column < 0 )
-    {
-      // Too low so set it to the first row
-      g_info( "  ERROR - column out of range: %d, setting to 0", column );
-      column = 0;
-    }
-    else if( column > app_wdgts->current_grid_columns )
-    {
-      // Too high so set it to the last row
-      g_info( "  ERROR - column out of range: %d, setting to %d", column, app_wdgts->current_grid_columns );
-      column = app_wdgts->current_grid_columns;
-    }
-
-    // Insert string at the relevant point
-    // Start at the end and work back because the inserts are not contiguous
-    for( gint r=app_wdgts->current_grid_rows-1; r>=0; r-- )
-    {
-      lists[index] = g_slist_insert( lists[index], g_string_new( NULL ), ( r * app_wdgts->current_grid_columns ) + column );
-      //g_info( "  Inserting at: %d", ( r * app_wdgts->current_grid_columns ) + column );
-    }
-  }
-  else
-  {
-    g_info( "  ERROR - list index out of range: %d", index );
-  }
+  doc_insert_column( document, column );
+  doc_structure_changed( document );
+  journal_record_change( JOURNAL_INSERT_COLUMN, column );
+  list_changed( app_wdgts );
   g_info( "list.c / ~list_insert_column");
 }
 
@@ -159,36 +179,13 @@ void list_insert_column( guint index, gint column, app_widgets *app_wdgts  )
 //
 // --------------------------------------------------------------------------
 
-void list_delete_row( guint index, gint row, app_widgets *app_wdgts  )
+void list_delete_row( gint row, app_widgets *app_wdgts  )
 {
   g_info( "list.c / list_delete_row");
-  g_info( "Deleting row at %d", row );
-
-  if( index < MAX_LIST )
-  {
-    // Check if the row is in range
-    if( row < app_wdgts->current_grid_rows )
-    {
-      // Delete string at the relevant point
-      for( gint c=0; c<app_wdgts->current_grid_columns; c++ )
-      {
-        // This should free the GString memory as well
-        // Don't increment pointer as everything will have shifted down one
-        // from the previous delete
-        lists[index] = g_slist_delete_link( lists[index],
-                              g_slist_nth( lists[index], row * app_wdgts->current_grid_columns ) );
-      }
-    }
-    else
-    {
-      g_info( "  ERROR - ignoring row out of range: %d", row );
-    }
-  }
-  else
-  {
-    g_info( "  ERROR - list index out of range: %d", index );
-  }
-
+  doc_delete_row( document, row );
+  doc_structure_changed( document );
+  journal_record_change( JOURNAL_DELETE_ROW, row );
+  list_changed( app_wdgts );
   g_info( "list.c / ~list_delete_row");
 }
 
@@ -199,36 +196,13 @@ void list_delete_row( guint index, gint row, app_widgets *app_wdgts  )
 //
 // --------------------------------------------------------------------------
 
-void list_delete_column( guint index, gint column, app_widgets *app_wdgts  )
+void list_delete_column( gint column, app_widgets *app_wdgts  )
 {
   g_info( "list.c / list_delete_column");
-  g_info( "Deleting column at %d", column );
-
-  if( index < MAX_LIST )
-  {
-    // Check if the row is in range
-    if( column < app_wdgts->current_grid_columns )
-    {
-      // Delete string at the relevant point
-      for( gint r=app_wdgts->current_grid_rows-1; r>=0; r-- )
-      {
-        // This should free the GString memory as well
-        // Start at the end and work back because the deletions are not contiguous
-        lists[index] = g_slist_delete_link( lists[index],
-                              g_slist_nth( lists[index], ( r * app_wdgts->current_grid_columns ) + column ) );
-        //g_info( "  Deleting at: %d", ( r * app_wdgts->current_grid_columns ) + column );
-      }
-    }
-    else
-    {
-      g_info( "  ERROR - ignoring column out of range: %d", column );
-    }
-  }
-  else
-  {
-    g_info( "  ERROR - list index out of range: %d", index );
-  }
-
+  doc_delete_column( document, column );
+  doc_structure_changed( document );
+  journal_record_change( JOURNAL_DELETE_COLUMN, column );
+  list_changed( app_wdgts );
   g_info( "list.c / ~list_delete_column");
 }
 
@@ -242,18 +216,14 @@ void list_delete_column( guint index, gint column, app_widgets *app_wdgts  )
 gchar *list_get_text( guint index, gint row, gint column, app_widgets *app_wdgts )
 {
   gchar *text = NULL;
-  gint length;
   g_info( "list.c / list_get_text");
   g_info( "  Reading text at Row: %d, Column %d", row, column );
   if( index < MAX_LIST )
   {
-    length = g_slist_length( lists[index] );
-    g_info( "  List length: %d", length );
-
-    GString *element = g_slist_nth_data( lists[index], ( row * app_wdgts->current_grid_columns ) + column );
-    if( element != NULL )
+    doc_cell *cell = doc_get_cell( document, row, column );
+    if( cell != NULL )
     {
-      text = element->str;
+      text = (gchar *) doc_text_get( list_cell_text( cell, index ) );
     }
   }
   else
@@ -275,17 +245,23 @@ gchar *list_get_text( guint index, gint row, gint column, app_widgets *app_wdgts
 
 gchar *list_put_text( guint index, gint row, gint column, gchar *text, app_widgets *app_wdgts )
 {
-  gint length;
   g_info( "list.c / list_put_text");
-  g_info( "  Reading text at Row: %d, Column %d", row, column );
+  g_info( "  Writing text at Row: %d, Column %d", row, column );
   if( index < MAX_LIST )
   {
-    length = g_slist_length( lists[index] );
-    g_info( "  List length: %d", length );
-
-    GString *element = g_slist_nth_data( lists[index], ( row * app_wdgts->current_grid_columns ) + column );
-    g_string_erase( element, 0, -1 );
-    g_string_overwrite( element, 0, text );
+    doc_cell *cell = doc_get_cell( document, row, column );
+    if( cell != NULL )
+    {
+      doc_text *cell_text = list_cell_text( cell, index );
+      // Only record actual changes, the editor puts back all the text
+      if( g_strcmp0( doc_text_get( cell_text ), text ) != 0 )
+      {
+        doc_text_set( cell_text, text );
+        doc_cell_changed( document, cell );
+        journal_record_text( index, row, column, doc_text_get( cell_text ) );
+        list_changed( app_wdgts );
+      }
+    }
   }
   else
   {
@@ -296,3 +272,44 @@ gchar *list_put_text( guint index, gint row, gint column, gchar *text, app_widge
   return text;
 
 }
+
+// --------------------------------------------------------------------------
+// list_get_colour
+//
+// Gets the background colour of the specified cell
+//
+// --------------------------------------------------------------------------
+
+background_colour_type list_get_colour( gint row, gint column, app_widgets *app_wdgts )
+{
+  background_colour_type colour = NONE;
+  doc_cell *cell = doc_get_cell( document, row, column );
+  if( cell != NULL )
+  {
+    colour = cell->colour;
+  }
+  return colour;
+}
+
+// --------------------------------------------------------------------------
+// list_put_colour
+//
+// Sets the background colour of the specified cell
+//
+// --------------------------------------------------------------------------
+
+void list_put_colour( gint row, gint column, background_colour_type colour, app_widgets *app_wdgts )
+{
+  doc_cell *cell = doc_get_cell( document, row, column );
+  if( cell != NULL )
+  {
+    // Setting up the grid puts back the same colour so only record changes
+    if( cell->colour != colour )
+    {
+      cell->colour = colour;
+      doc_cell_changed( document, cell );
+      journal_record_colour( row, column, colour );
+      list_changed( app_wdgts );
+    }
+  }
+}
@@ -17,17 +17,26 @@
 #ifndef LIST_H
 #define LIST_H
 
-// Index into array of linked lists
-#define MAX_LIST 2      // Number of lists
+// Index into the text held for each cell
+#define MAX_LIST 3      // Number of text entries per cell
 #define HEADER_LIST 0
 #define BODY_LIST 1
+#define SUMMARY_LIST 2
 
-void list_init( guint, gint, gint );
-void list_insert_row( guint, gint, app_widgets * );
-void list_insert_column( guint, gint, app_widgets * );
-void list_delete_row( guint, gint, app_widgets * );
-void list_delete_column( guint, gint, app_widgets * );
+doc_text *list_cell_text( doc_cell *, guint );
+void list_init( gint, gint );
+void list_set_document( mapter_doc * );
+mapter_doc *list_get_document( void );
+void list_notes_changed( app_widgets * );
+void list_note_changed( gint, app_widgets * );
+void list_changed( app_widgets * );
+void list_insert_row( gint, app_widgets * );
+void list_insert_column( gint, app_widgets * );
+void list_delete_row( gint, app_widgets * );
+void list_delete_column( gint, app_widgets * );
 gchar *list_get_text( guint, gint, gint, app_widgets * );
 gchar *list_put_text( guint, gint, gint, gchar *, app_widgets * );
+background_colour_type list_get_colour( gint, gint, app_widgets * );
+void list_put_colour( gint, gint, background_colour_type, app_widgets * );
 
 #endif
@@ -23,12 +23,19 @@
 #include <gtkspell/gtkspell.h>
 #include <time.h>
 #include "main.h"
+#include "doc.h"
 #include "file.h"
 #include "grid.h"
 #include "util.h"
 #include "css.h"
 #include "config.h"
 #include "gui.h"
+#include "check.h"
+#include "journal.h"
+#include "tree.h"
+#include "bench.h"
+#include "template.h"
+#include "export.h"
 
 // --------------------------------------------------------------------------
 // main
@@ -41,6 +48,27 @@ int main( int argc, char *argv[] )
 {
     GtkBuilder      *builder;
     GtkWidget       *window;
+
+    // Check files without starting the GUI
+    if( ( argc > 1 ) && ( strcmp( argv[1], CHECK_OPTION ) == 0 ) )
+    {
+      return check_files( argc - 2, &argv[2] );
+    }
+    // Benchmarks, also without the GUI
+    if( ( argc > 1 ) && ( strcmp( argv[1], BENCH_OPTION ) == 0 ) )
+    {
+      return bench_files( argc - 2, &argv[2] );
+    }
+    if( ( argc > 1 ) && ( strcmp( argv[1], GENERATE_OPTION ) == 0 ) )
+    {
+      return bench_generate_file( argc - 2, &argv[2] );
+    }
+    // Export, also without the GUI
+    if( ( argc > 1 ) && ( strcmp( argv[1], EXPORT_OPTION ) == 0 ) )
+    {
+      return export_files( argc - 2, &argv[2] );
+    }
+
     // Instantiate structure, allocating memory for it
     app_widgets     *widgets = g_slice_new(app_widgets);
 
@@ -69,6 +97,7 @@ int main( int argc, char *argv[] )
     widgets->w_edit_search_entry = GTK_WIDGET(gtk_builder_get_object(builder, "edit_search_entry"));
     widgets->check_btn_edit_case = GTK_WIDGET(gtk_builder_get_object(builder, "check_btn_edit_case"));
     widgets->m_save = GTK_WIDGET( gtk_builder_get_object(builder, "save") );
+    widgets->m_compact = GTK_WIDGET( gtk_builder_get_object(builder, "compact") );
     widgets->w_notes_textview = GTK_WIDGET(gtk_builder_get_object(builder, "notes_textview"));
     widgets->w_notes_treeview = GTK_TREE_VIEW( gtk_builder_get_object( builder, "notes_treeview" ));
     widgets->w_notes_treestore = GTK_TREE_STORE( gtk_builder_get_object( builder, "notes_treestore" ));
@@ -85,11 +114,22 @@ int main( int argc, char *argv[] )
     widgets->b_chkbtn_export_dup_cr = GTK_WIDGET(gtk_builder_get_object(builder, "chkbtn_export_dup_cr"));
     widgets->w_dlg_export = GTK_WIDGET(gtk_builder_get_object(builder, "dlg_export"));
     widgets->b_chkbtn_export_series = GTK_WIDGET(gtk_builder_get_object(builder, "chkbtn_export_series"));
+    widgets->b_chkbtn_export_columns = GTK_WIDGET(gtk_builder_get_object(builder, "chkbtn_export_columns"));
+    widgets->b_chkbtn_export_split = GTK_WIDGET(gtk_builder_get_object(builder, "chkbtn_export_split"));
+    widgets->b_chkbtn_export_incremental = GTK_WIDGET(gtk_builder_get_object(builder, "chkbtn_export_incremental"));
+    widgets->b_chkbtn_export_notes = GTK_WIDGET(gtk_builder_get_object(builder, "chkbtn_export_notes"));
+    widgets->w_cmb_export_format = GTK_WIDGET(gtk_builder_get_object(builder, "cmb_export_format"));
+    widgets->w_preview_box = GTK_WIDGET(gtk_builder_get_object(builder, "preview_box"));
+    widgets->w_preview_textview = GTK_WIDGET(gtk_builder_get_object(builder, "preview_textview"));
+    widgets->w_cmb_preview_format = GTK_WIDGET(gtk_builder_get_object(builder, "cmb_preview_format"));
     widgets->l_row_id_label  = GTK_WIDGET(gtk_builder_get_object(builder, "row_id_label"));
     widgets->l_column_id_label  = GTK_WIDGET(gtk_builder_get_object(builder, "column_id_label"));
 
      // Widgets pointer are passed to all widget handler functions as the user_data parameter
     gtk_builder_connect_signals( builder, widgets );
+    // Count typing in the notes as a change to the document
+    g_signal_connect( gtk_text_view_get_buffer( GTK_TEXT_VIEW( widgets->w_notes_textview ) ), "modified-changed",
+                      G_CALLBACK( on_notes_text_modified_changed ), widgets );
 
     g_object_unref( builder );
 
@@ -198,6 +238,10 @@ int main( int argc, char *argv[] )
     g_object_unref( provider );
 
     gtk_main();
+    // Make sure that any save still running has finished and fold any
+    // journal back into its file
+    save_wait();
+    journal_close();
     // Free up widget structure memory
     g_slice_free( app_widgets, widgets );
 
@@ -35,11 +35,15 @@
 #define APP_NAME_SIZE 256
 #define MAX_PATHSIZE 4096
 #define MAX_FILENAME 256
-#define MAX_WINDOW_TITLE APP_NAME_SIZE + MAX_FILENAME + 4
+#define MAX_WINDOW_TITLE APP_NAME_SIZE + MAX_FILENAME + 5
 #define DIRECTORY_SEPARATOR '/'
 
 // Error strings
 #define EXPORT_ERROR "Error opening export file"
+#define OUTLINE_ERROR "Error writing notes file"
+
+// Shown in front of the window title when there are unsaved changes
+#define UNSAVED_MARKER "*"
 
 // Layout
 // Width of each cell in characters
@@ -77,6 +81,7 @@ typedef struct {
     GtkWidget *w_edit_search_entry;
     GtkWidget *check_btn_edit_case;
     GtkWidget *m_save;
+    GtkWidget *m_compact;
     // Tree View
     GtkWidget *w_notes_textview;
     GtkTreeView *w_notes_treeview;
@@ -94,7 +99,16 @@ typedef struct {
     GtkWidget *b_chkbtn_export_title;
     GtkWidget *b_chkbtn_export_dup_cr;
     GtkWidget *b_chkbtn_export_series;
+    GtkWidget *b_chkbtn_export_columns;
+    GtkWidget *b_chkbtn_export_split;
+    GtkWidget *b_chkbtn_export_incremental;
+    GtkWidget *b_chkbtn_export_notes;
+    GtkWidget *w_cmb_export_format;
     GtkWidget *w_dlg_export;
+    // Export preview tab
+    GtkWidget *w_preview_box;
+    GtkWidget *w_preview_textview;
+    GtkWidget *w_cmb_preview_format;
     GtkWidget *l_row_id_label;
     GtkWidget *l_column_id_label;
     // Accelerator group for right click menu
@@ -112,6 +126,15 @@ typedef struct {
   gchar *message;
 } result_return;
 
+// Buffered output used for saving and exporting, see writer.c
+typedef struct {
+  FILE *file;
+  gchar *buffer;
+  gsize used;
+  guint64 flushed;                // Bytes passed to the file so far
+  gboolean failed;                // Set if any write to the file failed
+} output_writer;
+
 // Colours for cell background
 // Note also the values in css.c
 typedef enum { NONE = 0, HIGH, MEDIUM, LOW, NEUTRAL } background_colour_type;
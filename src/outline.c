@@ -0,0 +1,367 @@
+// outline.c - exports the notes tree as an outline
+//             part of the mapter program
+// Copyright (C) 2020 John Davies
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// The notes are held in the document in depth first order with the level
+// of each one, so the outline is written in a single pass over them. Only
+// the level of the last note is needed to know where the next one goes,
+// nothing is built up for the path to each note
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gtk/gtk.h>
+#include "main.h"
+#include "doc.h"
+#include "save.h"
+#include "writer.h"
+#include "template.h"
+#include "export.h"
+#include "outline.h"
+
+// File name extensions for each format, anything else is plain text
+
+const outline_extension outline_extensions[] = {
+  { "md", OUTLINE_MARKDOWN },
+  { "markdown", OUTLINE_MARKDOWN },
+  { "opml", OUTLINE_OPML },
+  { NULL, OUTLINE_PLAIN }
+};
+
+// Characters that are replaced in OPML attribute values, as for XML text
+// but line ends and tabs are written as references or they'd be read back
+// as spaces
+
+const gchar *outline_attribute_escapes[ 256 ] = {
+  [ 0x01 ... 0x08 ] = "", [ '\t' ] = "&#9;", [ '\n' ] = "&#10;", [ 0x0b ... 0x0c ] = "",
+  [ '\r' ] = "&#13;", [ 0x0e ... 0x1f ] = "",
+  [ '&' ] = "&amp;", [ '<' ] = "&lt;", [ '>' ] = "&gt;", [ '"' ] = "&quot;"
+};
+
+// --------------------------------------------------------------------------
+// outline_lookup
+//
+// Returns the format to write a file in from its extension, the case of
+// the extension doesn't matter
+//
+// --------------------------------------------------------------------------
+
+outline_format outline_lookup( const gchar *file_path )
+{
+  const gchar *extension = strrchr( file_path, '.' );
+
+  if( ( extension != NULL ) && ( strchr( extension, G_DIR_SEPARATOR ) == NULL ) )
+  {
+    for( gint i=0; outline_extensions[i].extension != NULL; i++ )
+    {
+      if( g_ascii_strcasecmp( extension + 1, outline_extensions[i].extension ) == 0 )
+      {
+        return outline_extensions[i].format;
+      }
+    }
+  }
+  return OUTLINE_PLAIN;
+}
+
+// --------------------------------------------------------------------------
+// outline_file
+//
+// Writes the notes of a document to a file of their own, in the format
+// that goes with the file name. The file is only replaced once the whole
+// outline has been written
+//
+// --------------------------------------------------------------------------
+
+result_return outline_file( mapter_doc *doc, const gchar *file_path )
+{
+  save_target *target;
+  doc_name title;
+
+  g_info( "outline.c / outline_file");
+  g_info( "  Outline filename: %s", file_path );
+  // Named the same as the title of an export
+  doc_traversal_name( &title, &doc->cells[0].heading );
+  if( title.length == 0 )
+  {
+    doc_traversal_name( &title, &doc->cells[0].summary );
+  }
+  result_return outline_result = save_begin( file_path, FALSE, &target );
+  if( outline_result.result == TRUE )
+  {
+    output_writer *writer = writer_new( target->file );
+    outline_write( doc->notes, outline_lookup( file_path ), &title, writer );
+    if( writer_free( writer ) == TRUE )
+    {
+      outline_result = save_finish( target, 0 );
+    }
+    else
+    {
+      save_abort( target );
+      outline_result.result = FALSE;
+      outline_result.message = "Could not write outline file";
+    }
+  }
+  g_info( "  %d notes", doc->notes->len );
+  g_info( "outline.c / ~outline_file");
+  return outline_result;
+}
+
+// --------------------------------------------------------------------------
+// outline_write
+//
+// Writes the notes as an outline. A note can only be one level deeper
+// than the one before, the same as when the tree is loaded, and an OPML
+// outline is closed off on the way back up. The title is only used by OPML
+//
+// --------------------------------------------------------------------------
+
+void outline_write( GArray *notes, outline_format format, doc_name *title, output_writer *writer )
+{
+  gint level = -1;
+
+  if( format == OUTLINE_OPML )
+  {
+    outline_opml_begin( writer, title );
+  }
+  for( guint n=0; n<notes->len; n++ )
+  {
+    doc_note *note = &g_array_index( notes, doc_note, n );
+    gint next = CLAMP( note->level, 0, level + 1 );
+    if( format == OUTLINE_OPML )
+    {
+      outline_opml_close( writer, level, next );
+    }
+    level = next;
+    if( format == OUTLINE_MARKDOWN )
+    {
+      outline_markdown( writer, note, level );
+    }
+    else if( format == OUTLINE_OPML )
+    {
+      // Left open if the next note is a child of this one
+      gboolean children = ( n + 1 < notes->len ) && ( g_array_index( notes, doc_note, n + 1 ).level > level );
+      outline_opml_note( writer, note, level, children );
+    }
+    else
+    {
+      outline_plain( writer, note, level );
+    }
+  }
+  if( format == OUTLINE_OPML )
+  {
+    outline_opml_close( writer, level, 0 );
+    writer_puts( writer, "  </body>\n</opml>\n" );
+  }
+}
+
+// --------------------------------------------------------------------------
+// outline_plain
+//
+// Writes a note as plain text, the heading is indented by its level and
+// the text by one level more, with a blank line after each note
+//
+// --------------------------------------------------------------------------
+
+void outline_plain( output_writer *writer, doc_note *note, gint level )
+{
+  gsize length;
+
+  outline_indent( writer, level );
+  const gchar *heading = doc_text_peek( &note->heading, &length );
+  writer_write( writer, heading, length );
+  writer_puts( writer, "\n" );
+  outline_lines( writer, &note->text, level + 1 );
+  writer_puts( writer, "\n" );
+}
+
+// --------------------------------------------------------------------------
+// outline_markdown
+//
+// Writes a note as an item of a nested list, the text is indented to
+// line up with the heading so that it's a paragraph of the same item.
+// The heading is escaped but the text is copied as it is, so any
+// Markdown in the notes still works
+//
+// --------------------------------------------------------------------------
+
+void outline_markdown( output_writer *writer, doc_note *note, gint level )
+{
+  gsize length;
+
+  outline_indent( writer, level );
+  writer_puts( writer, "- " );
+  const gchar *heading = doc_text_peek( &note->heading, &length );
+  template_write_markdown( writer, heading, length );
+  writer_puts( writer, "\n\n" );
+  doc_text_peek( &note->text, &length );
+  if( length > 0 )
+  {
+    outline_lines( writer, &note->text, level + 1 );
+    writer_puts( writer, "\n" );
+  }
+}
+
+// --------------------------------------------------------------------------
+// outline_opml_begin
+//
+// Writes the start of an OPML 2.0 file up to the start of the body
+//
+// --------------------------------------------------------------------------
+
+void outline_opml_begin( output_writer *writer, doc_name *title )
+{
+  writer_puts( writer, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+               "<opml version=\"2.0\">\n"
+               "  <head>\n"
+               "    <title>" );
+  template_write( writer, ESCAPE_XML, title->text, title->length );
+  writer_puts( writer, "</title>\n"
+               "  </head>\n"
+               "  <body>\n" );
+}
+
+// --------------------------------------------------------------------------
+// outline_opml_note
+//
+// Writes a note as an outline element with its text in the _note
+// attribute, as used by most outliners. A note with children is left open
+//
+// --------------------------------------------------------------------------
+
+void outline_opml_note( output_writer *writer, doc_note *note, gint level, gboolean children )
+{
+  gsize length;
+
+  outline_indent( writer, level + 2 );
+  writer_puts( writer, "<outline text=\"" );
+  const gchar *text = doc_text_peek( &note->heading, &length );
+  template_write_table( writer, outline_attribute_escapes, text, length );
+  text = doc_text_peek( &note->text, &length );
+  if( length > 0 )
+  {
+    writer_puts( writer, "\" _note=\"" );
+    template_write_table( writer, outline_attribute_escapes, text, length );
+  }
+  writer_puts( writer, ( children == TRUE ) ? "\">\n" : "\"/>\n" );
+}
+
+// --------------------------------------------------------------------------
+// outline_opml_close
+//
+// Closes the open outline elements from the level of the last note back
+// up to the level of the next one
+//
+// --------------------------------------------------------------------------
+
+void outline_opml_close( output_writer *writer, gint level, gint next )
+{
+  for( gint open=level-1; open>=next; open-- )
+  {
+    outline_indent( writer, open + 2 );
+    writer_puts( writer, "</outline>\n" );
+  }
+}
+
+// --------------------------------------------------------------------------
+// outline_appendix
+//
+// Writes the notes at the end of an export if they're wanted. Plain text
+// has the outline as it would be in a file of its own, a template has a
+// chapter with a section for each note, numbered by where it is in the
+// tree, e.g. 2.1 is the first child of the second note at the top
+//
+// --------------------------------------------------------------------------
+
+void outline_appendix( doc_traversal *traversal, const export_options *options, output_writer *writer )
+{
+  template_values values = { { NULL }, { 0 } };
+  gsize length;
+
+  if( ( options->notes == FALSE ) || ( traversal->notes->len == 0 ) )
+  {
+    return;
+  }
+  if( options->template == NULL )
+  {
+    writer_puts( writer, OUTLINE_APPENDIX_TITLE "\n\n" );
+    outline_write( traversal->notes, OUTLINE_PLAIN, &traversal->titles[0], writer );
+    return;
+  }
+  // The number of each note so far at each level down to the current one
+  GArray *numbers = g_array_new( FALSE, TRUE, sizeof( gint ) );
+  GString *heading = g_string_new( NULL );
+  template_set( &values, FIELD_TITLE, traversal->titles[0].text, traversal->titles[0].length );
+  template_set( &values, FIELD_CHAPTER, OUTLINE_APPENDIX_TITLE, strlen( OUTLINE_APPENDIX_TITLE ) );
+  template_run( options->template, TEMPLATE_CHAPTER, &values, writer );
+  for( guint n=0; n<traversal->notes->len; n++ )
+  {
+    doc_note *note = &g_array_index( traversal->notes, doc_note, n );
+    gint level = CLAMP( note->level, 0, (gint) numbers->len );
+    // Anything deeper was for the notes before, the new levels start at 0
+    g_array_set_size( numbers, level + 1 );
+    g_array_index( numbers, gint, level )++;
+    g_string_truncate( heading, 0 );
+    for( gint i=0; i<=level; i++ )
+    {
+      g_string_append_printf( heading, ( i < level ) ? "%d." : "%d ", g_array_index( numbers, gint, i ) );
+    }
+    const gchar *text = doc_text_peek( &note->heading, &length );
+    g_string_append_len( heading, text, length );
+    template_set( &values, FIELD_HEADING, heading->str, heading->len );
+    template_run( options->template, TEMPLATE_SECTION, &values, writer );
+    export_paragraphs( options->template, &values, &note->text, options->dup_cr, writer );
+  }
+  g_string_free( heading, TRUE );
+  g_array_free( numbers, TRUE );
+}
+
+// --------------------------------------------------------------------------
+// outline_indent
+//
+// Writes the indentation for a level of the outline
+//
+// --------------------------------------------------------------------------
+
+void outline_indent( output_writer *writer, gint level )
+{
+  writer_write( writer, OUTLINE_SPACES, MIN( level * OUTLINE_INDENT, (gint) sizeof( OUTLINE_SPACES ) - 1 ) );
+}
+
+// --------------------------------------------------------------------------
+// outline_lines
+//
+// Writes the text of a note with each line indented for a level of the
+// outline, ending with a line end. Nothing is written if there's no text
+//
+// --------------------------------------------------------------------------
+
+void outline_lines( output_writer *writer, doc_text *text, gint level )
+{
+  gsize length;
+
+  const gchar *str = doc_text_peek( text, &length );
+  if( length == 0 )
+  {
+    return;
+  }
+  line_transform transform = { OUTLINE_SPACES, MIN( level * OUTLINE_INDENT, (gint) sizeof( OUTLINE_SPACES ) - 1 ),
+                               "\n", 1 };
+  writer_lines( writer, str, length, &transform );
+  if( str[ length - 1 ] != '\n' )
+  {
+    writer_puts( writer, "\n" );
+  }
+}
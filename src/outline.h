@@ -0,0 +1,50 @@
+// outline.h - header file for outline.c
+//             part of the mapter program
+// Copyright (C) 2020 John Davies
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef OUTLINE_H
+#define OUTLINE_H
+
+// Formats the notes tree can be written in on its own
+typedef enum { OUTLINE_PLAIN = 0, OUTLINE_MARKDOWN, OUTLINE_OPML } outline_format;
+
+// The format is picked from the file name extension
+typedef struct {
+  const gchar *extension;
+  outline_format format;
+} outline_extension;
+
+// Heading of the notes when they're added to an export
+#define OUTLINE_APPENDIX_TITLE "Notes"
+
+// Each level of the tree is indented by this much more than the last,
+// anything deeper than the spaces available is indented as far as they go
+#define OUTLINE_INDENT 2
+#define OUTLINE_SPACES "                                                                "
+
+outline_format outline_lookup( const gchar * );
+result_return outline_file( mapter_doc *, const gchar * );
+void outline_write( GArray *, outline_format, doc_name *, output_writer * );
+void outline_plain( output_writer *, doc_note *, gint );
+void outline_markdown( output_writer *, doc_note *, gint );
+void outline_opml_begin( output_writer *, doc_name * );
+void outline_opml_note( output_writer *, doc_note *, gint, gboolean );
+void outline_opml_close( output_writer *, gint, gint );
+void outline_appendix( doc_traversal *, const export_options *, output_writer * );
+void outline_indent( output_writer *, gint );
+void outline_lines( output_writer *, doc_text *, gint );
+
+#endif
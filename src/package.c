@@ -0,0 +1,523 @@
+// package.c - export formats that are a zip of several files, EPUB and ODT
+//             part of the mapter program
+// Copyright (C) 2020 John Davies
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <stdio.h>
+#include <string.h>
+#include <zlib.h>
+#include <gtk/gtk.h>
+#include "main.h"
+#include "doc.h"
+#include "config.h"
+#include "save.h"
+#include "writer.h"
+#include "template.h"
+#include "export.h"
+#include "zip.h"
+#include "package.h"
+#include "outline.h"
+
+// The chapters are written with a template in the same way as the other
+// formats, each EPUB chapter is a file of its own and all of an ODT goes
+// into content.xml
+
+const package_builtin package_builtins[] = {
+  { "epub", PACKAGE_EPUB,
+    "[" TEMPLATE_GROUP "]\n"
+    "escape=xml\n"
+    "extension=epub\n"
+    "begin=<?xml version=\"1.0\" encoding=\"utf-8\"?>\\n<!DOCTYPE html>\\n"
+    "<html xmlns=\"http://www.w3.org/1999/xhtml\" xmlns:epub=\"http://www.idpf.org/2007/ops\">\\n"
+    "<head>\\n<meta charset=\"utf-8\"/>\\n<title>${title}</title>\\n</head>\\n<body>\\n\n"
+    "title=<h1 class=\"title\">${title}</h1>\\n\n"
+    "chapter=<h1>${chapter}</h1>\\n\n"
+    "section=<h2>${heading}</h2>\\n\n"
+    "series_section=<h2>${series} - ${heading}</h2>\\n\n"
+    "paragraph=<p>${text}</p>\\n\n"
+    "end=</body>\\n</html>\\n\n" },
+  { "odt", PACKAGE_ODT,
+    "[" TEMPLATE_GROUP "]\n"
+    "escape=xml\n"
+    "extension=odt\n"
+    "begin=<?xml version=\"1.0\" encoding=\"UTF-8\"?>\\n"
+    "<office:document-content xmlns:office=\"urn:oasis:names:tc:opendocument:xmlns:office:1.0\" "
+    "xmlns:text=\"urn:oasis:names:tc:opendocument:xmlns:text:1.0\" office:version=\"1.2\">\\n"
+    "<office:body>\\n<office:text>\\n\n"
+    "title=<text:p text:style-name=\"Title\">${title}</text:p>\\n\n"
+    "chapter=<text:h text:style-name=\"Heading_20_1\" text:outline-level=\"1\">${chapter}</text:h>\\n\n"
+    "section=<text:h text:style-name=\"Heading_20_2\" text:outline-level=\"2\">${heading}</text:h>\\n\n"
+    "series_section=<text:h text:style-name=\"Heading_20_2\" text:outline-level=\"2\">"
+    "${series} - ${heading}</text:h>\\n\n"
+    "paragraph=<text:p text:style-name=\"Text_20_body\">${text}</text:p>\\n\n"
+    "end=</office:text>\\n</office:body>\\n</office:document-content>\\n\n" }
+};
+
+// Files that are the same in every package
+
+const gchar *package_epub_container =
+  "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+  "<container version=\"1.0\" xmlns=\"urn:oasis:names:tc:opendocument:xmlns:container\">\n"
+  "<rootfiles>\n"
+  "<rootfile full-path=\"" PACKAGE_EPUB_OPF "\" media-type=\"application/oebps-package+xml\"/>\n"
+  "</rootfiles>\n"
+  "</container>\n";
+
+const gchar *package_odt_manifest =
+  "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+  "<manifest:manifest xmlns:manifest=\"urn:oasis:names:tc:opendocument:xmlns:manifest:1.0\" manifest:version=\"1.2\">\n"
+  "<manifest:file-entry manifest:full-path=\"/\" manifest:version=\"1.2\" manifest:media-type=\""
+  PACKAGE_ODT_MIMETYPE "\"/>\n"
+  "<manifest:file-entry manifest:full-path=\"" PACKAGE_ODT_CONTENT "\" manifest:media-type=\"text/xml\"/>\n"
+  "<manifest:file-entry manifest:full-path=\"" PACKAGE_ODT_STYLES "\" manifest:media-type=\"text/xml\"/>\n"
+  "<manifest:file-entry manifest:full-path=\"" PACKAGE_ODT_META "\" manifest:media-type=\"text/xml\"/>\n"
+  "</manifest:manifest>\n";
+
+// Chapters start on a new page like a book
+const gchar *package_odt_styles =
+  "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+  "<office:document-styles xmlns:office=\"urn:oasis:names:tc:opendocument:xmlns:office:1.0\" "
+  "xmlns:style=\"urn:oasis:names:tc:opendocument:xmlns:style:1.0\" "
+  "xmlns:fo=\"urn:oasis:names:tc:opendocument:xmlns:xsl-fo-compatible:1.0\" office:version=\"1.2\">\n"
+  "<office:styles>\n"
+  "<style:style style:name=\"Standard\" style:family=\"paragraph\"/>\n"
+  "<style:style style:name=\"Text_20_body\" style:display-name=\"Text body\" style:family=\"paragraph\" "
+  "style:parent-style-name=\"Standard\">\n"
+  "<style:paragraph-properties fo:margin-top=\"0cm\" fo:margin-bottom=\"0.25cm\"/>\n"
+  "</style:style>\n"
+  "<style:style style:name=\"Heading\" style:family=\"paragraph\" style:parent-style-name=\"Standard\" "
+  "style:next-style-name=\"Text_20_body\">\n"
+  "<style:paragraph-properties fo:margin-top=\"0.42cm\" fo:margin-bottom=\"0.21cm\" fo:keep-with-next=\"always\"/>\n"
+  "<style:text-properties fo:font-weight=\"bold\"/>\n"
+  "</style:style>\n"
+  "<style:style style:name=\"Title\" style:family=\"paragraph\" style:parent-style-name=\"Heading\">\n"
+  "<style:paragraph-properties fo:text-align=\"center\"/>\n"
+  "<style:text-properties fo:font-size=\"200%\"/>\n"
+  "</style:style>\n"
+  "<style:style style:name=\"Heading_20_1\" style:display-name=\"Heading 1\" style:family=\"paragraph\" "
+  "style:parent-style-name=\"Heading\" style:default-outline-level=\"1\">\n"
+  "<style:paragraph-properties fo:break-before=\"page\"/>\n"
+  "<style:text-properties fo:font-size=\"130%\"/>\n"
+  "</style:style>\n"
+  "<style:style style:name=\"Heading_20_2\" style:display-name=\"Heading 2\" style:family=\"paragraph\" "
+  "style:parent-style-name=\"Heading\" style:default-outline-level=\"2\">\n"
+  "<style:text-properties fo:font-size=\"115%\"/>\n"
+  "</style:style>\n"
+  "</office:styles>\n"
+  "</office:document-styles>\n";
+
+// --------------------------------------------------------------------------
+// package_lookup
+//
+// Finds which package a format name is, PACKAGE_NONE for the formats that
+// are a single file
+//
+// --------------------------------------------------------------------------
+
+export_package package_lookup( const gchar *name )
+{
+  for( gsize i=0; i<G_N_ELEMENTS( package_builtins ); i++ )
+  {
+    if( strcmp( name, package_builtins[i].name ) == 0 )
+    {
+      return package_builtins[i].package;
+    }
+  }
+  return PACKAGE_NONE;
+}
+
+// --------------------------------------------------------------------------
+// package_template
+//
+// Compiles the template the chapters of a package are written with
+//
+// --------------------------------------------------------------------------
+
+result_return package_template( export_package package, export_template **template_out )
+{
+  for( gsize i=0; i<G_N_ELEMENTS( package_builtins ); i++ )
+  {
+    if( package_builtins[i].package == package )
+    {
+      return template_compile( package_builtins[i].data, strlen( package_builtins[i].data ), template_out );
+    }
+  }
+  *template_out = NULL;
+  return( (result_return) { FALSE, "Unknown export format" } );
+}
+
+// --------------------------------------------------------------------------
+// package_write
+//
+// Exports a range of chapters to a package file. The zip is written as a
+// stream, each file in it is compressed as it's generated so however long
+// the document only the compressor's window and a couple of buffers are
+// held. Like export_write the file is only replaced once it's complete
+//
+// --------------------------------------------------------------------------
+
+result_return package_write( const gchar *file_path, doc_traversal *traversal, const export_options *options,
+                             gboolean title, gint first, gint last )
+{
+  save_target *target;
+
+  g_info( "package.c / package_write");
+  g_info( "  Package filename: %s", file_path );
+  result_return package_result = save_begin( file_path, FALSE, &target );
+  if( package_result.result == TRUE )
+  {
+    zip_writer *zip = zip_new( target->file );
+    gboolean written = ( options->package == PACKAGE_EPUB ) ?
+                       package_epub( zip, traversal, options, title, first, last ) :
+                       package_odt( zip, traversal, options, title, first, last );
+    // The archive is always finished so the writer is freed
+    if( ( zip_finish( zip ) == TRUE ) && ( written == TRUE ) )
+    {
+      package_result = save_finish( target, 0 );
+    }
+    else
+    {
+      save_abort( target );
+      package_result.result = FALSE;
+      package_result.message = "Could not write export file";
+    }
+  }
+
+  g_info( "package.c / ~package_write");
+  return package_result;
+}
+
+// --------------------------------------------------------------------------
+// package_epub
+//
+// Writes an EPUB 3 book with the title page, each chapter and the notes
+// as an XHTML file of its own. The package document and table of contents
+// only list the files so they are written last
+//
+// --------------------------------------------------------------------------
+
+gboolean package_epub( zip_writer *zip, doc_traversal *traversal, const export_options *options,
+                       gboolean title, gint first, gint last )
+{
+  output_writer *writer;
+  gchar *name;
+
+  g_info( "package.c / package_epub");
+  // The notes are left out of every file but their own
+  export_options chapter_options = *options;
+  chapter_options.notes = FALSE;
+  gboolean notes = ( options->notes == TRUE ) && ( traversal->notes->len > 0 );
+  zip_stored( zip, PACKAGE_MIMETYPE_NAME, PACKAGE_EPUB_MIMETYPE, strlen( PACKAGE_EPUB_MIMETYPE ) );
+  gboolean written = package_fixed( zip, PACKAGE_EPUB_CONTAINER, package_epub_container );
+  if( title == TRUE )
+  {
+    writer = package_open( zip, PACKAGE_EPUB_DIRECTORY PACKAGE_EPUB_TITLE );
+    if( writer != NULL )
+    {
+      export_chapters( traversal, &chapter_options, TRUE, first, first, writer );
+    }
+    written = package_close( writer ) && written;
+  }
+  for( gint ch=first; ( ch<last ) && ( written == TRUE ); ch++ )
+  {
+    name = g_strdup_printf( PACKAGE_EPUB_DIRECTORY PACKAGE_EPUB_CHAPTER, ch );
+    writer = package_open( zip, name );
+    g_free( name );
+    if( writer != NULL )
+    {
+      export_chapters( traversal, &chapter_options, FALSE, ch, ch + 1, writer );
+    }
+    written = package_close( writer );
+  }
+  if( ( notes == TRUE ) && ( written == TRUE ) )
+  {
+    writer = package_open( zip, PACKAGE_EPUB_DIRECTORY PACKAGE_EPUB_NOTES );
+    if( writer != NULL )
+    {
+      export_chapters( traversal, options, FALSE, first, first, writer );
+    }
+    written = package_close( writer );
+  }
+  written = written && package_epub_opf( zip, traversal, title, notes, first, last ) &&
+            package_epub_nav( zip, traversal, title, notes, first, last );
+  g_info( "package.c / ~package_epub");
+  return written;
+}
+
+// --------------------------------------------------------------------------
+// package_epub_opf
+//
+// Writes the package document, with the metadata and the list of files in
+// reading order
+//
+// --------------------------------------------------------------------------
+
+gboolean package_epub_opf( zip_writer *zip, doc_traversal *traversal, gboolean title, gboolean notes,
+                           gint first, gint last )
+{
+  output_writer *writer = package_open( zip, PACKAGE_EPUB_OPF );
+
+  if( writer == NULL )
+  {
+    return FALSE;
+  }
+  gchar *identifier = g_uuid_string_random();
+  gchar *language = package_language();
+  GDateTime *now = g_date_time_new_now_utc();
+  gchar *modified = g_date_time_format( now, "%Y-%m-%dT%H:%M:%SZ" );
+  writer_printf( writer, "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+                 "<package xmlns=\"http://www.idpf.org/2007/opf\" version=\"3.0\" unique-identifier=\"book-id\">\n"
+                 "<metadata xmlns:dc=\"http://purl.org/dc/elements/1.1/\">\n"
+                 "<dc:identifier id=\"book-id\">urn:uuid:%s</dc:identifier>\n", identifier );
+  package_xml( writer, "<dc:title>", package_title( traversal ), "</dc:title>\n" );
+  package_xml( writer, "<dc:language>", language, "</dc:language>\n" );
+  writer_printf( writer, "<meta property=\"dcterms:modified\">%s</meta>\n"
+                 "</metadata>\n"
+                 "<manifest>\n"
+                 "<item id=\"nav\" href=\"nav.xhtml\" media-type=\"application/xhtml+xml\" properties=\"nav\"/>\n",
+                 modified );
+  if( title == TRUE )
+  {
+    writer_puts( writer, "<item id=\"title\" href=\"" PACKAGE_EPUB_TITLE "\" media-type=\"application/xhtml+xml\"/>\n" );
+  }
+  for( gint ch=first; ch<last; ch++ )
+  {
+    writer_printf( writer, "<item id=\"chapter-%d\" href=\"" PACKAGE_EPUB_CHAPTER "\" "
+                   "media-type=\"application/xhtml+xml\"/>\n", ch, ch );
+  }
+  if( notes == TRUE )
+  {
+    writer_puts( writer, "<item id=\"notes\" href=\"" PACKAGE_EPUB_NOTES "\" media-type=\"application/xhtml+xml\"/>\n" );
+  }
+  writer_puts( writer, "</manifest>\n<spine>\n" );
+  if( title == TRUE )
+  {
+    writer_puts( writer, "<itemref idref=\"title\"/>\n" );
+  }
+  for( gint ch=first; ch<last; ch++ )
+  {
+    writer_printf( writer, "<itemref idref=\"chapter-%d\"/>\n", ch );
+  }
+  if( notes == TRUE )
+  {
+    writer_puts( writer, "<itemref idref=\"notes\"/>\n" );
+  }
+  writer_puts( writer, "</spine>\n</package>\n" );
+  g_free( modified );
+  g_date_time_unref( now );
+  g_free( language );
+  g_free( identifier );
+  return package_close( writer );
+}
+
+// --------------------------------------------------------------------------
+// package_epub_nav
+//
+// Writes the table of contents, chapters without a title are listed by
+// their number
+//
+// --------------------------------------------------------------------------
+
+gboolean package_epub_nav( zip_writer *zip, doc_traversal *traversal, gboolean title, gboolean notes,
+                           gint first, gint last )
+{
+  output_writer *writer = package_open( zip, PACKAGE_EPUB_NAV );
+
+  if( writer == NULL )
+  {
+    return FALSE;
+  }
+  writer_puts( writer, "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n<!DOCTYPE html>\n"
+               "<html xmlns=\"http://www.w3.org/1999/xhtml\" xmlns:epub=\"http://www.idpf.org/2007/ops\">\n"
+               "<head>\n<meta charset=\"utf-8\"/>\n" );
+  package_xml( writer, "<title>", package_title( traversal ), "</title>\n" );
+  writer_puts( writer, "</head>\n<body>\n<nav epub:type=\"toc\" id=\"toc\">\n<ol>\n" );
+  if( title == TRUE )
+  {
+    package_xml( writer, "<li><a href=\"" PACKAGE_EPUB_TITLE "\">", package_title( traversal ), "</a></li>\n" );
+  }
+  for( gint ch=first; ch<last; ch++ )
+  {
+    writer_printf( writer, "<li><a href=\"" PACKAGE_EPUB_CHAPTER "\">", ch );
+    if( traversal->titles[ ch ].length > 0 )
+    {
+      package_xml( writer, "", traversal->titles[ ch ].text, "" );
+    }
+    else
+    {
+      writer_printf( writer, "%d", ch );
+    }
+    writer_puts( writer, "</a></li>\n" );
+  }
+  if( notes == TRUE )
+  {
+    writer_puts( writer, "<li><a href=\"" PACKAGE_EPUB_NOTES "\">" OUTLINE_APPENDIX_TITLE "</a></li>\n" );
+  }
+  writer_puts( writer, "</ol>\n</nav>\n</body>\n</html>\n" );
+  return package_close( writer );
+}
+
+// --------------------------------------------------------------------------
+// package_odt
+//
+// Writes an OpenDocument text file, all of the chapters are streamed into
+// content.xml with the chapters as level 1 headings and the sections as
+// level 2
+//
+// --------------------------------------------------------------------------
+
+gboolean package_odt( zip_writer *zip, doc_traversal *traversal, const export_options *options,
+                      gboolean title, gint first, gint last )
+{
+  g_info( "package.c / package_odt");
+  zip_stored( zip, PACKAGE_MIMETYPE_NAME, PACKAGE_ODT_MIMETYPE, strlen( PACKAGE_ODT_MIMETYPE ) );
+  gboolean written = package_fixed( zip, PACKAGE_ODT_MANIFEST, package_odt_manifest ) &&
+                     package_fixed( zip, PACKAGE_ODT_STYLES, package_odt_styles ) &&
+                     package_odt_meta( zip, traversal );
+  if( written == TRUE )
+  {
+    output_writer *writer = package_open( zip, PACKAGE_ODT_CONTENT );
+    if( writer != NULL )
+    {
+      export_chapters( traversal, options, title, first, last, writer );
+    }
+    written = package_close( writer );
+  }
+  g_info( "package.c / ~package_odt");
+  return written;
+}
+
+// --------------------------------------------------------------------------
+// package_odt_meta
+//
+// Writes the document metadata with the title from cell 0,0
+//
+// --------------------------------------------------------------------------
+
+gboolean package_odt_meta( zip_writer *zip, doc_traversal *traversal )
+{
+  output_writer *writer = package_open( zip, PACKAGE_ODT_META );
+
+  if( writer == NULL )
+  {
+    return FALSE;
+  }
+  writer_puts( writer, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+               "<office:document-meta xmlns:office=\"urn:oasis:names:tc:opendocument:xmlns:office:1.0\" "
+               "xmlns:meta=\"urn:oasis:names:tc:opendocument:xmlns:meta:1.0\" "
+               "xmlns:dc=\"http://purl.org/dc/elements/1.1/\" office:version=\"1.2\">\n"
+               "<office:meta>\n<meta:generator>" APP_NAME "</meta:generator>\n" );
+  package_xml( writer, "<dc:title>", package_title( traversal ), "</dc:title>\n" );
+  writer_puts( writer, "</office:meta>\n</office:document-meta>\n" );
+  return package_close( writer );
+}
+
+// --------------------------------------------------------------------------
+// package_fixed
+//
+// Adds a file with contents that don't depend on the document
+//
+// --------------------------------------------------------------------------
+
+gboolean package_fixed( zip_writer *zip, const gchar *name, const gchar *contents )
+{
+  output_writer *writer = package_open( zip, name );
+
+  if( writer != NULL )
+  {
+    writer_puts( writer, contents );
+  }
+  return package_close( writer );
+}
+
+// --------------------------------------------------------------------------
+// package_open
+//
+// Starts a compressed file in the package and returns a writer for it, or
+// NULL if it couldn't be started
+//
+// --------------------------------------------------------------------------
+
+output_writer *package_open( zip_writer *zip, const gchar *name )
+{
+  FILE *stream = zip_open_entry( zip, name );
+
+  return( ( stream != NULL ) ? writer_new( stream ) : NULL );
+}
+
+// --------------------------------------------------------------------------
+// package_close
+//
+// Flushes and frees a writer from package_open, which ends the file in the
+// package. Returns FALSE if any of it couldn't be written
+//
+// --------------------------------------------------------------------------
+
+gboolean package_close( output_writer *writer )
+{
+  if( writer == NULL )
+  {
+    return FALSE;
+  }
+  FILE *stream = writer->file;
+  gboolean written = writer_free( writer );
+  return( ( fclose( stream ) == 0 ) && written );
+}
+
+// --------------------------------------------------------------------------
+// package_title
+//
+// The title of the whole work for the metadata, which can't be empty
+//
+// --------------------------------------------------------------------------
+
+const gchar *package_title( doc_traversal *traversal )
+{
+  return( ( traversal->titles[0].length > 0 ) ? traversal->titles[0].text : PACKAGE_UNTITLED );
+}
+
+// --------------------------------------------------------------------------
+// package_xml
+//
+// Writes text made safe for XML between fixed markup
+//
+// --------------------------------------------------------------------------
+
+void package_xml( output_writer *writer, const gchar *before, const gchar *text, const gchar *after )
+{
+  writer_puts( writer, before );
+  template_write( writer, ESCAPE_XML, text, strlen( text ) );
+  writer_puts( writer, after );
+}
+
+// --------------------------------------------------------------------------
+// package_language
+//
+// The language of the user's locale as a language tag, e.g. en_GB.UTF-8
+// becomes en-GB
+//
+// --------------------------------------------------------------------------
+
+gchar *package_language( void )
+{
+  const gchar *locale = g_get_language_names()[0];
+  if( ( strcmp( locale, "C" ) == 0 ) || ( strncmp( locale, "C.", 2 ) == 0 ) || ( strcmp( locale, "POSIX" ) == 0 ) )
+  {
+    return g_strdup( PACKAGE_DEFAULT_LANGUAGE );
+  }
+  gchar *language = g_strndup( locale, strcspn( locale, ".@" ) );
+  g_strdelimit( language, "_", '-' );
+  return language;
+}
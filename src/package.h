@@ -0,0 +1,67 @@
+// package.h - header file for package.c
+//             part of the mapter program
+// Copyright (C) 2020 John Davies
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef PACKAGE_H
+#define PACKAGE_H
+
+// The first file of the archive, stored so it can be read at a fixed place
+#define PACKAGE_MIMETYPE_NAME "mimetype"
+#define PACKAGE_EPUB_MIMETYPE "application/epub+zip"
+#define PACKAGE_ODT_MIMETYPE "application/vnd.oasis.opendocument.text"
+
+// Names of the files in an EPUB
+#define PACKAGE_EPUB_CONTAINER "META-INF/container.xml"
+#define PACKAGE_EPUB_OPF "OEBPS/content.opf"
+#define PACKAGE_EPUB_NAV "OEBPS/nav.xhtml"
+#define PACKAGE_EPUB_TITLE "title.xhtml"
+#define PACKAGE_EPUB_CHAPTER "chapter-%d.xhtml"
+#define PACKAGE_EPUB_NOTES "notes.xhtml"
+#define PACKAGE_EPUB_DIRECTORY "OEBPS/"
+
+// Names of the files in an ODT
+#define PACKAGE_ODT_MANIFEST "META-INF/manifest.xml"
+#define PACKAGE_ODT_CONTENT "content.xml"
+#define PACKAGE_ODT_STYLES "styles.xml"
+#define PACKAGE_ODT_META "meta.xml"
+
+// EPUB needs a title and a language in its metadata
+#define PACKAGE_UNTITLED "Untitled"
+#define PACKAGE_DEFAULT_LANGUAGE "en"
+
+// A format that's a package, with the template each chapter is written with
+typedef struct {
+  const gchar *name;
+  export_package package;
+  const gchar *data;
+} package_builtin;
+
+export_package package_lookup( const gchar * );
+result_return package_template( export_package, export_template ** );
+result_return package_write( const gchar *, doc_traversal *, const export_options *, gboolean, gint, gint );
+gboolean package_epub( zip_writer *, doc_traversal *, const export_options *, gboolean, gint, gint );
+gboolean package_epub_opf( zip_writer *, doc_traversal *, gboolean, gboolean, gint, gint );
+gboolean package_epub_nav( zip_writer *, doc_traversal *, gboolean, gboolean, gint, gint );
+gboolean package_odt( zip_writer *, doc_traversal *, const export_options *, gboolean, gint, gint );
+gboolean package_odt_meta( zip_writer *, doc_traversal * );
+gboolean package_fixed( zip_writer *, const gchar *, const gchar * );
+output_writer *package_open( zip_writer *, const gchar * );
+gboolean package_close( output_writer * );
+const gchar *package_title( doc_traversal * );
+void package_xml( output_writer *, const gchar *, const gchar *, const gchar * );
+gchar *package_language( void );
+
+#endif
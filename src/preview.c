@@ -0,0 +1,318 @@
+// preview.c - live preview of the export
+//             part of the mapter program
+// Copyright (C) 2020 John Davies
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gtk/gtk.h>
+#include "main.h"
+#include "doc.h"
+#include "list.h"
+#include "writer.h"
+#include "template.h"
+#include "export.h"
+#include "preview.h"
+
+// The preview is made up of the same pieces as an incremental export, the
+// opening, each chapter and the closing. This is the character offset in
+// the buffer where each piece starts, plus the end of the last one, so a
+// changed chapter can be replaced on its own
+GArray *preview_offsets = NULL;
+// Change count of the document when the preview was last brought up to
+// date, any cell changed since then is in a chapter that needs replacing
+guint preview_changes = 0;
+// Set when all of the preview has to be made again, e.g. for a new document
+gboolean preview_invalid = TRUE;
+// What the preview was made with
+export_options preview_options = EXPORT_DEFAULT_OPTIONS;
+// Timer for the next update, 0 if there isn't one due
+guint preview_timer = 0;
+
+// --------------------------------------------------------------------------
+// on_notebook1_switch_page
+//
+// Brings the preview up to date when its tab is chosen, it isn't kept up
+// to date while it can't be seen
+//
+// --------------------------------------------------------------------------
+
+void on_notebook1_switch_page( GtkNotebook *notebook, GtkWidget *page, guint page_num, app_widgets *app_wdgts )
+{
+  if( page == app_wdgts->w_preview_box )
+  {
+    preview_refresh( app_wdgts );
+  }
+}
+
+// --------------------------------------------------------------------------
+// on_cmb_preview_format_changed
+//
+// Shows the preview in another format
+//
+// --------------------------------------------------------------------------
+
+void on_cmb_preview_format_changed( GtkComboBox *combo, app_widgets *app_wdgts )
+{
+  g_info( "preview.c / on_cmb_preview_format_changed");
+  preview_invalid = TRUE;
+  preview_refresh( app_wdgts );
+  g_info( "preview.c / ~on_cmb_preview_format_changed");
+}
+
+// --------------------------------------------------------------------------
+// preview_invalidate
+//
+// Makes the whole preview again the next time it's updated, called when
+// the document is replaced
+//
+// --------------------------------------------------------------------------
+
+void preview_invalidate( void )
+{
+  preview_invalid = TRUE;
+}
+
+// --------------------------------------------------------------------------
+// preview_schedule
+//
+// Starts the timer to update the preview if it isn't already running
+//
+// --------------------------------------------------------------------------
+
+void preview_schedule( app_widgets *app_wdgts )
+{
+  if( preview_timer == 0 )
+  {
+    preview_timer = g_timeout_add( PREVIEW_DELAY, preview_timeout, app_wdgts );
+  }
+}
+
+// --------------------------------------------------------------------------
+// preview_timeout
+//
+// Updates the preview if it can be seen
+//
+// --------------------------------------------------------------------------
+
+gboolean preview_timeout( gpointer data )
+{
+  app_widgets *app_wdgts = (app_widgets *) data;
+
+  preview_timer = 0;
+  if( gtk_widget_get_mapped( app_wdgts->w_preview_textview ) == TRUE )
+  {
+    preview_refresh( app_wdgts );
+  }
+  return G_SOURCE_REMOVE;
+}
+
+// --------------------------------------------------------------------------
+// preview_refresh
+//
+// Brings the preview up to date with the document, only the chapters
+// with cells that have changed are exported again. A change to the title,
+// the series names, the rows or columns or the export options means the
+// whole preview is made again
+//
+// --------------------------------------------------------------------------
+
+void preview_refresh( app_widgets *app_wdgts )
+{
+  doc_traversal traversal;
+  gint replaced = 0;
+
+  g_info( "preview.c / preview_refresh");
+  mapter_doc *doc = list_get_document();
+  if( doc == NULL )
+  {
+    g_info( "preview.c / ~preview_refresh");
+    return;
+  }
+  if( preview_offsets == NULL )
+  {
+    preview_offsets = g_array_new( FALSE, FALSE, sizeof( gint ) );
+  }
+  // The same options as the export dialog
+  gboolean title = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON( app_wdgts->b_chkbtn_export_title ) );
+  gboolean dup_cr = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON( app_wdgts->b_chkbtn_export_dup_cr ) );
+  gboolean add_series = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON( app_wdgts->b_chkbtn_export_series ) );
+  doc_order order = ( gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON( app_wdgts->b_chkbtn_export_columns ) ) == TRUE ) ?
+                    COLUMNS_AS_CHAPTERS : ROWS_AS_CHAPTERS;
+  if( ( title != preview_options.title ) || ( dup_cr != preview_options.dup_cr ) ||
+      ( add_series != preview_options.add_series ) || ( order != preview_options.order ) )
+  {
+    preview_invalid = TRUE;
+  }
+  doc_traverse( doc, order, &traversal );
+  if( ( doc->structure_changed > preview_changes ) ||
+      ( preview_offsets->len != (guint) traversal.chapters + 2 ) ||
+      ( preview_chapter_changed( &traversal, 0, preview_changes ) == TRUE ) )
+  {
+    preview_invalid = TRUE;
+  }
+
+  GtkTextBuffer *buffer = gtk_text_view_get_buffer( GTK_TEXT_VIEW( app_wdgts->w_preview_textview ) );
+  if( preview_invalid == TRUE )
+  {
+    template_free( preview_options.template );
+    preview_options.title = title;
+    preview_options.dup_cr = dup_cr;
+    preview_options.add_series = add_series;
+    preview_options.order = order;
+    // The built in formats always compile
+    export_format( gtk_combo_box_get_active_id( GTK_COMBO_BOX( app_wdgts->w_cmb_preview_format ) ),
+                   &preview_options );
+    preview_rebuild( buffer, &traversal );
+  }
+  else
+  {
+    for( gint ch=1; ch<traversal.chapters; ch++ )
+    {
+      if( preview_chapter_changed( &traversal, ch, preview_changes ) == TRUE )
+      {
+        preview_patch( buffer, &traversal, ch );
+        replaced++;
+      }
+    }
+  }
+  g_info( "  Rebuilt: %s, chapters replaced: %d", btoa( preview_invalid ), replaced );
+  preview_changes = doc->changes;
+  preview_invalid = FALSE;
+  doc_traversal_clear( &traversal );
+  g_info( "preview.c / ~preview_refresh");
+}
+
+// --------------------------------------------------------------------------
+// preview_rebuild
+//
+// Replaces all of the preview
+//
+// --------------------------------------------------------------------------
+
+void preview_rebuild( GtkTextBuffer *buffer, doc_traversal *traversal )
+{
+  gsize length;
+
+  g_array_set_size( preview_offsets, 0 );
+  gchar *text = preview_render( traversal, 0, traversal->chapters + 1, preview_offsets, &length );
+  gtk_text_buffer_set_text( buffer, ( text != NULL ) ? text : "", length );
+  free( text );
+}
+
+// --------------------------------------------------------------------------
+// preview_patch
+//
+// Exports a chapter again and puts it in place of the old one in the
+// preview, the pieces after it move up or down by the change in length
+//
+// --------------------------------------------------------------------------
+
+void preview_patch( GtkTextBuffer *buffer, doc_traversal *traversal, gint chapter )
+{
+  GtkTextIter start;
+  GtkTextIter end;
+  gsize length;
+
+  gint *offsets = (gint *) preview_offsets->data;
+  gchar *text = preview_render( traversal, chapter, chapter + 1, NULL, &length );
+  if( text == NULL )
+  {
+    return;
+  }
+  gtk_text_buffer_get_iter_at_offset( buffer, &start, offsets[ chapter ] );
+  gtk_text_buffer_get_iter_at_offset( buffer, &end, offsets[ chapter + 1 ] );
+  gtk_text_buffer_delete( buffer, &start, &end );
+  gtk_text_buffer_insert( buffer, &start, text, length );
+  gint shift = g_utf8_strlen( text, length ) - ( offsets[ chapter + 1 ] - offsets[ chapter ] );
+  for( guint i=chapter+1; i<preview_offsets->len; i++ )
+  {
+    offsets[i] += shift;
+  }
+  free( text );
+}
+
+// --------------------------------------------------------------------------
+// preview_render
+//
+// Exports the pieces from first up to but not including last to memory,
+// the text is freed with free(). If offsets isn't NULL the character
+// offset of the start of each piece and of the end is added to it
+//
+// --------------------------------------------------------------------------
+
+gchar *preview_render( doc_traversal *traversal, gint first, gint last, GArray *offsets, gsize *length )
+{
+  gchar *text = NULL;
+  GArray *starts = g_array_new( FALSE, FALSE, sizeof( guint64 ) );
+
+  *length = 0;
+  FILE *stream = open_memstream( &text, length );
+  if( stream == NULL )
+  {
+    g_info( "  ERROR - could not open the preview stream");
+    g_array_free( starts, TRUE );
+    return NULL;
+  }
+  output_writer *writer = writer_new( stream );
+  for( gint piece=first; piece<last; piece++ )
+  {
+    guint64 start = writer_position( writer );
+    g_array_append_val( starts, start );
+    export_piece( traversal, &preview_options, piece, writer );
+  }
+  guint64 end = writer_position( writer );
+  g_array_append_val( starts, end );
+  writer_free( writer );
+  fclose( stream );
+
+  // The buffer counts in characters rather than bytes
+  if( offsets != NULL )
+  {
+    gint offset = 0;
+    for( guint i=0; i<starts->len; i++ )
+    {
+      g_array_append_val( offsets, offset );
+      if( i + 1 < starts->len )
+      {
+        guint64 piece_start = g_array_index( starts, guint64, i );
+        offset += g_utf8_strlen( text + piece_start, g_array_index( starts, guint64, i + 1 ) - piece_start );
+      }
+    }
+  }
+  g_array_free( starts, TRUE );
+  return text;
+}
+
+// --------------------------------------------------------------------------
+// preview_chapter_changed
+//
+// Checks if any cell of a chapter, including its header, has changed
+// since the specified change count
+//
+// --------------------------------------------------------------------------
+
+gboolean preview_chapter_changed( doc_traversal *traversal, gint chapter, guint since )
+{
+  for( gint s=0; s<traversal->sections; s++ )
+  {
+    if( doc_traversal_cell( traversal, chapter, s )->changed > since )
+    {
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
@@ -0,0 +1,36 @@
+// preview.h - header file for preview.c
+//             part of the mapter program
+// Copyright (C) 2020 John Davies
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef PREVIEW_H
+#define PREVIEW_H
+
+// Milliseconds after a change before the preview is brought up to date,
+// so a burst of changes only updates it once
+#define PREVIEW_DELAY 300
+
+void on_notebook1_switch_page( GtkNotebook *, GtkWidget *, guint, app_widgets * );
+void on_cmb_preview_format_changed( GtkComboBox *, app_widgets * );
+void preview_invalidate( void );
+void preview_schedule( app_widgets * );
+gboolean preview_timeout( gpointer );
+void preview_refresh( app_widgets * );
+void preview_rebuild( GtkTextBuffer *, doc_traversal * );
+void preview_patch( GtkTextBuffer *, doc_traversal *, gint );
+gchar *preview_render( doc_traversal *, gint, gint, GArray *, gsize * );
+gboolean preview_chapter_changed( doc_traversal *, gint, guint );
+
+#endif
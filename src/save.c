@@ -0,0 +1,440 @@
+// save.c - crash safe saving of files
+//          part of the mapter program
+// Copyright (C) 2020 John Davies
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// A file is never written in place. The new contents go to a temporary
+// file alongside it which is flushed to disk and then renamed over the
+// original, so at any point either the old or the new file is complete.
+// Nothing here touches the widgets so a save can be run from any thread
+
+// Needed for copy_file_range
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#endif
+#include <gtk/gtk.h>
+#include "main.h"
+#include "compress.h"
+#include "save.h"
+
+// --------------------------------------------------------------------------
+// save_begin
+//
+// Creates the temporary file for saving to the specified file and opens
+// a stream on it, compressing the contents if required
+//
+// --------------------------------------------------------------------------
+
+result_return save_begin( const gchar *file_path, gboolean compress, save_target **target )
+{
+  result_return save_result = { TRUE, "" };
+  struct stat original;
+
+  g_info( "save.c / save_begin");
+  save_target *save = g_new0( save_target, 1 );
+  save->fd = -1;
+  // Replace the file that a link points to rather than the link itself
+  save->file_path = realpath( file_path, NULL );
+  if( save->file_path == NULL )
+  {
+    save->file_path = g_strdup( file_path );
+  }
+  gchar *directory = g_path_get_dirname( save->file_path );
+  gchar *name = g_path_get_basename( save->file_path );
+  gchar *temp_name = g_strconcat( SAVE_TEMP_PREFIX, name, SAVE_TEMP_SUFFIX, NULL );
+  save->temp_path = g_build_filename( directory, temp_name, NULL );
+  g_free( temp_name );
+  g_free( name );
+  g_free( directory );
+
+  save->fd = g_mkstemp_full( save->temp_path, O_RDWR, SAVE_FILE_MODE );
+  if( save->fd == -1 )
+  {
+    g_info( "  ERROR: Could not create: %s", save->temp_path );
+    save_result.result = FALSE;
+    save_result.message = "Could not open file for writing";
+    goto error_exit;
+  }
+  // Keep the permissions of the file being replaced
+  if( stat( save->file_path, &original ) == 0 )
+  {
+    fchmod( save->fd, original.st_mode & 07777 );
+  }
+
+  // The stream has its own descriptor so the file can still be synced
+  // after the stream is closed
+  gint stream_fd = dup( save->fd );
+  if( ( stream_fd != -1 ) && ( compress == TRUE ) )
+  {
+    save->file = compress_open_write( stream_fd );
+  }
+  else if( stream_fd != -1 )
+  {
+    save->file = fdopen( stream_fd, "w" );
+    if( save->file == NULL )
+    {
+      close( stream_fd );
+    }
+  }
+  if( save->file == NULL )
+  {
+    g_info( "  ERROR: Could not open stream on: %s", save->temp_path );
+    save_result.result = FALSE;
+    save_result.message = "Could not open file for writing";
+    goto error_exit;
+  }
+  g_info( "  Saving %s via %s", save->file_path, save->temp_path );
+  *target = save;
+  g_info( "save.c / ~save_begin");
+  return save_result;
+
+error_exit:
+  save_abort( save );
+  *target = NULL;
+  g_info( "save.c / ~save_begin");
+  return save_result;
+}
+
+// --------------------------------------------------------------------------
+// save_finish
+//
+// Completes the writing of the temporary file, makes sure that it's on
+// the disk and then replaces the original file with it
+// The previous version of the file is kept as a backup if required
+// The target is freed whatever the result
+//
+// --------------------------------------------------------------------------
+
+result_return save_finish( save_target *save, gint backups )
+{
+  result_return save_result = { TRUE, "" };
+
+  g_info( "save.c / save_finish");
+  // Any final write errors show up when the stream is closed
+  gint close_status = fclose( save->file );
+  save->file = NULL;
+  if( close_status != 0 )
+  {
+    g_info( "  ERROR: Could not finish writing: %s", save->temp_path );
+    save_result.result = FALSE;
+    save_result.message = "Could not finish writing file";
+    goto error_exit;
+  }
+  if( fsync( save->fd ) != 0 )
+  {
+    g_info( "  ERROR: Could not sync: %s", save->temp_path );
+    save_result.result = FALSE;
+    save_result.message = "Could not write file to disk";
+    goto error_exit;
+  }
+  close( save->fd );
+  save->fd = -1;
+
+  // A missing backup shouldn't stop the new version being saved
+  if( ( backups > 0 ) && ( g_file_test( save->file_path, G_FILE_TEST_EXISTS ) == TRUE ) &&
+      ( save_backup( save->file_path, backups ) == FALSE ) )
+  {
+    g_info( "  WARNING: Could not make backup of: %s", save->file_path );
+  }
+
+  if( rename( save->temp_path, save->file_path ) != 0 )
+  {
+    g_info( "  ERROR: Could not rename %s to %s", save->temp_path, save->file_path );
+    save_result.result = FALSE;
+    save_result.message = "Could not replace the existing file";
+    goto error_exit;
+  }
+  save_sync_directory( save->file_path );
+  save_target_free( save );
+  g_info( "save.c / ~save_finish");
+  return save_result;
+
+error_exit:
+  save_abort( save );
+  g_info( "save.c / ~save_finish");
+  return save_result;
+}
+
+// --------------------------------------------------------------------------
+// save_abort
+//
+// Abandons a save, the original file is left untouched
+//
+// --------------------------------------------------------------------------
+
+void save_abort( save_target *save )
+{
+  g_info( "save.c / save_abort");
+  if( save->file != NULL )
+  {
+    fclose( save->file );
+    save->file = NULL;
+  }
+  if( save->fd != -1 )
+  {
+    close( save->fd );
+    unlink( save->temp_path );
+    save->fd = -1;
+  }
+  else if( g_file_test( save->temp_path, G_FILE_TEST_EXISTS ) == TRUE )
+  {
+    unlink( save->temp_path );
+  }
+  save_target_free( save );
+  g_info( "save.c / ~save_abort");
+}
+
+// --------------------------------------------------------------------------
+// save_target_free
+//
+// Frees the memory used by a save target
+//
+// --------------------------------------------------------------------------
+
+void save_target_free( save_target *save )
+{
+  g_free( save->file_path );
+  g_free( save->temp_path );
+  g_free( save );
+}
+
+// --------------------------------------------------------------------------
+// save_backup
+//
+// Keeps the current version of a file that's about to be replaced, the
+// existing backups move down one place and the oldest is dropped
+// A hard link is used where possible as that costs nothing, the old
+// contents stay with the link when the new file is renamed into place
+//
+// --------------------------------------------------------------------------
+
+gboolean save_backup( const gchar *file_path, gint backups )
+{
+  gboolean result = TRUE;
+  g_info( "save.c / save_backup");
+  save_rotate_backups( file_path, backups );
+  gchar *backup_path = save_backup_path( file_path, 1 );
+  unlink( backup_path );
+  if( link( file_path, backup_path ) != 0 )
+  {
+    // Not supported by the file system so copy it
+    result = save_copy_file( file_path, backup_path );
+  }
+  g_info( "  Backup: %s - %s", backup_path, btoa( result ) );
+  g_free( backup_path );
+  g_info( "save.c / ~save_backup");
+  return result;
+}
+
+// --------------------------------------------------------------------------
+// save_backup_path
+//
+// Returns the name of a backup, 1 is the newest
+//
+// --------------------------------------------------------------------------
+
+gchar *save_backup_path( const gchar *file_path, gint number )
+{
+  if( number == 1 )
+  {
+    return g_strconcat( file_path, SAVE_BACKUP_SUFFIX, NULL );
+  }
+  return g_strdup_printf( "%s%s%d", file_path, SAVE_BACKUP_SUFFIX, number );
+}
+
+// --------------------------------------------------------------------------
+// save_rotate_backups
+//
+// Makes room for a new backup by renaming each existing one to the next
+// number up. Only the names change so this is cheap however large the
+// file is. Anything past the number being kept is removed, which also
+// tidies up if fewer are kept than before
+//
+// --------------------------------------------------------------------------
+
+void save_rotate_backups( const gchar *file_path, gint backups )
+{
+  g_info( "save.c / save_rotate_backups");
+  gboolean removed = TRUE;
+  for( gint number=backups; removed == TRUE; number++ )
+  {
+    gchar *backup_path = save_backup_path( file_path, number );
+    removed = ( unlink( backup_path ) == 0 );
+    g_free( backup_path );
+  }
+  for( gint number=backups-1; number>0; number-- )
+  {
+    gchar *from_path = save_backup_path( file_path, number );
+    gchar *to_path = save_backup_path( file_path, number + 1 );
+    if( ( rename( from_path, to_path ) != 0 ) && ( errno != ENOENT ) )
+    {
+      g_info( "  WARNING: Could not rename %s to %s", from_path, to_path );
+    }
+    g_free( from_path );
+    g_free( to_path );
+  }
+  g_info( "save.c / ~save_rotate_backups");
+}
+
+// --------------------------------------------------------------------------
+// save_copy_file
+//
+// Copies a file in the cheapest way that the file system allows. A clone
+// shares the blocks of the original, copy_file_range lets the kernel or
+// the file server do the copy, otherwise it's read and written a block
+// at a time so that the whole file is never held in memory
+//
+// --------------------------------------------------------------------------
+
+gboolean save_copy_file( const gchar *from_path, const gchar *to_path )
+{
+  gboolean result = FALSE;
+  struct stat from_stat;
+  gint to_fd = -1;
+
+  g_info( "save.c / save_copy_file");
+  gint from_fd = open( from_path, O_RDONLY );
+  if( ( from_fd == -1 ) || ( fstat( from_fd, &from_stat ) != 0 ) )
+  {
+    goto error_exit;
+  }
+  to_fd = open( to_path, O_WRONLY | O_CREAT | O_TRUNC, from_stat.st_mode & 0777 );
+  if( to_fd == -1 )
+  {
+    goto error_exit;
+  }
+#ifdef FICLONE
+  if( ioctl( to_fd, FICLONE, from_fd ) == 0 )
+  {
+    g_info( "  Cloned" );
+    result = TRUE;
+    goto error_exit;
+  }
+#endif
+#ifdef __linux__
+  off_t remaining = from_stat.st_size;
+  while( remaining > 0 )
+  {
+    ssize_t copied = copy_file_range( from_fd, NULL, to_fd, NULL, remaining, 0 );
+    if( copied <= 0 )
+    {
+      break;
+    }
+    remaining -= copied;
+  }
+  if( remaining == 0 )
+  {
+    g_info( "  Copied in the kernel" );
+    result = TRUE;
+    goto error_exit;
+  }
+  // Start again from the beginning
+  if( ( ftruncate( to_fd, 0 ) != 0 ) || ( lseek( to_fd, 0, SEEK_SET ) != 0 ) ||
+      ( lseek( from_fd, 0, SEEK_SET ) != 0 ) )
+  {
+    goto error_exit;
+  }
+#endif
+  result = save_copy_stream( from_fd, to_fd );
+
+  error_exit: // Destination once the copy is finished or has failed
+  if( to_fd != -1 )
+  {
+    if( close( to_fd ) != 0 )
+    {
+      result = FALSE;
+    }
+    if( result == FALSE )
+    {
+      unlink( to_path );
+    }
+  }
+  if( from_fd != -1 )
+  {
+    close( from_fd );
+  }
+  g_info( "save.c / ~save_copy_file");
+  return result;
+}
+
+// --------------------------------------------------------------------------
+// save_copy_stream
+//
+// Copies everything from one open file to another a block at a time
+//
+// --------------------------------------------------------------------------
+
+gboolean save_copy_stream( gint from_fd, gint to_fd )
+{
+  gchar buffer[ SAVE_COPY_BUFFER_SIZE ];
+  ssize_t length;
+
+  while( ( length = read( from_fd, buffer, sizeof( buffer ) ) ) != 0 )
+  {
+    if( length < 0 )
+    {
+      if( errno == EINTR )
+      {
+        continue;
+      }
+      return FALSE;
+    }
+    for( ssize_t written=0; written<length; )
+    {
+      ssize_t count = write( to_fd, buffer + written, length - written );
+      if( count < 0 )
+      {
+        if( errno == EINTR )
+        {
+          continue;
+        }
+        return FALSE;
+      }
+      written += count;
+    }
+  }
+  return TRUE;
+}
+
+// --------------------------------------------------------------------------
+// save_sync_directory
+//
+// Makes sure that a rename in the directory holding the file is on disk
+//
+// --------------------------------------------------------------------------
+
+gboolean save_sync_directory( const gchar *file_path )
+{
+  gboolean result = FALSE;
+  gchar *directory = g_path_get_dirname( file_path );
+  gint fd = open( directory, O_RDONLY | O_DIRECTORY );
+  if( fd != -1 )
+  {
+    result = ( fsync( fd ) == 0 );
+    close( fd );
+  }
+  g_free( directory );
+  return result;
+}
@@ -0,0 +1,53 @@
+// save.h - header file for save.c
+//          part of the mapter program
+// Copyright (C) 2020 John Davies
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SAVE_H
+#define SAVE_H
+
+#include <stdio.h>
+
+// The temporary file is hidden and in the same directory as the file being
+// saved so that it can be renamed over it
+#define SAVE_TEMP_PREFIX "."
+#define SAVE_TEMP_SUFFIX ".XXXXXX"
+// The newest backup has this added to its name, older ones have a number
+// after it as well, e.g. novel.mapter~, novel.mapter~2, novel.mapter~3
+#define SAVE_BACKUP_SUFFIX "~"
+// Used when a backup has to be copied a block at a time
+#define SAVE_COPY_BUFFER_SIZE 65536
+#define SAVE_FILE_MODE 0666             // Before the umask is applied
+
+// A save in progress
+typedef struct {
+  gchar *file_path;               // File that will be replaced
+  gchar *temp_path;               // File being written
+  gint fd;                        // Open on temp_path until the save is finished
+  FILE *file;                     // Stream that the contents are written to
+} save_target;
+
+result_return save_begin( const gchar *, gboolean, save_target ** );
+result_return save_finish( save_target *, gint );
+void save_abort( save_target * );
+void save_target_free( save_target * );
+gboolean save_backup( const gchar *, gint );
+gchar *save_backup_path( const gchar *, gint );
+void save_rotate_backups( const gchar *, gint );
+gboolean save_copy_file( const gchar *, const gchar * );
+gboolean save_copy_stream( gint, gint );
+gboolean save_sync_directory( const gchar * );
+
+#endif
@@ -0,0 +1,455 @@
+// template.c - templates used to export in other formats
+//              part of the mapter program
+// Copyright (C) 2020 John Davies
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// A template is split into steps when it's loaded so that exporting only
+// has to copy text and write field values, it's never looked at again
+
+#include <stdio.h>
+#include <string.h>
+#include <gtk/gtk.h>
+#include "main.h"
+#include "writer.h"
+#include "template.h"
+
+// Names used in template files, in the same order as the enums
+
+const gchar *template_part_names[ TEMPLATE_PARTS ] = {
+  "begin", "title", "chapter", "section", "series_section", "paragraph", "end"
+};
+const gchar *template_field_names[ TEMPLATE_FIELDS ] = {
+  "title", "chapter", "series", "heading", "text", "row", "column"
+};
+const gchar *template_escape_names[ TEMPLATE_ESCAPES ] = {
+  "none", "markdown", "latex", "html", "xml"
+};
+
+// Characters that are replaced in field values for each format, anything
+// not listed is copied as it is
+
+const gchar *template_markdown_escapes[ 256 ] = {
+  [ '\\' ] = "\\\\", [ '`' ] = "\\`", [ '*' ] = "\\*", [ '_' ] = "\\_",
+  [ '[' ] = "\\[", [ ']' ] = "\\]", [ '<' ] = "\\<", [ '>' ] = "\\>",
+  [ '#' ] = "\\#", [ '|' ] = "\\|", [ '~' ] = "\\~"
+};
+const gchar *template_latex_escapes[ 256 ] = {
+  [ '\\' ] = "\\textbackslash{}", [ '&' ] = "\\&", [ '%' ] = "\\%", [ '$' ] = "\\$",
+  [ '#' ] = "\\#", [ '_' ] = "\\_", [ '{' ] = "\\{", [ '}' ] = "\\}",
+  [ '~' ] = "\\textasciitilde{}", [ '^' ] = "\\textasciicircum{}"
+};
+const gchar *template_html_escapes[ 256 ] = {
+  [ '&' ] = "&amp;", [ '<' ] = "&lt;", [ '>' ] = "&gt;", [ '"' ] = "&quot;", [ '\'' ] = "&#39;"
+};
+// As html, but the control characters XML doesn't allow at all are dropped
+const gchar *template_xml_escapes[ 256 ] = {
+  [ 0x01 ... 0x08 ] = "", [ 0x0b ... 0x0c ] = "", [ 0x0e ... 0x1f ] = "",
+  [ '&' ] = "&amp;", [ '<' ] = "&lt;", [ '>' ] = "&gt;", [ '"' ] = "&quot;", [ '\'' ] = "&#39;"
+};
+const gchar **template_escape_tables[ TEMPLATE_ESCAPES ] = {
+  NULL, template_markdown_escapes, template_latex_escapes, template_html_escapes, template_xml_escapes
+};
+
+// Markdown only treats these as markup at the start of a line, the full
+// stop and bracket only after a number
+const gchar *template_markdown_line_escapes[ 256 ] = {
+  [ '+' ] = "\\+", [ '-' ] = "\\-", [ '=' ] = "\\=", [ '.' ] = "\\.", [ ')' ] = "\\)"
+};
+
+// Built in templates, in the same format as template files
+
+const template_builtin template_builtins[] = {
+  { "markdown",
+    "[" TEMPLATE_GROUP "]\n"
+    "escape=markdown\n"
+    "extension=md\n"
+    "title=# ${title}\\n\\n\n"
+    "chapter=## ${chapter}\\n\\n\n"
+    "section=### ${heading}\\n\\n\n"
+    "series_section=### ${series} - ${heading}\\n\\n\n"
+    "paragraph=${text}\\n\\n\n" },
+  { "latex",
+    "[" TEMPLATE_GROUP "]\n"
+    "escape=latex\n"
+    "extension=tex\n"
+    "begin=\\\\documentclass[a4paper]{book}\\n\\\\usepackage[utf8]{inputenc}\\n"
+    "\\\\usepackage[T1]{fontenc}\\n\\\\setcounter{secnumdepth}{0}\\n\\\\begin{document}\\n\\n\n"
+    "title=\\\\title{${title}}\\n\\\\date{}\\n\\\\maketitle\\n\\\\tableofcontents\\n\\n\n"
+    "chapter=\\\\chapter{${chapter}}\\n\\n\n"
+    "section=\\\\section{${heading}}\\n\\n\n"
+    "series_section=\\\\section{${series} - ${heading}}\\n\\n\n"
+    "paragraph=${text}\\n\\n\n"
+    "end=\\\\end{document}\\n\n" },
+  { "html",
+    "[" TEMPLATE_GROUP "]\n"
+    "escape=html\n"
+    "extension=html\n"
+    "begin=<!DOCTYPE html>\\n<html>\\n<head>\\n<meta charset=\"utf-8\">\\n"
+    "<title>${title}</title>\\n</head>\\n<body>\\n\n"
+    "title=<h1>${title}</h1>\\n\n"
+    "chapter=<h2>${chapter}</h2>\\n\n"
+    "section=<h3>${heading}</h3>\\n\n"
+    "series_section=<h3>${series} - ${heading}</h3>\\n\n"
+    "paragraph=<p>${text}</p>\\n\n"
+    "end=</body>\\n</html>\\n\n" }
+};
+
+// --------------------------------------------------------------------------
+// template_find
+//
+// Compiles the built in template with the specified name
+//
+// --------------------------------------------------------------------------
+
+result_return template_find( const gchar *name, export_template **template_out )
+{
+  g_info( "template.c / template_find");
+  *template_out = NULL;
+  for( gsize i=0; i<G_N_ELEMENTS( template_builtins ); i++ )
+  {
+    if( strcmp( name, template_builtins[i].name ) == 0 )
+    {
+      g_info( "template.c / ~template_find");
+      return template_compile( template_builtins[i].data, strlen( template_builtins[i].data ), template_out );
+    }
+  }
+  g_info( "  ERROR - unknown export format: %s", name );
+  g_info( "template.c / ~template_find");
+  return( (result_return) { FALSE, "Unknown export format" } );
+}
+
+// --------------------------------------------------------------------------
+// template_load
+//
+// Compiles a template file
+//
+// --------------------------------------------------------------------------
+
+result_return template_load( const gchar *file_path, export_template **template_out )
+{
+  gchar *contents;
+  gsize length;
+
+  g_info( "template.c / template_load");
+  *template_out = NULL;
+  if( g_file_get_contents( file_path, &contents, &length, NULL ) == FALSE )
+  {
+    g_info( "  ERROR - could not read: %s", file_path );
+    return( (result_return) { FALSE, "Could not read template file" } );
+  }
+  result_return load_result = template_compile( contents, length, template_out );
+  g_free( contents );
+  g_info( "template.c / ~template_load");
+  return load_result;
+}
+
+// --------------------------------------------------------------------------
+// template_compile
+//
+// Splits each part of a template into the steps needed to write it
+//
+// --------------------------------------------------------------------------
+
+result_return template_compile( const gchar *data, gsize length, export_template **template_out )
+{
+  result_return compile_result = { TRUE, "" };
+  export_template *template = NULL;
+
+  g_info( "template.c / template_compile");
+  *template_out = NULL;
+  GKeyFile *keyfile = g_key_file_new();
+  if( ( g_key_file_load_from_data( keyfile, data, length, G_KEY_FILE_NONE, NULL ) == FALSE ) ||
+      ( g_key_file_has_group( keyfile, TEMPLATE_GROUP ) == FALSE ) )
+  {
+    compile_result.message = "Not a template file";
+    goto error_exit;
+  }
+  template = g_new0( export_template, 1 );
+  gchar *escape = g_key_file_get_string( keyfile, TEMPLATE_GROUP, TEMPLATE_ESCAPE_KEY, NULL );
+  if( escape != NULL )
+  {
+    for( template->escape=0;
+         ( template->escape<TEMPLATE_ESCAPES ) && ( strcmp( escape, template_escape_names[ template->escape ] ) != 0 );
+         template->escape++ )
+    {
+    }
+    g_free( escape );
+    if( template->escape == TEMPLATE_ESCAPES )
+    {
+      compile_result.message = "Unknown escape in template";
+      goto error_exit;
+    }
+  }
+  template->extension = g_key_file_get_string( keyfile, TEMPLATE_GROUP, TEMPLATE_EXTENSION_KEY, NULL );
+  if( template->extension == NULL )
+  {
+    template->extension = g_strdup( TEMPLATE_DEFAULT_EXTENSION );
+  }
+  for( gint part=0; part<TEMPLATE_PARTS; part++ )
+  {
+    // Missing parts aren't written
+    template->source[part] = g_key_file_get_string( keyfile, TEMPLATE_GROUP, template_part_names[part], NULL );
+    if( template->source[part] == NULL )
+    {
+      template->source[part] = g_strdup( "" );
+    }
+    template->steps[part] = g_array_new( FALSE, FALSE, sizeof( template_step ) );
+    compile_result = template_compile_part( template->source[part], template->steps[part] );
+    if( compile_result.result == FALSE )
+    {
+      goto error_exit;
+    }
+  }
+  // The series version of a section defaults to the plain one
+  if( g_key_file_has_key( keyfile, TEMPLATE_GROUP, template_part_names[ TEMPLATE_SERIES_SECTION ], NULL ) == FALSE )
+  {
+    g_array_set_size( template->steps[ TEMPLATE_SERIES_SECTION ], 0 );
+    g_array_append_vals( template->steps[ TEMPLATE_SERIES_SECTION ], template->steps[ TEMPLATE_SECTION ]->data,
+                         template->steps[ TEMPLATE_SECTION ]->len );
+  }
+  *template_out = g_steal_pointer( &template );
+
+  error_exit: // Destination if the template couldn't be used
+  if( *template_out == NULL )
+  {
+    g_info( "  ERROR - %s", compile_result.message );
+    compile_result.result = FALSE;
+    template_free( template );
+  }
+  g_key_file_free( keyfile );
+  g_info( "template.c / ~template_compile");
+  return compile_result;
+}
+
+// --------------------------------------------------------------------------
+// template_compile_part
+//
+// Splits the source of a part into literal text and fields
+//
+// --------------------------------------------------------------------------
+
+result_return template_compile_part( const gchar *source, GArray *steps )
+{
+  template_step step;
+  const gchar *run = source;
+  const gchar *ptr = source;
+
+  while( ( ptr = strchr( ptr, TEMPLATE_FIELD_MARK ) ) != NULL )
+  {
+    if( ptr[1] == TEMPLATE_FIELD_MARK )
+    {
+      // Keep one of the pair
+      step = (template_step) { TEMPLATE_LITERAL, run, ptr + 1 - run };
+      g_array_append_val( steps, step );
+      ptr += 2;
+      run = ptr;
+    }
+    else if( ptr[1] == TEMPLATE_FIELD_START )
+    {
+      const gchar *name = ptr + 2;
+      const gchar *end = strchr( name, TEMPLATE_FIELD_END );
+      if( end == NULL )
+      {
+        return( (result_return) { FALSE, "Unfinished field in template" } );
+      }
+      gint field;
+      for( field=0; field<TEMPLATE_FIELDS; field++ )
+      {
+        if( ( strlen( template_field_names[field] ) == (gsize)( end - name ) ) &&
+            ( strncmp( name, template_field_names[field], end - name ) == 0 ) )
+        {
+          break;
+        }
+      }
+      if( field == TEMPLATE_FIELDS )
+      {
+        return( (result_return) { FALSE, "Unknown field in template" } );
+      }
+      if( ptr > run )
+      {
+        step = (template_step) { TEMPLATE_LITERAL, run, ptr - run };
+        g_array_append_val( steps, step );
+      }
+      step = (template_step) { field, NULL, 0 };
+      g_array_append_val( steps, step );
+      ptr = end + 1;
+      run = ptr;
+    }
+    else
+    {
+      ptr++;
+    }
+  }
+  if( *run != '\0' )
+  {
+    step = (template_step) { TEMPLATE_LITERAL, run, strlen( run ) };
+    g_array_append_val( steps, step );
+  }
+  return( (result_return) { TRUE, "" } );
+}
+
+// --------------------------------------------------------------------------
+// template_free
+//
+// Frees a compiled template
+//
+// --------------------------------------------------------------------------
+
+void template_free( export_template *template )
+{
+  if( template != NULL )
+  {
+    for( gint part=0; part<TEMPLATE_PARTS; part++ )
+    {
+      if( template->steps[part] != NULL )
+      {
+        g_array_free( template->steps[part], TRUE );
+      }
+      g_free( template->source[part] );
+    }
+    g_free( template->extension );
+    g_free( template );
+  }
+}
+
+// --------------------------------------------------------------------------
+// template_set
+//
+// Sets the value of a field
+//
+// --------------------------------------------------------------------------
+
+void template_set( template_values *values, template_field field, const gchar *text, gsize length )
+{
+  values->text[field] = text;
+  values->length[field] = length;
+}
+
+// --------------------------------------------------------------------------
+// template_run
+//
+// Writes a part of the template with the current field values
+//
+// --------------------------------------------------------------------------
+
+void template_run( export_template *template, template_part part, template_values *values, output_writer *writer )
+{
+  GArray *steps = template->steps[part];
+  for( guint i=0; i<steps->len; i++ )
+  {
+    template_step *step = &g_array_index( steps, template_step, i );
+    if( step->field == TEMPLATE_LITERAL )
+    {
+      writer_write( writer, step->text, step->length );
+    }
+    else if( values->text[ step->field ] != NULL )
+    {
+      template_write( writer, template->escape, values->text[ step->field ], values->length[ step->field ] );
+    }
+  }
+}
+
+// --------------------------------------------------------------------------
+// template_write
+//
+// Writes a field value, escaping anything that would be taken as markup
+//
+// --------------------------------------------------------------------------
+
+void template_write( output_writer *writer, template_escape escape, const gchar *text, gsize length )
+{
+  if( escape == ESCAPE_NONE )
+  {
+    writer_write( writer, text, length );
+    return;
+  }
+  if( escape == ESCAPE_MARKDOWN )
+  {
+    template_write_markdown( writer, text, length );
+    return;
+  }
+  template_write_table( writer, template_escape_tables[ escape ], text, length );
+}
+
+// --------------------------------------------------------------------------
+// template_write_table
+//
+// Writes text with each character that has an entry in the table replaced
+// by that entry, runs of characters without one are written in one go
+//
+// --------------------------------------------------------------------------
+
+void template_write_table( output_writer *writer, const gchar **table, const gchar *text, gsize length )
+{
+  const gchar *end = text + length;
+  const gchar *run = text;
+  for( const gchar *ptr=text; ptr<end; ptr++ )
+  {
+    const gchar *replacement = table[ (guchar) *ptr ];
+    if( replacement != NULL )
+    {
+      writer_write( writer, run, ptr - run );
+      writer_puts( writer, replacement );
+      run = ptr + 1;
+    }
+  }
+  writer_write( writer, run, end - run );
+}
+
+// --------------------------------------------------------------------------
+// template_write_markdown
+//
+// As template_write but also escapes the characters that are only markup
+// at the start of a line, e.g. a list item or a numbered list
+//
+// --------------------------------------------------------------------------
+
+void template_write_markdown( output_writer *writer, const gchar *text, gsize length )
+{
+  gboolean line_start = TRUE;
+  gboolean number = FALSE;        // Only digits so far on this line
+  const gchar *end = text + length;
+  const gchar *run = text;
+
+  for( const gchar *ptr=text; ptr<end; ptr++ )
+  {
+    gchar ch = *ptr;
+    const gchar *replacement = template_markdown_escapes[ (guchar) ch ];
+    if( ( line_start == TRUE ) || ( number == TRUE ) )
+    {
+      if( g_ascii_isdigit( ch ) )
+      {
+        number = TRUE;
+      }
+      else
+      {
+        if( ( ( line_start == TRUE ) && ( strchr( "+-=", ch ) != NULL ) ) ||
+            ( ( number == TRUE ) && ( ( ch == '.' ) || ( ch == ')' ) ) ) )
+        {
+          replacement = template_markdown_line_escapes[ (guchar) ch ];
+        }
+        number = FALSE;
+      }
+    }
+    line_start = ( ch == '\n' );
+    if( replacement != NULL )
+    {
+      writer_write( writer, run, ptr - run );
+      writer_puts( writer, replacement );
+      run = ptr + 1;
+    }
+  }
+  writer_write( writer, run, end - run );
+}
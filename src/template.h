@@ -0,0 +1,100 @@
+// template.h - header file for template.c
+//              part of the mapter program
+// Copyright (C) 2020 John Davies
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TEMPLATE_H
+#define TEMPLATE_H
+
+// Template files are key files with all the parts in this group
+#define TEMPLATE_GROUP "template"
+#define TEMPLATE_ESCAPE_KEY "escape"
+// File name extension used when each chapter is exported to its own file
+#define TEMPLATE_EXTENSION_KEY "extension"
+#define TEMPLATE_DEFAULT_EXTENSION "txt"
+
+// Fields are written as ${name}, $$ is a single $
+#define TEMPLATE_FIELD_MARK '$'
+#define TEMPLATE_FIELD_START '{'
+#define TEMPLATE_FIELD_END '}'
+
+// Pieces of an export that a template can fill in, see template_part_names
+typedef enum {
+  TEMPLATE_BEGIN = 0,     // Start of the export
+  TEMPLATE_TITLE,         // Title from cell 0,0
+  TEMPLATE_CHAPTER,       // Each row with a chapter title
+  TEMPLATE_SECTION,       // Each cell with a heading
+  TEMPLATE_SERIES_SECTION,  // As section when the series names are added
+  TEMPLATE_PARAGRAPH,     // Each paragraph of body text
+  TEMPLATE_END,           // End of the export
+  TEMPLATE_PARTS
+} template_part;
+
+// Values that can be put into a part, see template_field_names
+typedef enum {
+  FIELD_TITLE = 0,
+  FIELD_CHAPTER,
+  FIELD_SERIES,
+  FIELD_HEADING,
+  FIELD_TEXT,
+  FIELD_ROW,
+  FIELD_COLUMN,
+  TEMPLATE_FIELDS
+} template_field;
+
+// How field values are made safe for the output format
+typedef enum { ESCAPE_NONE = 0, ESCAPE_MARKDOWN, ESCAPE_LATEX, ESCAPE_HTML, ESCAPE_XML, TEMPLATE_ESCAPES } template_escape;
+
+// A single instruction of a compiled part, either text copied as it is or
+// a field
+#define TEMPLATE_LITERAL -1
+typedef struct {
+  gint field;             // template_field or TEMPLATE_LITERAL
+  const gchar *text;      // Literal text, points into the part source
+  gsize length;
+} template_step;
+
+// A template compiled ready to use
+typedef struct {
+  template_escape escape;
+  gchar *extension;
+  gchar *source[TEMPLATE_PARTS];
+  GArray *steps[TEMPLATE_PARTS];  // template_step entries
+} export_template;
+
+// The current value of each field while exporting
+typedef struct {
+  const gchar *text[TEMPLATE_FIELDS];
+  gsize length[TEMPLATE_FIELDS];
+} template_values;
+
+// A template that's built in
+typedef struct {
+  const gchar *name;
+  const gchar *data;
+} template_builtin;
+
+result_return template_find( const gchar *, export_template ** );
+result_return template_load( const gchar *, export_template ** );
+result_return template_compile( const gchar *, gsize, export_template ** );
+result_return template_compile_part( const gchar *, GArray * );
+void template_free( export_template * );
+void template_set( template_values *, template_field, const gchar *, gsize );
+void template_run( export_template *, template_part, template_values *, output_writer * );
+void template_write( output_writer *, template_escape, const gchar *, gsize );
+void template_write_table( output_writer *, const gchar **, const gchar *, gsize );
+void template_write_markdown( output_writer *, const gchar *, gsize );
+
+#endif
@@ -18,6 +18,15 @@
 #include <gtk/gtk.h>
 #include <gtksourceview/gtksource.h>
 #include "main.h"
+#include "doc.h"
+#include "list.h"
+#include "tree.h"
+
+// The node of each note in the document, in the same order. Tree store
+// iterators stay valid while their node is there, so this is kept until
+// notes are next added or deleted
+
+GArray *tree_note_iters = NULL;
 
 // --------------------------------------------------------------------------
 // on_btn_add_heading_clicked
@@ -55,7 +64,8 @@ void on_btn_add_heading_clicked( GtkWidget *widget, app_widgets *app_wdgts )
     gtk_tree_store_append( app_wdgts->w_notes_treestore, &new, NULL );
   }
   // Insert data
-  gtk_tree_store_set( app_wdgts->w_notes_treestore, &new, 0, "New heading", 1, "New text", -1);
+  gtk_tree_store_set( app_wdgts->w_notes_treestore, &new, 0, "New heading", 1, "New text", TREE_NOTE_COLUMN, -1, -1);
+  list_notes_changed( app_wdgts );
   g_info( "tree.c / ~on_btn_add_heading_clicked");
 }
 
@@ -78,7 +88,8 @@ void on_btn_add_child_clicked( GtkWidget *widget, app_widgets *app_wdgts )
     // Add as a new child of current level
     gtk_tree_store_append( app_wdgts->w_notes_treestore, &new, &iter );
     // Insert data
-    gtk_tree_store_set( app_wdgts->w_notes_treestore, &new, 0, "New heading", 1, "New text", -1);
+    gtk_tree_store_set( app_wdgts->w_notes_treestore, &new, 0, "New heading", 1, "New text", TREE_NOTE_COLUMN, -1, -1);
+    list_notes_changed( app_wdgts );
   }
   else
   {
@@ -110,6 +121,7 @@ void on_btn_delete_heading_clicked( GtkWidget *widget, app_widgets *app_wdgts )
       app_wdgts->current_node_status = FALSE;
       // Remove node
       gtk_tree_store_remove( app_wdgts->w_notes_treestore, &iter );
+      list_notes_changed( app_wdgts );
     }
     else
     {
@@ -135,6 +147,7 @@ void on_notes_tree_section_r_edited( GtkCellRendererText *cell, gchar *path_stri
   g_info( "tree.c / on_notes_tree_section_r_edited");
   gtk_tree_model_get_iter_from_string( GTK_TREE_MODEL( app_wdgts->w_notes_treestore ), &iter, (const gchar *)path_string );
   gtk_tree_store_set( app_wdgts->w_notes_treestore, &iter, 0, new_text, -1 );
+  list_note_changed( tree_note_index( &iter, app_wdgts ), app_wdgts );
   g_info( "  Heading updated: %s", new_text );
   g_info( "tree.c / ~on_notes_tree_section_r_edited");
 
@@ -177,7 +190,7 @@ void on_notes_treestore_selection_changed( GtkWidget *widget, app_widgets *app_w
       gtk_source_buffer_begin_not_undoable_action( GTK_SOURCE_BUFFER( gtk_text_view_get_buffer( GTK_TEXT_VIEW( app_wdgts->w_notes_textview ) ) ) );
       // Copy text to text window
       gtk_tree_model_get( model, &app_wdgts->current_node, 1, &value, -1 );
-      gtk_text_buffer_set_text( gtk_text_view_get_buffer( GTK_TEXT_VIEW( app_wdgts->w_notes_textview ) ), value, -1 );
+      show_notes_text( value, app_wdgts );
       // Restart the undo buffering
       gtk_source_buffer_end_not_undoable_action( GTK_SOURCE_BUFFER( gtk_text_view_get_buffer( GTK_TEXT_VIEW( app_wdgts->w_notes_textview ) ) ) );
       // Validate the current iterator
@@ -187,7 +200,7 @@ void on_notes_treestore_selection_changed( GtkWidget *widget, app_widgets *app_w
     else
     {
       // No nodes left so clear the text view
-      gtk_text_buffer_set_text( gtk_text_view_get_buffer( GTK_TEXT_VIEW( app_wdgts->w_notes_textview ) ), "", -1 );
+      show_notes_text( "", app_wdgts );
     }
   }
 
@@ -195,20 +208,253 @@ void on_notes_treestore_selection_changed( GtkWidget *widget, app_widgets *app_w
 }
 
 // --------------------------------------------------------------------------
-// import_single_header
+// on_notes_text_modified_changed
+//
+// Called when the text of the selected note is first changed, the flag is
+// cleared again so that the next change is also seen. Only the selected
+// note is marked as changed
+//
+// --------------------------------------------------------------------------
+
+void on_notes_text_modified_changed( GtkTextBuffer *buffer, app_widgets *app_wdgts )
+{
+  if( gtk_text_buffer_get_modified( buffer ) == TRUE )
+  {
+    list_note_changed( ( app_wdgts->current_node_status == TRUE ) ?
+                       tree_note_index( &app_wdgts->current_node, app_wdgts ) : -1, app_wdgts );
+    gtk_text_buffer_set_modified( buffer, FALSE );
+  }
+}
+
+// --------------------------------------------------------------------------
+// show_notes_text
+//
+// Shows the text of a note, this doesn't count as a change to the notes
+//
+// --------------------------------------------------------------------------
+
+void show_notes_text( const gchar *text, app_widgets *app_wdgts )
+{
+  GtkTextBuffer *buffer = gtk_text_view_get_buffer( GTK_TEXT_VIEW( app_wdgts->w_notes_textview ) );
+  g_signal_handlers_block_by_func( buffer, on_notes_text_modified_changed, app_wdgts );
+  gtk_text_buffer_set_text( buffer, text, -1 );
+  gtk_text_buffer_set_modified( buffer, FALSE );
+  g_signal_handlers_unblock_by_func( buffer, on_notes_text_modified_changed, app_wdgts );
+}
+
+// --------------------------------------------------------------------------
+// tree_note_index
 //
-// Adds a single top level row to a blank tree
+// Returns where a node's note is in the document, -1 if it hasn't been
+// added to the document yet
 //
 // --------------------------------------------------------------------------
 
-void import_single_header( gchar *text, app_widgets *app_wdgts )
+gint tree_note_index( GtkTreeIter *iter, app_widgets *app_wdgts )
 {
-  // Set up treestore
-  gtk_tree_store_append( app_wdgts->w_notes_treestore, &app_wdgts->current_node, NULL);
-  gtk_tree_store_set( app_wdgts->w_notes_treestore, &app_wdgts->current_node, 0, "Imported Text", 1, text, -1);
-  app_wdgts->current_node_status = TRUE;
-  // Update text view
-  gtk_text_buffer_set_text( gtk_text_view_get_buffer( GTK_TEXT_VIEW( app_wdgts->w_notes_textview ) ),
-                        text,
+  gint index;
+
+  gtk_tree_model_get( GTK_TREE_MODEL( app_wdgts->w_notes_treestore ), iter, TREE_NOTE_COLUMN, &index, -1 );
+  return index;
+}
+
+// --------------------------------------------------------------------------
+// load_tree_notes
+//
+// Replaces the notes tree with the notes held in the document
+//
+// --------------------------------------------------------------------------
+
+void load_tree_notes( mapter_doc *doc, app_widgets *app_wdgts )
+{
+  // Iterators for the last node added at each level of the tree
+  GArray *parents = g_array_new( FALSE, FALSE, sizeof( GtkTreeIter ) );
+  GtkTreeIter iter;
+
+  g_info( "tree.c / load_tree_notes");
+  // Clear the existing tree
+  app_wdgts->stop_node_processing = TRUE;
+  gtk_tree_store_clear( app_wdgts->w_notes_treestore );
+  app_wdgts->stop_node_processing = FALSE;
+  app_wdgts->current_node_status = FALSE;
+  // Clear the text view
+  show_notes_text( "", app_wdgts );
+  tree_note_iters_reset();
+
+  for( guint n=0; n<doc->notes->len; n++ )
+  {
+    doc_note *note = &g_array_index( doc->notes, doc_note, n );
+    // A note can only be one level deeper than the previous one
+    gint level = CLAMP( note->level, 0, (gint)parents->len );
+    // Add as a child of the last node at the level above
+    gtk_tree_store_append( app_wdgts->w_notes_treestore, &iter,
+                           ( level == 0 ) ? NULL : &g_array_index( parents, GtkTreeIter, level - 1 ) );
+    gtk_tree_store_set( app_wdgts->w_notes_treestore, &iter,
+                        0, doc_text_get( &note->heading ),
+                        1, doc_text_get( &note->text ),
+                        TREE_NOTE_COLUMN, (gint) n,
                         -1 );
+    g_array_append_val( tree_note_iters, iter );
+    // This is now the last node at this level
+    g_array_set_size( parents, level );
+    g_array_append_val( parents, iter );
+  }
+  g_array_free( parents, TRUE );
+  g_info( "  %d notes loaded", doc->notes->len );
+  g_info( "tree.c / ~load_tree_notes");
+}
+
+// --------------------------------------------------------------------------
+// capture_tree_notes
+//
+// Copies the notes tree into the document. The notes are left in the
+// document afterwards so nothing is copied again until the notes are next
+// changed, and then only the notes that have been edited are copied
+// unless notes have been added or deleted
+//
+// --------------------------------------------------------------------------
+
+void capture_tree_notes( mapter_doc *doc, app_widgets *app_wdgts )
+{
+  GtkTreeModel *model;
+  GtkTextIter start;
+  GtkTextIter end;
+  guint copied = 0;
+
+  g_info( "tree.c / capture_tree_notes");
+  // Save the currently selected node just in case there are outstanding edits
+  if( gtk_tree_selection_get_selected( GTK_TREE_SELECTION( app_wdgts->w_notes_treestore_selection ), &model, &app_wdgts->current_node ) != FALSE )
+  {
+    // Get the text buffer
+    gtk_text_buffer_get_start_iter( gtk_text_view_get_buffer( GTK_TEXT_VIEW( app_wdgts->w_notes_textview ) ), &start );
+    gtk_text_buffer_get_end_iter( gtk_text_view_get_buffer( GTK_TEXT_VIEW( app_wdgts->w_notes_textview ) ), &end );
+    // Copy text to tree
+    gchar *text = gtk_text_buffer_get_text( gtk_text_view_get_buffer( GTK_TEXT_VIEW( app_wdgts->w_notes_textview ) ), &start, &end, FALSE );
+    gtk_tree_store_set( app_wdgts->w_notes_treestore, &app_wdgts->current_node, 1, text, -1 );
+    g_free( text );
+  }
+  if( doc->notes_captured == doc->notes_changed )
+  {
+    g_info( "  Notes unchanged" );
+    g_info( "tree.c / ~capture_tree_notes");
+    return;
+  }
+  model = GTK_TREE_MODEL( app_wdgts->w_notes_treestore );
+  if( ( doc->notes_structure_changed > doc->notes_captured ) || ( tree_note_iters == NULL ) ||
+      ( tree_note_iters->len != doc->notes->len ) )
+  {
+    capture_tree_walk( model, doc );
+    copied = doc->notes->len;
+  }
+  else
+  {
+    for( guint n=0; n<doc->notes->len; n++ )
+    {
+      doc_note *note = &g_array_index( doc->notes, doc_note, n );
+      if( note->changed > doc->notes_captured )
+      {
+        capture_tree_text( model, &g_array_index( tree_note_iters, GtkTreeIter, n ), note );
+        copied++;
+      }
+    }
+  }
+  doc->notes_captured = doc->notes_changed;
+  g_info( "  %d of %d notes captured", copied, doc->notes->len );
+  g_info( "tree.c / ~capture_tree_notes");
+}
+
+// --------------------------------------------------------------------------
+// capture_tree_walk
+//
+// Replaces the notes in the document with the whole tree, walking it
+// depth first and keeping track of the level on the way
+//
+// --------------------------------------------------------------------------
+
+void capture_tree_walk( GtkTreeModel *model, mapter_doc *doc )
+{
+  GtkTreeIter iter;
+  GtkTreeIter child;
+  gint level = 0;
+
+  doc_clear_notes( doc );
+  tree_note_iters_reset();
+  gboolean more = gtk_tree_model_get_iter_first( model, &iter );
+  while( more == TRUE )
+  {
+    capture_tree_row( model, &iter, level, doc );
+    if( gtk_tree_model_iter_children( model, &child, &iter ) == TRUE )
+    {
+      // Down to the first child
+      iter = child;
+      level++;
+      continue;
+    }
+    // Otherwise on to the next node, backing up a level at a time until
+    // there's one or the whole tree is done. A failed step leaves the
+    // iterator invalid so the parent is found from a copy
+    child = iter;
+    while( ( ( more = gtk_tree_model_iter_next( model, &iter ) ) == FALSE ) && ( level > 0 ) )
+    {
+      gtk_tree_model_iter_parent( model, &iter, &child );
+      child = iter;
+      level--;
+    }
+  }
+}
+
+// --------------------------------------------------------------------------
+// capture_tree_row
+//
+// Copies a single row from the tree onto the end of the notes in the
+// document, the row is given the index of its note
+//
+// --------------------------------------------------------------------------
+
+void capture_tree_row( GtkTreeModel *model, GtkTreeIter *iter, gint level, mapter_doc *doc )
+{
+  doc_note note = { level, { NULL, NULL, 0, FALSE }, { NULL, NULL, 0, FALSE }, doc->notes_changed };
+
+  gtk_tree_store_set( GTK_TREE_STORE( model ), iter, TREE_NOTE_COLUMN, (gint) doc->notes->len, -1 );
+  capture_tree_text( model, iter, &note );
+  g_array_append_val( doc->notes, note );
+  g_array_append_val( tree_note_iters, *iter );
+}
+
+// --------------------------------------------------------------------------
+// capture_tree_text
+//
+// Copies the heading and text of a row into a note. The tree store can
+// only give out copies of its strings, so each one is copied twice, once
+// out of the tree and once into the note
+//
+// --------------------------------------------------------------------------
+
+void capture_tree_text( GtkTreeModel *model, GtkTreeIter *iter, doc_note *note )
+{
+  GValue heading = G_VALUE_INIT;
+  GValue text = G_VALUE_INIT;
+
+  gtk_tree_model_get_value( model, iter, TREE_HEADING_COLUMN, &heading );
+  gtk_tree_model_get_value( model, iter, TREE_TEXT_COLUMN, &text );
+  doc_text_set( &note->heading, g_value_get_string( &heading ) );
+  doc_text_set( &note->text, g_value_get_string( &text ) );
+  g_value_unset( &heading );
+  g_value_unset( &text );
+}
+
+// --------------------------------------------------------------------------
+// tree_note_iters_reset
+//
+// Empties the list of the node of each note, ready to be filled again
+//
+// --------------------------------------------------------------------------
+
+void tree_note_iters_reset( void )
+{
+  if( tree_note_iters == NULL )
+  {
+    tree_note_iters = g_array_new( FALSE, FALSE, sizeof( GtkTreeIter ) );
+  }
+  g_array_set_size( tree_note_iters, 0 );
 }
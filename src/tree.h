@@ -18,11 +18,26 @@
 #ifndef TREE_H
 #define TREE_H
 
+// Columns of the notes tree store, the note column is where the node's
+// note is in the document as of the last time they were matched up, -1
+// for a node added since
+#define TREE_HEADING_COLUMN 0
+#define TREE_TEXT_COLUMN 1
+#define TREE_NOTE_COLUMN 2
+
 void on_btn_add_heading_clicked( GtkWidget *, app_widgets * );
 void on_btn_add_child_clicked( GtkWidget *, app_widgets * );
 void on_btn_delete_heading_clicked( GtkWidget *, app_widgets * );
 void on_notes_tree_section_r_edited( GtkCellRendererText *, gchar *, gchar *, app_widgets * );
 void on_notes_treestore_selection_changed( GtkWidget *, app_widgets * );
-void import_single_header( gchar *, app_widgets * );
+void on_notes_text_modified_changed( GtkTextBuffer *, app_widgets * );
+void show_notes_text( const gchar *, app_widgets * );
+gint tree_note_index( GtkTreeIter *, app_widgets * );
+void load_tree_notes( mapter_doc *, app_widgets * );
+void capture_tree_notes( mapter_doc *, app_widgets * );
+void capture_tree_walk( GtkTreeModel *, mapter_doc * );
+void capture_tree_row( GtkTreeModel *, GtkTreeIter *, gint, mapter_doc * );
+void capture_tree_text( GtkTreeModel *, GtkTreeIter *, doc_note * );
+void tree_note_iters_reset( void );
 
 #endif
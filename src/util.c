@@ -18,6 +18,8 @@
 #include <gtk/gtk.h>
 #include <string.h>
 #include "main.h"
+#include "doc.h"
+#include "list.h"
 #include "util.h"
 
 // --------------------------------------------------------------------------
@@ -58,25 +60,29 @@ void update_file_path( gchar *new_path, app_widgets *app_wdgts )
 // Format is either:
 //     mapter -> for blank filename
 //     <filename> | mapter -> for valid filename
+// with a * in front if there are unsaved changes
 //
 // --------------------------------------------------------------------------
 
 void update_window_title( app_widgets *app_wdgts )
 {
   g_info( "util.c / update_window_title");
+  const gchar *marker = ( doc_is_dirty( list_get_document() ) == TRUE ) ? UNSAVED_MARKER : "";
   if( strlen( app_wdgts->current_file_name ) > 0 )
   {
-    snprintf( app_wdgts->window_title, MAX_WINDOW_TITLE, "%s | %s",
+    snprintf( app_wdgts->window_title, MAX_WINDOW_TITLE, "%s%s | %s",
+              marker,
               app_wdgts->current_file_name,
               app_wdgts->app_name );
-    gtk_window_set_title( GTK_WINDOW( app_wdgts->w_window_main ), app_wdgts->window_title );
-    g_info( "  New window title: %s", app_wdgts->window_title );
   }
   else
   {
-    gtk_window_set_title( GTK_WINDOW( app_wdgts->w_window_main ), app_wdgts->app_name );
-    g_info( "  New window title: %s", app_wdgts->app_name );
+    snprintf( app_wdgts->window_title, MAX_WINDOW_TITLE, "%s%s",
+              marker,
+              app_wdgts->app_name );
   }
+  gtk_window_set_title( GTK_WINDOW( app_wdgts->w_window_main ), app_wdgts->window_title );
+  g_info( "  New window title: %s", app_wdgts->window_title );
   g_info( "util.c / ~update_window_title");
 }
 
@@ -0,0 +1,987 @@
+// version.c - saved versions of a mapter file
+//             part of the mapter program
+// Copyright (C) 2020 John Davies
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Each cell and note of a version is stored as a chunk of compact JSON
+// named by its SHA-256 hash, so anything that's the same in two versions
+// is only stored once. A version is then a list of the chunk names
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gtk/gtk.h>
+#include "main.h"
+#include "doc.h"
+#include "file.h"
+#include "grid.h"
+#include "list.h"
+#include "tree.h"
+#include "writer.h"
+#include "version.h"
+
+// --------------------------------------------------------------------------
+// version_store_path
+//
+// Returns the name of the directory that holds the versions of a file
+//
+// --------------------------------------------------------------------------
+
+gchar *version_store_path( const gchar *file_path )
+{
+  return g_strconcat( file_path, VERSION_EXTENSION, NULL );
+}
+
+// --------------------------------------------------------------------------
+// version_cell_chunk
+//
+// Returns the contents of a cell as compact JSON, in the same form as the
+// compact file format, or NULL if the cell is empty
+//
+// --------------------------------------------------------------------------
+
+gchar *version_cell_chunk( doc_cell *cell )
+{
+  const gchar *names[3] = { TEXT_SUMMARY, TEXT_HEADING, TEXT_BODY };
+  doc_text *texts[3] = { &cell->summary, &cell->heading, &cell->body };
+  const gchar *separator = "";
+  gchar *chunk = NULL;
+  gsize chunk_length;
+  gsize length;
+  gboolean escaped;
+
+  FILE *stream = open_memstream( &chunk, &chunk_length );
+  output_writer *writer = writer_new( stream );
+  writer_puts( writer, "{" );
+  if( cell->colour != NONE )
+  {
+    writer_printf( writer, "\"%s\":%i", CELL_BACKGROUND_COLOUR, cell->colour );
+    separator = ",";
+  }
+  for( gint t=0; t<3; t++ )
+  {
+    doc_text_source( texts[t], &length, &escaped );
+    if( length > 0 )
+    {
+      writer_printf( writer, "%s\"%s\":\"", separator, names[t] );
+      json_encode_text( writer, texts[t] );
+      writer_puts( writer, "\"" );
+      separator = ",";
+    }
+  }
+  writer_puts( writer, "}" );
+  writer_free( writer );
+  fclose( stream );
+  // Nothing was added so it's empty
+  if( strcmp( chunk, "{}" ) == 0 )
+  {
+    free( chunk );
+    return NULL;
+  }
+  gchar *result = g_strdup( chunk );
+  free( chunk );
+  return result;
+}
+
+// --------------------------------------------------------------------------
+// version_note_chunk
+//
+// Returns the heading and text of a note as compact JSON, the position of
+// the note is held in the version instead
+//
+// --------------------------------------------------------------------------
+
+gchar *version_note_chunk( doc_note *note )
+{
+  gchar *chunk = NULL;
+  gsize chunk_length;
+
+  FILE *stream = open_memstream( &chunk, &chunk_length );
+  output_writer *writer = writer_new( stream );
+  writer_puts( writer, "{\"" TREE_INDEX "\":\"\",\"" TREE_HEADING "\":\"" );
+  json_encode_text( writer, &note->heading );
+  writer_puts( writer, "\",\"" TREE_TEXT "\":\"" );
+  json_encode_text( writer, &note->text );
+  writer_puts( writer, "\"}" );
+  writer_free( writer );
+  fclose( stream );
+  gchar *result = g_strdup( chunk );
+  free( chunk );
+  return result;
+}
+
+// --------------------------------------------------------------------------
+// version_hash
+//
+// Returns the name of a chunk, which is the hash of its contents
+//
+// --------------------------------------------------------------------------
+
+gchar *version_hash( const gchar *chunk )
+{
+  return g_compute_checksum_for_string( G_CHECKSUM_SHA256, chunk, -1 );
+}
+
+// --------------------------------------------------------------------------
+// version_valid_hash
+//
+// Checks that a chunk name read from a version is a hash, so that it can't
+// point anywhere outside the chunk directory
+//
+// --------------------------------------------------------------------------
+
+gboolean version_valid_hash( const gchar *hash )
+{
+  gint i;
+  for( i=0; g_ascii_isxdigit( hash[i] ); i++ )
+  {
+  }
+  return( ( i == VERSION_HASH_LENGTH ) && ( hash[i] == '\0' ) );
+}
+
+// --------------------------------------------------------------------------
+// version_chunk_path
+//
+// Returns where a chunk is stored, the chunks are spread over directories
+// named from the first two characters of the hash
+//
+// --------------------------------------------------------------------------
+
+gchar *version_chunk_path( const gchar *store_path, const gchar *hash )
+{
+  gchar prefix[3] = { hash[0], hash[1], '\0' };
+  return g_build_filename( store_path, VERSION_CHUNK_DIR, prefix, hash + 2, NULL );
+}
+
+// --------------------------------------------------------------------------
+// version_put_chunk
+//
+// Stores a chunk unless it's already stored
+//
+// --------------------------------------------------------------------------
+
+result_return version_put_chunk( const gchar *store_path, const gchar *hash, const gchar *chunk )
+{
+  result_return put_result = { TRUE, "" };
+  gchar *chunk_path = version_chunk_path( store_path, hash );
+  if( g_file_test( chunk_path, G_FILE_TEST_EXISTS ) == FALSE )
+  {
+    gchar *dir = g_path_get_dirname( chunk_path );
+    if( ( g_mkdir_with_parents( dir, 0777 ) != 0 ) ||
+        ( g_file_set_contents( chunk_path, chunk, -1, NULL ) == FALSE ) )
+    {
+      g_info( "  ERROR: Could not write version chunk %s", chunk_path );
+      put_result.result = FALSE;
+      put_result.message = "Could not write the version";
+    }
+    g_free( dir );
+  }
+  g_free( chunk_path );
+  return put_result;
+}
+
+// --------------------------------------------------------------------------
+// version_get_chunk
+//
+// Reads a stored chunk, which is checked against its name
+//
+// --------------------------------------------------------------------------
+
+result_return version_get_chunk( const gchar *store_path, const gchar *hash, gchar **chunk )
+{
+  gchar *chunk_path = version_chunk_path( store_path, hash );
+  gboolean read = g_file_get_contents( chunk_path, chunk, NULL, NULL );
+  g_free( chunk_path );
+  if( read == FALSE )
+  {
+    return( (result_return) { FALSE, "Part of the version is missing" } );
+  }
+  gchar *check = version_hash( *chunk );
+  gboolean matches = ( strcmp( check, hash ) == 0 );
+  g_free( check );
+  if( matches == FALSE )
+  {
+    g_free( *chunk );
+    *chunk = NULL;
+    return( (result_return) { FALSE, "Part of the version is damaged" } );
+  }
+  return( (result_return) { TRUE, "" } );
+}
+
+// --------------------------------------------------------------------------
+// version_get_cell
+//
+// Reads the cell with the specified hash, an empty cell isn't stored
+//
+// --------------------------------------------------------------------------
+
+result_return version_get_cell( const gchar *store_path, const gchar *hash, doc_cell *cell )
+{
+  gchar *chunk;
+  result_return get_result = { TRUE, "" };
+
+  if( strcmp( hash, VERSION_EMPTY_CELL ) == 0 )
+  {
+    return get_result;
+  }
+  get_result = version_get_chunk( store_path, hash, &chunk );
+  if( get_result.result == TRUE )
+  {
+    json_scanner scanner = { chunk, chunk, chunk + strlen( chunk ) };
+    if( json_scan_cell( &scanner, cell ) == FALSE )
+    {
+      get_result.result = FALSE;
+      get_result.message = "Part of the version is damaged";
+    }
+    // Decode it now as the chunk won't be kept
+    doc_text_get( &cell->summary );
+    doc_text_get( &cell->heading );
+    doc_text_get( &cell->body );
+    g_free( chunk );
+  }
+  return get_result;
+}
+
+// --------------------------------------------------------------------------
+// version_get_note
+//
+// Reads a note of a version
+//
+// --------------------------------------------------------------------------
+
+result_return version_get_note( const gchar *store_path, version_note *entry, doc_note *note )
+{
+  gchar *chunk;
+  result_return get_result = version_get_chunk( store_path, entry->hash, &chunk );
+  if( get_result.result == TRUE )
+  {
+    json_scanner scanner = { chunk, chunk, chunk + strlen( chunk ) };
+    if( json_scan_note( &scanner, note ) == FALSE )
+    {
+      get_result.result = FALSE;
+      get_result.message = "Part of the version is damaged";
+    }
+    note->level = entry->level;
+    doc_text_get( &note->heading );
+    doc_text_get( &note->text );
+    g_free( chunk );
+  }
+  return get_result;
+}
+
+// --------------------------------------------------------------------------
+// version_manifest_new
+//
+// Creates an empty version of the specified size
+//
+// --------------------------------------------------------------------------
+
+version_manifest *version_manifest_new( gint rows, gint columns )
+{
+  version_manifest *manifest = g_new0( version_manifest, 1 );
+  manifest->rows = rows;
+  manifest->columns = columns;
+  manifest->cells = g_new0( gchar *, rows * columns );
+  manifest->notes = g_array_new( FALSE, TRUE, sizeof( version_note ) );
+  g_array_set_clear_func( manifest->notes, version_note_clear );
+  return manifest;
+}
+
+// --------------------------------------------------------------------------
+// version_manifest_free
+//
+// Frees a version and everything that it holds
+//
+// --------------------------------------------------------------------------
+
+void version_manifest_free( version_manifest *manifest )
+{
+  if( manifest != NULL )
+  {
+    for( gint i=0; i<( manifest->rows * manifest->columns ); i++ )
+    {
+      g_free( manifest->cells[i] );
+    }
+    g_free( manifest->cells );
+    g_array_free( manifest->notes, TRUE );
+    g_free( manifest );
+  }
+}
+
+// --------------------------------------------------------------------------
+// version_note_clear
+//
+// Frees the contents of a version_note, used as the array clear function
+//
+// --------------------------------------------------------------------------
+
+void version_note_clear( gpointer data )
+{
+  g_free( ( (version_note *) data )->hash );
+}
+
+// --------------------------------------------------------------------------
+// version_capture
+//
+// Works out the chunks that make up a document. If the store path is set
+// then any chunks that aren't already stored are written to it
+// Text that hasn't been decoded yet goes into the chunks as it was read,
+// so comparing with a version doesn't decode the whole document
+// Returns NULL if a chunk couldn't be written
+//
+// --------------------------------------------------------------------------
+
+version_manifest *version_capture( mapter_doc *doc, const gchar *store_path, result_return *capture_result )
+{
+  g_info( "version.c / version_capture");
+  *capture_result = (result_return) { TRUE, "" };
+  version_manifest *manifest = version_manifest_new( doc->rows, doc->columns );
+  for( gint i=0; ( i<( doc->rows * doc->columns ) ) && ( capture_result->result == TRUE ); i++ )
+  {
+    gchar *chunk = version_cell_chunk( &doc->cells[i] );
+    if( chunk == NULL )
+    {
+      manifest->cells[i] = g_strdup( VERSION_EMPTY_CELL );
+      continue;
+    }
+    manifest->cells[i] = version_hash( chunk );
+    if( store_path != NULL )
+    {
+      *capture_result = version_put_chunk( store_path, manifest->cells[i], chunk );
+    }
+    g_free( chunk );
+  }
+  for( guint n=0; ( n<doc->notes->len ) && ( capture_result->result == TRUE ); n++ )
+  {
+    doc_note *note = &g_array_index( doc->notes, doc_note, n );
+    gchar *chunk = version_note_chunk( note );
+    version_note entry = { note->level, version_hash( chunk ) };
+    g_array_append_val( manifest->notes, entry );
+    if( store_path != NULL )
+    {
+      *capture_result = version_put_chunk( store_path, entry.hash, chunk );
+    }
+    g_free( chunk );
+  }
+  if( capture_result->result == FALSE )
+  {
+    version_manifest_free( g_steal_pointer( &manifest ) );
+  }
+  g_info( "version.c / ~version_capture");
+  return manifest;
+}
+
+// --------------------------------------------------------------------------
+// version_save
+//
+// Saves the document as a new version of the file, only the cells and
+// notes that aren't already stored from an earlier version are written
+// The name of the new version is returned
+//
+// --------------------------------------------------------------------------
+
+result_return version_save( const gchar *file_path, mapter_doc *doc, gchar **name )
+{
+  result_return save_result;
+  gchar *store_path = version_store_path( file_path );
+
+  g_info( "version.c / version_save");
+  *name = NULL;
+  version_manifest *manifest = version_capture( doc, store_path, &save_result );
+  if( manifest != NULL )
+  {
+    GString *contents = g_string_new( NULL );
+    g_string_append_printf( contents, "%s %d %d %d\n", VERSION_MAGIC, manifest->rows, manifest->columns,
+                            manifest->notes->len );
+    for( gint i=0; i<( manifest->rows * manifest->columns ); i++ )
+    {
+      g_string_append_printf( contents, "%s\n", manifest->cells[i] );
+    }
+    for( guint n=0; n<manifest->notes->len; n++ )
+    {
+      version_note *entry = &g_array_index( manifest->notes, version_note, n );
+      g_string_append_printf( contents, "%d %s\n", entry->level, entry->hash );
+    }
+    // Named from the time, with a count added if there's already one
+    GDateTime *now = g_date_time_new_now_local();
+    gchar *time_name = g_date_time_format( now, VERSION_NAME_FORMAT );
+    g_date_time_unref( now );
+    gchar *version_path = NULL;
+    for( gint count=1; ( version_path == NULL ) || g_file_test( version_path, G_FILE_TEST_EXISTS ); count++ )
+    {
+      g_free( version_path );
+      g_free( *name );
+      *name = ( count == 1 ) ? g_strdup( time_name ) : g_strdup_printf( "%s-%d", time_name, count );
+      gchar *file_name = g_strconcat( *name, VERSION_SUFFIX, NULL );
+      version_path = g_build_filename( store_path, file_name, NULL );
+      g_free( file_name );
+    }
+    // The directory is only made for the chunks, which there aren't any of
+    // if the cells are all empty and there are no notes
+    if( ( g_mkdir_with_parents( store_path, 0777 ) != 0 ) ||
+        ( g_file_set_contents( version_path, contents->str, contents->len, NULL ) == FALSE ) )
+    {
+      g_info( "  ERROR: Could not write version %s", version_path );
+      save_result.result = FALSE;
+      save_result.message = "Could not write the version";
+      g_free( g_steal_pointer( name ) );
+    }
+    g_free( version_path );
+    g_free( time_name );
+    g_string_free( contents, TRUE );
+    version_manifest_free( manifest );
+  }
+  g_free( store_path );
+  g_info( "version.c / ~version_save");
+  return save_result;
+}
+
+// --------------------------------------------------------------------------
+// version_list
+//
+// Returns the names of the saved versions of a file, newest first
+//
+// --------------------------------------------------------------------------
+
+GPtrArray *version_list( const gchar *file_path )
+{
+  const gchar *file_name;
+  GPtrArray *names = g_ptr_array_new_with_free_func( g_free );
+  gchar *store_path = version_store_path( file_path );
+  GDir *dir = g_dir_open( store_path, 0, NULL );
+  if( dir != NULL )
+  {
+    while( ( file_name = g_dir_read_name( dir ) ) != NULL )
+    {
+      if( g_str_has_suffix( file_name, VERSION_SUFFIX ) == TRUE )
+      {
+        g_ptr_array_add( names, g_strndup( file_name, strlen( file_name ) - strlen( VERSION_SUFFIX ) ) );
+      }
+    }
+    g_dir_close( dir );
+  }
+  // The names sort into time order
+  g_ptr_array_sort( names, (GCompareFunc) version_compare_names );
+  g_free( store_path );
+  return names;
+}
+
+// --------------------------------------------------------------------------
+// version_compare_names
+//
+// Sort function for version_list, puts the newest first
+//
+// --------------------------------------------------------------------------
+
+gint version_compare_names( const gchar **a, const gchar **b )
+{
+  return -strcmp( *a, *b );
+}
+
+// --------------------------------------------------------------------------
+// version_load
+//
+// Reads the list of chunks that make up a saved version
+//
+// --------------------------------------------------------------------------
+
+result_return version_load( const gchar *file_path, const gchar *name, version_manifest **manifest_out )
+{
+  result_return load_result = { TRUE, "" };
+  version_manifest *manifest = NULL;
+  gchar *contents = NULL;
+  gchar **lines = NULL;
+  gchar magic[ sizeof( VERSION_MAGIC ) ];
+  gint rows, columns, notes;
+  gint level;
+  gchar hash[ VERSION_HASH_LENGTH + 1 ];
+
+  g_info( "version.c / version_load");
+  *manifest_out = NULL;
+  gchar *store_path = version_store_path( file_path );
+  gchar *file_name = g_strconcat( name, VERSION_SUFFIX, NULL );
+  gchar *version_path = g_build_filename( store_path, file_name, NULL );
+  if( g_file_get_contents( version_path, &contents, NULL, NULL ) == FALSE )
+  {
+    load_result.message = "Could not read the version";
+    goto error_exit;
+  }
+  lines = g_strsplit( contents, "\n", -1 );
+  if( ( sscanf( lines[0], "%7s %d %d %d", magic, &rows, &columns, &notes ) != 4 ) ||
+      ( strcmp( magic, VERSION_MAGIC ) != 0 ) ||
+      ( rows < MIN_GRID_ROWS ) || ( columns < MIN_GRID_COLUMNS ) || ( notes < 0 ) ||
+      ( g_strv_length( lines ) < (guint)( 1 + ( rows * columns ) + notes ) ) )
+  {
+    load_result.message = "The version is damaged";
+    goto error_exit;
+  }
+  manifest = version_manifest_new( rows, columns );
+  for( gint i=0; i<( rows * columns ); i++ )
+  {
+    const gchar *line = lines[ 1 + i ];
+    if( ( strcmp( line, VERSION_EMPTY_CELL ) != 0 ) && ( version_valid_hash( line ) == FALSE ) )
+    {
+      load_result.message = "The version is damaged";
+      goto error_exit;
+    }
+    manifest->cells[i] = g_strdup( line );
+  }
+  for( gint n=0; n<notes; n++ )
+  {
+    if( ( sscanf( lines[ 1 + ( rows * columns ) + n ], "%d %64s", &level, hash ) != 2 ) ||
+        ( level < 0 ) || ( version_valid_hash( hash ) == FALSE ) )
+    {
+      load_result.message = "The version is damaged";
+      goto error_exit;
+    }
+    version_note entry = { level, g_strdup( hash ) };
+    g_array_append_val( manifest->notes, entry );
+  }
+  *manifest_out = g_steal_pointer( &manifest );
+
+  error_exit: // Destination if anything was wrong with the version
+  if( *manifest_out == NULL )
+  {
+    g_info( "  ERROR: %s", load_result.message );
+    load_result.result = FALSE;
+  }
+  version_manifest_free( manifest );
+  g_strfreev( lines );
+  g_free( contents );
+  g_free( version_path );
+  g_free( file_name );
+  g_free( store_path );
+  g_info( "version.c / ~version_load");
+  return load_result;
+}
+
+// --------------------------------------------------------------------------
+// version_cell_hash
+//
+// Returns the hash of a cell of a version, positions outside the grid are
+// treated as empty cells
+//
+// --------------------------------------------------------------------------
+
+const gchar *version_cell_hash( version_manifest *manifest, gint row, gint column )
+{
+  if( ( row >= manifest->rows ) || ( column >= manifest->columns ) )
+  {
+    return VERSION_EMPTY_CELL;
+  }
+  return manifest->cells[ ( row * manifest->columns ) + column ];
+}
+
+// --------------------------------------------------------------------------
+// version_diff
+//
+// Returns the positions of the cells that are different in two versions,
+// only the hashes are compared so none of the cells are read
+//
+// --------------------------------------------------------------------------
+
+GArray *version_diff( version_manifest *from, version_manifest *to )
+{
+  GArray *changes = g_array_new( FALSE, FALSE, sizeof( version_change ) );
+  gint rows = MAX( from->rows, to->rows );
+  gint columns = MAX( from->columns, to->columns );
+  for( gint r=0; r<rows; r++ )
+  {
+    for( gint c=0; c<columns; c++ )
+    {
+      if( strcmp( version_cell_hash( from, r, c ), version_cell_hash( to, r, c ) ) != 0 )
+      {
+        version_change change = { r, c };
+        g_array_append_val( changes, change );
+      }
+    }
+  }
+  return changes;
+}
+
+// --------------------------------------------------------------------------
+// version_notes_differ
+//
+// Checks whether the notes of two versions are different in any way
+//
+// --------------------------------------------------------------------------
+
+gboolean version_notes_differ( version_manifest *from, version_manifest *to )
+{
+  if( from->notes->len != to->notes->len )
+  {
+    return TRUE;
+  }
+  for( guint n=0; n<from->notes->len; n++ )
+  {
+    version_note *a = &g_array_index( from->notes, version_note, n );
+    version_note *b = &g_array_index( to->notes, version_note, n );
+    if( ( a->level != b->level ) || ( strcmp( a->hash, b->hash ) != 0 ) )
+    {
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+// --------------------------------------------------------------------------
+// choose_version
+//
+// Asks which saved version of the current file to use
+// Returns the name of the version or NULL if none was chosen
+//
+// --------------------------------------------------------------------------
+
+gchar *choose_version( const gchar *title, const gchar *button, app_widgets *app_wdgts )
+{
+  gchar *name = NULL;
+
+  g_info( "version.c / choose_version");
+  GPtrArray *names = version_list( app_wdgts->current_file_path );
+  if( names->len == 0 )
+  {
+    show_version_message( GTK_MESSAGE_INFO, VERSION_NO_VERSIONS, app_wdgts );
+    g_ptr_array_free( names, TRUE );
+    return NULL;
+  }
+  GtkWidget *dialog = gtk_dialog_new_with_buttons( title, GTK_WINDOW( app_wdgts->w_window_main ),
+                                                   GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
+                                                   "_Cancel", GTK_RESPONSE_CANCEL,
+                                                   button, GTK_RESPONSE_OK,
+                                                   NULL );
+  GtkWidget *combo = gtk_combo_box_text_new();
+  for( guint i=0; i<names->len; i++ )
+  {
+    gtk_combo_box_text_append_text( GTK_COMBO_BOX_TEXT( combo ), g_ptr_array_index( names, i ) );
+  }
+  gtk_combo_box_set_active( GTK_COMBO_BOX( combo ), 0 );
+  gtk_container_add( GTK_CONTAINER( gtk_dialog_get_content_area( GTK_DIALOG( dialog ) ) ), combo );
+  gtk_widget_show_all( dialog );
+  if( gtk_dialog_run( GTK_DIALOG( dialog ) ) == GTK_RESPONSE_OK )
+  {
+    name = gtk_combo_box_text_get_active_text( GTK_COMBO_BOX_TEXT( combo ) );
+  }
+  gtk_widget_destroy( dialog );
+  g_ptr_array_free( names, TRUE );
+  g_info( "version.c / ~choose_version");
+  return name;
+}
+
+// --------------------------------------------------------------------------
+// show_version_message
+//
+// Shows a message about versions
+//
+// --------------------------------------------------------------------------
+
+void show_version_message( GtkMessageType type, const gchar *message, app_widgets *app_wdgts )
+{
+  GtkWidget *dialog_box = gtk_message_dialog_new( GTK_WINDOW( app_wdgts->w_window_main ),
+                                                  GTK_DIALOG_DESTROY_WITH_PARENT,
+                                                  type,
+                                                  GTK_BUTTONS_CLOSE,
+                                                  "%s", message );
+  gtk_dialog_run( GTK_DIALOG( dialog_box ) );
+  gtk_widget_destroy( dialog_box );
+}
+
+// --------------------------------------------------------------------------
+// version_resize_grid
+//
+// Adds or removes rows and columns at the end of the grid until it's the
+// specified size
+//
+// --------------------------------------------------------------------------
+
+void version_resize_grid( gint rows, gint columns, app_widgets *app_wdgts )
+{
+  g_info( "version.c / version_resize_grid");
+  // Keep the highlight out of the way of anything removed
+  if( ( rows < app_wdgts->current_grid_rows ) || ( columns < app_wdgts->current_grid_columns ) )
+  {
+    highlight_cell( app_wdgts->edit_grid_row, app_wdgts->edit_grid_column, 0, 0, TRUE, app_wdgts );
+    app_wdgts->edit_grid_row = 0;
+    app_wdgts->edit_grid_column = 0;
+  }
+  while( app_wdgts->current_grid_rows < rows )
+  {
+    add_row( app_wdgts, app_wdgts->current_grid_rows );
+  }
+  while( app_wdgts->current_grid_rows > rows )
+  {
+    app_wdgts->current_grid_rows--;
+    gtk_grid_remove_row( GTK_GRID( app_wdgts->w_text_grid ), app_wdgts->current_grid_rows );
+    list_delete_row( app_wdgts->current_grid_rows, app_wdgts );
+  }
+  while( app_wdgts->current_grid_columns < columns )
+  {
+    add_column( app_wdgts, app_wdgts->current_grid_columns );
+  }
+  while( app_wdgts->current_grid_columns > columns )
+  {
+    app_wdgts->current_grid_columns--;
+    gtk_grid_remove_column( GTK_GRID( app_wdgts->w_text_grid ), app_wdgts->current_grid_columns );
+    list_delete_column( app_wdgts->current_grid_columns, app_wdgts );
+  }
+  g_info( "version.c / ~version_resize_grid");
+}
+
+// --------------------------------------------------------------------------
+// version_show_cell
+//
+// Shows the summary and colour of a cell that's been restored
+//
+// --------------------------------------------------------------------------
+
+void version_show_cell( gint row, gint column, app_widgets *app_wdgts )
+{
+  gint edit_row = app_wdgts->edit_grid_row;
+  gint edit_column = app_wdgts->edit_grid_column;
+
+  GtkWidget *dest = gtk_grid_get_child_at( GTK_GRID( app_wdgts->w_text_grid ), column, row ); // event box
+  dest = gtk_bin_get_child( GTK_BIN( dest ) ); // frame
+  dest = gtk_bin_get_child( GTK_BIN( dest ) ); // label
+  gtk_label_set_text( GTK_LABEL( dest ), list_get_text( SUMMARY_LIST, row, column, app_wdgts ) );
+  // The background is set at the edit point
+  app_wdgts->edit_grid_row = row;
+  app_wdgts->edit_grid_column = column;
+  set_cell_background( list_get_colour( row, column, app_wdgts ), app_wdgts );
+  app_wdgts->edit_grid_row = edit_row;
+  app_wdgts->edit_grid_column = edit_column;
+}
+
+// --------------------------------------------------------------------------
+// on_save_version_activate
+//
+// Saves the current document as a new version of the file
+//
+// --------------------------------------------------------------------------
+
+void on_save_version_activate( GtkMenuItem *menuitem, app_widgets *app_wdgts )
+{
+  gchar *name;
+
+  g_info( "version.c / on_save_version_activate");
+  if( strlen( app_wdgts->current_file_path ) == 0 )
+  {
+    show_version_message( GTK_MESSAGE_INFO, VERSION_NO_FILE, app_wdgts );
+    return;
+  }
+  mapter_doc *doc = list_get_document();
+  capture_tree_notes( doc, app_wdgts );
+  result_return save_result = version_save( app_wdgts->current_file_path, doc, &name );
+  if( save_result.result == TRUE )
+  {
+    gchar *message = g_strdup_printf( "Saved version %s", name );
+    show_version_message( GTK_MESSAGE_INFO, message, app_wdgts );
+    g_free( message );
+    g_free( name );
+  }
+  else
+  {
+    show_version_message( GTK_MESSAGE_ERROR, save_result.message, app_wdgts );
+  }
+  g_info( "version.c / ~on_save_version_activate");
+}
+
+// --------------------------------------------------------------------------
+// on_restore_version_activate
+//
+// Puts the document back to a saved version. Only the cells that are
+// different are read from the version and changed, the changes are
+// unsaved and journalled like any other edit. Everything that's needed is
+// read before anything is changed, so if part of the version is missing or
+// damaged the document is left as it was
+//
+// --------------------------------------------------------------------------
+
+void on_restore_version_activate( GtkMenuItem *menuitem, app_widgets *app_wdgts )
+{
+  version_manifest *manifest = NULL;
+  version_manifest *current = NULL;
+  GArray *changes = NULL;
+  doc_cell *cells = NULL;
+  GArray *notes = NULL;
+  result_return restore_result;
+  gchar *name;
+
+  g_info( "version.c / on_restore_version_activate");
+  if( strlen( app_wdgts->current_file_path ) == 0 )
+  {
+    show_version_message( GTK_MESSAGE_INFO, VERSION_NO_FILE, app_wdgts );
+    return;
+  }
+  if( ( name = choose_version( "Restore Version", "_Restore", app_wdgts ) ) == NULL )
+  {
+    return;
+  }
+  gchar *store_path = version_store_path( app_wdgts->current_file_path );
+  restore_result = version_load( app_wdgts->current_file_path, name, &manifest );
+  if( restore_result.result == FALSE )
+  {
+    goto error_exit;
+  }
+  mapter_doc *doc = list_get_document();
+  capture_tree_notes( doc, app_wdgts );
+  // Cells outside either grid count as empty, so this can be worked out
+  // before the grid is resized
+  current = version_capture( doc, NULL, &restore_result );
+  changes = version_diff( current, manifest );
+  g_info( "  %d cells to restore", changes->len );
+  // Empty cells with no colour to read into
+  cells = g_new0( doc_cell, changes->len );
+  for( guint i=0; i<changes->len; i++ )
+  {
+    version_change *change = &g_array_index( changes, version_change, i );
+    restore_result = version_get_cell( store_path, version_cell_hash( manifest, change->row, change->column ), &cells[i] );
+    if( restore_result.result == FALSE )
+    {
+      goto error_exit;
+    }
+  }
+  if( version_notes_differ( current, manifest ) == TRUE )
+  {
+    notes = g_array_sized_new( FALSE, TRUE, sizeof( doc_note ), manifest->notes->len );
+    g_array_set_clear_func( notes, doc_note_clear );
+    for( guint n=0; n<manifest->notes->len; n++ )
+    {
+      doc_note note = { 0, { NULL, NULL, 0, FALSE }, { NULL, NULL, 0, FALSE }, 0 };
+      restore_result = version_get_note( store_path, &g_array_index( manifest->notes, version_note, n ), &note );
+      g_array_append_val( notes, note );
+      if( restore_result.result == FALSE )
+      {
+        goto error_exit;
+      }
+    }
+  }
+
+  // All of it has been read so now change the document
+  version_resize_grid( manifest->rows, manifest->columns, app_wdgts );
+  for( guint i=0; i<changes->len; i++ )
+  {
+    version_change *change = &g_array_index( changes, version_change, i );
+    // Anything outside the version has gone with the resize
+    if( ( change->row >= manifest->rows ) || ( change->column >= manifest->columns ) )
+    {
+      continue;
+    }
+    list_put_text( SUMMARY_LIST, change->row, change->column, (gchar *) doc_text_get( &cells[i].summary ), app_wdgts );
+    list_put_text( HEADER_LIST, change->row, change->column, (gchar *) doc_text_get( &cells[i].heading ), app_wdgts );
+    list_put_text( BODY_LIST, change->row, change->column, (gchar *) doc_text_get( &cells[i].body ), app_wdgts );
+    list_put_colour( change->row, change->column, cells[i].colour, app_wdgts );
+    version_show_cell( change->row, change->column, app_wdgts );
+  }
+  if( notes != NULL )
+  {
+    g_info( "  Restoring the notes" );
+    doc_clear_notes( doc );
+    g_array_append_vals( doc->notes, notes->data, notes->len );
+    // The notes now belong to the document
+    g_array_set_clear_func( notes, NULL );
+    load_tree_notes( doc, app_wdgts );
+    list_notes_changed( app_wdgts );
+    // The tree has just been filled from the document
+    doc->notes_captured = doc->notes_changed;
+  }
+
+  error_exit: // Destination if the version couldn't be read
+  if( restore_result.result == FALSE )
+  {
+    show_version_message( GTK_MESSAGE_ERROR, restore_result.message, app_wdgts );
+  }
+  if( cells != NULL )
+  {
+    for( guint i=0; i<changes->len; i++ )
+    {
+      doc_cell_clear( &cells[i] );
+    }
+    g_free( cells );
+  }
+  if( notes != NULL )
+  {
+    g_array_free( notes, TRUE );
+  }
+  if( changes != NULL )
+  {
+    g_array_free( changes, TRUE );
+  }
+  version_manifest_free( current );
+  version_manifest_free( manifest );
+  g_free( store_path );
+  g_free( name );
+  g_info( "version.c / ~on_restore_version_activate");
+}
+
+// --------------------------------------------------------------------------
+// on_compare_version_activate
+//
+// Lists the cells that are different in a saved version, none of the
+// cells are read as only their hashes are compared
+//
+// --------------------------------------------------------------------------
+
+void on_compare_version_activate( GtkMenuItem *menuitem, app_widgets *app_wdgts )
+{
+  version_manifest *manifest = NULL;
+  result_return compare_result;
+  gchar *name;
+
+  g_info( "version.c / on_compare_version_activate");
+  if( strlen( app_wdgts->current_file_path ) == 0 )
+  {
+    show_version_message( GTK_MESSAGE_INFO, VERSION_NO_FILE, app_wdgts );
+    return;
+  }
+  if( ( name = choose_version( "Compare with Version", "_Compare", app_wdgts ) ) == NULL )
+  {
+    return;
+  }
+  compare_result = version_load( app_wdgts->current_file_path, name, &manifest );
+  if( compare_result.result == FALSE )
+  {
+    show_version_message( GTK_MESSAGE_ERROR, compare_result.message, app_wdgts );
+    g_free( name );
+    return;
+  }
+  mapter_doc *doc = list_get_document();
+  capture_tree_notes( doc, app_wdgts );
+  version_manifest *current = version_capture( doc, NULL, &compare_result );
+  GArray *changes = version_diff( current, manifest );
+  GString *message = g_string_new( NULL );
+  g_string_append_printf( message, "Version %s\n\n", name );
+  if( ( current->rows != manifest->rows ) || ( current->columns != manifest->columns ) )
+  {
+    g_string_append_printf( message, "The grid was %d rows by %d columns\n", manifest->rows, manifest->columns );
+  }
+  g_string_append_printf( message, "%d cells are different\n", changes->len );
+  for( guint i=0; ( i<changes->len ) && ( i<VERSION_MAX_LISTED ); i++ )
+  {
+    version_change *change = &g_array_index( changes, version_change, i );
+    g_string_append_printf( message, "  Row %d, Column %d\n", change->row + 1, change->column + 1 );
+  }
+  if( changes->len > VERSION_MAX_LISTED )
+  {
+    g_string_append_printf( message, "  and %d more\n", changes->len - VERSION_MAX_LISTED );
+  }
+  g_string_append( message, ( version_notes_differ( current, manifest ) == TRUE ) ?
+                            "The notes are different\n" : "The notes are the same\n" );
+  show_version_message( GTK_MESSAGE_INFO, message->str, app_wdgts );
+  g_string_free( message, TRUE );
+  g_array_free( changes, TRUE );
+  version_manifest_free( current );
+  version_manifest_free( manifest );
+  g_free( name );
+  g_info( "version.c / ~on_compare_version_activate");
+}
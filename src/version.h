@@ -0,0 +1,91 @@
+// version.h - header file for version.c
+//             part of the mapter program
+// Copyright (C) 2020 John Davies
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef VERSION_H
+#define VERSION_H
+
+// The versions are kept in a directory alongside the file they belong to
+#define VERSION_EXTENSION ".versions"
+// Each cell and note is stored once in here, named by the hash of its contents
+#define VERSION_CHUNK_DIR "chunks"
+// One of these lists the chunks that make up each version
+#define VERSION_SUFFIX ".version"
+// Versions are named from the time they were saved
+#define VERSION_NAME_FORMAT "%Y%m%d-%H%M%S"
+// First line of a version, followed by the rows, columns and number of notes
+#define VERSION_MAGIC "MAPTERV"
+// Stands in for the hash of a cell with nothing in it
+#define VERSION_EMPTY_CELL "-"
+// Length of the hex SHA-256 chunk names
+#define VERSION_HASH_LENGTH 64
+// Most differences listed when comparing
+#define VERSION_MAX_LISTED 20
+
+#define VERSION_NO_FILE "The file needs to be saved before versions can be kept"
+#define VERSION_NO_VERSIONS "There are no saved versions of this file"
+
+// A note in a saved version
+typedef struct {
+  gint level;
+  gchar *hash;
+} version_note;
+
+// The contents of a saved version
+typedef struct {
+  gint rows;
+  gint columns;
+  gchar **cells;          // Chunk hash of each cell, VERSION_EMPTY_CELL if empty
+  GArray *notes;          // version_note entries
+} version_manifest;
+
+// Position of a cell that's different in a version
+typedef struct {
+  gint row;
+  gint column;
+} version_change;
+
+gchar *version_store_path( const gchar * );
+gchar *version_cell_chunk( doc_cell * );
+gchar *version_note_chunk( doc_note * );
+gchar *version_hash( const gchar * );
+gboolean version_valid_hash( const gchar * );
+gchar *version_chunk_path( const gchar *, const gchar * );
+result_return version_put_chunk( const gchar *, const gchar *, const gchar * );
+result_return version_get_chunk( const gchar *, const gchar *, gchar ** );
+result_return version_get_cell( const gchar *, const gchar *, doc_cell * );
+result_return version_get_note( const gchar *, version_note *, doc_note * );
+version_manifest *version_manifest_new( gint, gint );
+void version_manifest_free( version_manifest * );
+void version_note_clear( gpointer );
+version_manifest *version_capture( mapter_doc *, const gchar *, result_return * );
+result_return version_save( const gchar *, mapter_doc *, gchar ** );
+GPtrArray *version_list( const gchar * );
+gint version_compare_names( const gchar **, const gchar ** );
+result_return version_load( const gchar *, const gchar *, version_manifest ** );
+const gchar *version_cell_hash( version_manifest *, gint, gint );
+GArray *version_diff( version_manifest *, version_manifest * );
+gboolean version_notes_differ( version_manifest *, version_manifest * );
+
+gchar *choose_version( const gchar *, const gchar *, app_widgets * );
+void show_version_message( GtkMessageType, const gchar *, app_widgets * );
+void version_resize_grid( gint, gint, app_widgets * );
+void version_show_cell( gint, gint, app_widgets * );
+void on_save_version_activate( GtkMenuItem *, app_widgets * );
+void on_restore_version_activate( GtkMenuItem *, app_widgets * );
+void on_compare_version_activate( GtkMenuItem *, app_widgets * );
+
+#endif
@@ -0,0 +1,257 @@
+// writer.c - buffered output used when saving and exporting files
+//            part of the mapter program
+// Copyright (C) 2020 John Davies
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <gtk/gtk.h>
+#include "main.h"
+#include "writer.h"
+
+// How each byte is written inside a JSON string, anything that isn't
+// JSON_SAFE is the character that follows the \ in the escape sequence
+const guint8 json_escape_table[256] = {
+  [ 0x00 ] = JSON_DROP,
+  [ 0x01 ... 0x1F ] = JSON_UNICODE,
+  [ '\b' ] = 'b',
+  [ '\f' ] = 'f',
+  [ '\n' ] = 'n',
+  [ '\r' ] = 'r',
+  [ '\t' ] = 't',
+  [ '"' ] = '"',
+  [ '\\' ] = '\\'
+};
+
+// --------------------------------------------------------------------------
+// writer_new
+//
+// Creates a buffered writer for an open file, the file isn't closed when
+// the writer is freed
+//
+// --------------------------------------------------------------------------
+
+output_writer *writer_new( FILE *file )
+{
+  output_writer *writer = g_new( output_writer, 1 );
+  writer->file = file;
+  writer->buffer = g_malloc( WRITER_BUFFER_SIZE );
+  writer->used = 0;
+  writer->flushed = 0;
+  writer->failed = FALSE;
+  return writer;
+}
+
+// --------------------------------------------------------------------------
+// writer_free
+//
+// Flushes anything left in the buffer and frees the writer
+// Returns FALSE if any of the output could not be written
+//
+// --------------------------------------------------------------------------
+
+gboolean writer_free( output_writer *writer )
+{
+  gboolean result = writer_flush( writer );
+  g_free( writer->buffer );
+  g_free( writer );
+  return result;
+}
+
+// --------------------------------------------------------------------------
+// writer_flush
+//
+// Passes the contents of the buffer on to the file
+// Returns FALSE if this or any earlier write failed
+//
+// --------------------------------------------------------------------------
+
+gboolean writer_flush( output_writer *writer )
+{
+  if( ( writer->used > 0 ) &&
+      ( fwrite( writer->buffer, 1, writer->used, writer->file ) != writer->used ) )
+  {
+    writer->failed = TRUE;
+  }
+  writer->flushed += writer->used;
+  writer->used = 0;
+  return( writer->failed == FALSE );
+}
+
+// --------------------------------------------------------------------------
+// writer_position
+//
+// Returns the number of bytes written so far, including those that are
+// still in the buffer
+//
+// --------------------------------------------------------------------------
+
+guint64 writer_position( output_writer *writer )
+{
+  return writer->flushed + writer->used;
+}
+
+// --------------------------------------------------------------------------
+// writer_write
+//
+// Writes a block of bytes, anything bigger than the buffer goes straight
+// to the file
+//
+// --------------------------------------------------------------------------
+
+void writer_write( output_writer *writer, const gchar *data, gsize length )
+{
+  if( ( writer->used + length ) > WRITER_BUFFER_SIZE )
+  {
+    writer_flush( writer );
+    if( length >= WRITER_BUFFER_SIZE )
+    {
+      if( fwrite( data, 1, length, writer->file ) != length )
+      {
+        writer->failed = TRUE;
+      }
+      writer->flushed += length;
+      return;
+    }
+  }
+  memcpy( writer->buffer + writer->used, data, length );
+  writer->used += length;
+}
+
+// --------------------------------------------------------------------------
+// writer_puts
+//
+// Writes a zero terminated string
+//
+// --------------------------------------------------------------------------
+
+void writer_puts( output_writer *writer, const gchar *str )
+{
+  writer_write( writer, str, strlen( str ) );
+}
+
+// --------------------------------------------------------------------------
+// writer_printf
+//
+// Writes formatted text, this is formatted directly into the buffer
+// unless it's too big to fit
+//
+// --------------------------------------------------------------------------
+
+void writer_printf( output_writer *writer, const gchar *format, ... )
+{
+  va_list args;
+  va_start( args, format );
+  gsize space = WRITER_BUFFER_SIZE - writer->used;
+  gint length = g_vsnprintf( writer->buffer + writer->used, space, format, args );
+  va_end( args );
+  if( length < 0 )
+  {
+    writer->failed = TRUE;
+  }
+  else if( (gsize)length < space )
+  {
+    writer->used += length;
+  }
+  else
+  {
+    // Didn't fit so do it again into a separate string
+    va_start( args, format );
+    gchar *str = g_strdup_vprintf( format, args );
+    va_end( args );
+    writer_write( writer, str, length );
+    g_free( str );
+  }
+}
+
+// --------------------------------------------------------------------------
+// writer_json
+//
+// JSON encodes the specified number of characters and writes them out
+// The input doesn't need to be zero terminated
+// Runs of characters that don't need escaping are copied in one go
+//
+// --------------------------------------------------------------------------
+
+void writer_json( output_writer *writer, const gchar *input_str, gsize length )
+{
+  const guint8 *ip = (const guint8 *) input_str;
+  const guint8 *end = ip + length;
+  while( ip < end )
+  {
+    // Find the next character that needs escaping
+    const guint8 *run = ip;
+    while( ( ip < end ) && ( json_escape_table[ *ip ] == JSON_SAFE ) )
+    {
+      ip++;
+    }
+    if( ip > run )
+    {
+      writer_write( writer, (const gchar *) run, ip - run );
+    }
+    if( ip == end )
+    {
+      break;
+    }
+    // Special cases
+    gchar escape[8];
+    switch( json_escape_table[ *ip ] )
+    {
+      case JSON_DROP:
+        break;
+      case JSON_UNICODE:
+        g_snprintf( escape, sizeof( escape ), "\\u%04X", *ip );
+        writer_write( writer, escape, 6 );
+        break;
+      default:
+        escape[0] = '\\';
+        escape[1] = json_escape_table[ *ip ];
+        writer_write( writer, escape, 2 );
+        break;
+    }
+    ip++;
+  }
+}
+
+// --------------------------------------------------------------------------
+// writer_lines
+//
+// Writes text a line at a time, changing the start and end of each line
+// The line ends are found with memchr and each line is written in one go
+// The input doesn't need to be zero terminated
+//
+// --------------------------------------------------------------------------
+
+void writer_lines( output_writer *writer, const gchar *text, gsize length, const line_transform *transform )
+{
+  const gchar *end = text + length;
+  while( text < end )
+  {
+    const gchar *line_end = memchr( text, '\n', end - text );
+    gsize line_length = ( ( line_end != NULL ) ? line_end : end ) - text;
+    if( ( line_length > 0 ) && ( transform->prefix_length > 0 ) )
+    {
+      writer_write( writer, transform->prefix, transform->prefix_length );
+    }
+    writer_write( writer, text, line_length );
+    if( line_end == NULL )
+    {
+      break;
+    }
+    writer_write( writer, transform->line_end, transform->line_end_length );
+    text = line_end + 1;
+  }
+}
@@ -0,0 +1,51 @@
+// writer.h - header file for writer.c
+//            part of the mapter program
+// Copyright (C) 2020 John Davies
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef WRITER_H
+#define WRITER_H
+
+#include <stdio.h>
+
+#define WRITER_BUFFER_SIZE ( 256 * 1024 )
+
+// Entries in the JSON escape table
+#define JSON_SAFE 0               // Copied as it is
+#define JSON_DROP 1               // Not written at all
+#define JSON_UNICODE 'u'          // Written as \uxxxx
+
+// How writer_lines changes each line of text, e.g. a blank line after
+// every line, indentation or CRLF line ends
+typedef struct {
+  const gchar *prefix;            // Written before each line that isn't empty
+  gsize prefix_length;
+  const gchar *line_end;          // Written in place of each '\n'
+  gsize line_end_length;
+} line_transform;
+
+#define LINE_TRANSFORM( prefix, line_end ) { prefix, sizeof( prefix ) - 1, line_end, sizeof( line_end ) - 1 }
+
+output_writer *writer_new( FILE * );
+gboolean writer_free( output_writer * );
+gboolean writer_flush( output_writer * );
+guint64 writer_position( output_writer * );
+void writer_write( output_writer *, const gchar *, gsize );
+void writer_puts( output_writer *, const gchar * );
+void writer_printf( output_writer *, const gchar *, ... ) G_GNUC_PRINTF( 2, 3 );
+void writer_json( output_writer *, const gchar *, gsize );
+void writer_lines( output_writer *, const gchar *, gsize, const line_transform * );
+
+#endif
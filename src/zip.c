@@ -0,0 +1,377 @@
+// zip.c - streaming writer for the zip containers of EPUB and ODT files
+//         part of the mapter program
+// Copyright (C) 2020 John Davies
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Needed for fopencookie
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+#include <zlib.h>
+#include <gtk/gtk.h>
+#include "main.h"
+#include "zip.h"
+
+// --------------------------------------------------------------------------
+// zip_new
+//
+// Starts an archive at the current position of a file
+//
+// --------------------------------------------------------------------------
+
+zip_writer *zip_new( FILE *file )
+{
+  g_info( "zip.c / zip_new");
+  zip_writer *zip = g_new0( zip_writer, 1 );
+  zip->file = file;
+  zip->entries = g_array_new( FALSE, TRUE, sizeof( zip_entry ) );
+  g_array_set_clear_func( zip->entries, zip_entry_clear );
+  zip->buffer = g_malloc( ZIP_BUFFER_SIZE );
+  GDateTime *now = g_date_time_new_now_local();
+  zip->dos_time = ( g_date_time_get_hour( now ) << 11 ) | ( g_date_time_get_minute( now ) << 5 ) |
+                  ( g_date_time_get_second( now ) / 2 );
+  zip->dos_date = ( ( g_date_time_get_year( now ) - 1980 ) << 9 ) | ( g_date_time_get_month( now ) << 5 ) |
+                  g_date_time_get_day_of_month( now );
+  g_date_time_unref( now );
+  g_info( "zip.c / ~zip_new");
+  return zip;
+}
+
+// --------------------------------------------------------------------------
+// zip_finish
+//
+// Writes the central directory and frees the writer, the file is left
+// open. Returns FALSE if anything in the archive couldn't be written
+//
+// --------------------------------------------------------------------------
+
+gboolean zip_finish( zip_writer *zip )
+{
+  GByteArray *record = g_byte_array_new();
+
+  g_info( "zip.c / zip_finish");
+  if( zip->open == TRUE )
+  {
+    zip_end( zip );
+  }
+  guint64 directory = zip->offset;
+  for( guint i=0; i<zip->entries->len; i++ )
+  {
+    zip_entry *entry = &g_array_index( zip->entries, zip_entry, i );
+    gsize name_length = strlen( entry->name );
+    g_byte_array_set_size( record, 0 );
+    zip_put32( record, ZIP_CENTRAL_SIGNATURE );
+    zip_put16( record, ZIP_VERSION );           // Made by
+    zip_put16( record, ZIP_VERSION );           // Needed to extract
+    zip_put16( record, entry->flags );
+    zip_put16( record, entry->method );
+    zip_put16( record, zip->dos_time );
+    zip_put16( record, zip->dos_date );
+    zip_put32( record, entry->crc );
+    zip_put32( record, entry->compressed );
+    zip_put32( record, entry->size );
+    zip_put16( record, name_length );
+    zip_put16( record, 0 );                     // Extra field
+    zip_put16( record, 0 );                     // Comment
+    zip_put16( record, 0 );                     // Disk
+    zip_put16( record, 0 );                     // Internal attributes
+    zip_put32( record, 0 );                     // External attributes
+    zip_put32( record, entry->offset );
+    g_byte_array_append( record, (const guint8 *) entry->name, name_length );
+    zip_output( zip, record->data, record->len );
+  }
+  guint64 directory_size = zip->offset - directory;
+  if( ( zip->offset > ZIP_LIMIT ) || ( zip->entries->len > G_MAXUINT16 ) )
+  {
+    g_info( "  ERROR - archive needs zip64");
+    zip->failed = TRUE;
+  }
+  g_byte_array_set_size( record, 0 );
+  zip_put32( record, ZIP_END_SIGNATURE );
+  zip_put16( record, 0 );                       // This disk
+  zip_put16( record, 0 );                       // Disk with the directory
+  zip_put16( record, zip->entries->len );       // Entries on this disk
+  zip_put16( record, zip->entries->len );
+  zip_put32( record, directory_size );
+  zip_put32( record, directory );
+  zip_put16( record, 0 );                       // Comment
+  zip_output( zip, record->data, record->len );
+  g_byte_array_free( record, TRUE );
+
+  gboolean result = ( zip->failed == FALSE );
+  g_array_free( zip->entries, TRUE );
+  g_free( zip->buffer );
+  g_free( zip );
+  g_info( "zip.c / ~zip_finish");
+  return result;
+}
+
+// --------------------------------------------------------------------------
+// zip_entry_clear
+//
+// Frees the contents of an entry, used as the clear function of the array
+//
+// --------------------------------------------------------------------------
+
+void zip_entry_clear( gpointer data )
+{
+  g_free( ( (zip_entry *) data )->name );
+}
+
+// --------------------------------------------------------------------------
+// zip_stored
+//
+// Adds a file that's already in memory without compressing it, only used
+// for the mimetype which readers expect to find as it is at the start
+//
+// --------------------------------------------------------------------------
+
+void zip_stored( zip_writer *zip, const gchar *name, const gchar *data, gsize length )
+{
+  zip_entry entry = { g_strdup( name ), ZIP_STORED, 0, crc32( 0, (const Bytef *) data, length ),
+                      length, length, zip->offset };
+  zip_header( zip, &entry );
+  zip_output( zip, data, length );
+  g_array_append_val( zip->entries, entry );
+}
+
+// --------------------------------------------------------------------------
+// zip_begin
+//
+// Starts a deflated file, its contents are passed to zip_write and it's
+// finished with zip_end
+//
+// --------------------------------------------------------------------------
+
+void zip_begin( zip_writer *zip, const gchar *name )
+{
+  zip_entry entry = { g_strdup( name ), ZIP_DEFLATED, ZIP_FLAG_DESCRIPTOR | ZIP_FLAG_UTF8,
+                      crc32( 0, NULL, 0 ), 0, 0, zip->offset };
+  zip_header( zip, &entry );
+  g_array_append_val( zip->entries, entry );
+  memset( &zip->stream, 0, sizeof( z_stream ) );
+  // Negative window bits for a raw deflate stream without the zlib header
+  if( deflateInit2( &zip->stream, ZIP_LEVEL, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY ) != Z_OK )
+  {
+    g_info( "  ERROR - deflateInit2 failed");
+    zip->failed = TRUE;
+  }
+  zip->open = TRUE;
+}
+
+// --------------------------------------------------------------------------
+// zip_write
+//
+// Compresses more of the current file into the archive
+//
+// --------------------------------------------------------------------------
+
+void zip_write( zip_writer *zip, const gchar *data, gsize length )
+{
+  zip_entry *entry = &g_array_index( zip->entries, zip_entry, zip->entries->len - 1 );
+
+  if( ( zip->open == FALSE ) || ( zip->failed == TRUE ) )
+  {
+    zip->failed = TRUE;
+    return;
+  }
+  entry->crc = crc32( entry->crc, (const Bytef *) data, length );
+  entry->size += length;
+  zip->stream.next_in = (Bytef *) data;
+  zip->stream.avail_in = length;
+  zip_deflate( zip, Z_NO_FLUSH );
+}
+
+// --------------------------------------------------------------------------
+// zip_end
+//
+// Finishes the current file, the sizes and CRC go in a descriptor after
+// the data
+//
+// --------------------------------------------------------------------------
+
+void zip_end( zip_writer *zip )
+{
+  zip_entry *entry = &g_array_index( zip->entries, zip_entry, zip->entries->len - 1 );
+  GByteArray *descriptor = g_byte_array_sized_new( 16 );
+
+  if( zip->failed == FALSE )
+  {
+    zip->stream.next_in = NULL;
+    zip->stream.avail_in = 0;
+    zip_deflate( zip, Z_FINISH );
+  }
+  deflateEnd( &zip->stream );
+  zip->open = FALSE;
+  if( ( entry->size > ZIP_LIMIT ) || ( entry->compressed > ZIP_LIMIT ) || ( entry->offset > ZIP_LIMIT ) )
+  {
+    g_info( "  ERROR - %s needs zip64", entry->name );
+    zip->failed = TRUE;
+  }
+  zip_put32( descriptor, ZIP_DESCRIPTOR_SIGNATURE );
+  zip_put32( descriptor, entry->crc );
+  zip_put32( descriptor, entry->compressed );
+  zip_put32( descriptor, entry->size );
+  zip_output( zip, descriptor->data, descriptor->len );
+  g_byte_array_free( descriptor, TRUE );
+}
+
+// --------------------------------------------------------------------------
+// zip_open_entry
+//
+// Starts a deflated file and returns a stream that writes to it, so it
+// can be the file of an output_writer. Closing the stream ends the file
+//
+// --------------------------------------------------------------------------
+
+FILE *zip_open_entry( zip_writer *zip, const gchar *name )
+{
+  cookie_io_functions_t functions = { NULL, zip_cookie_write, NULL, zip_cookie_close };
+
+  zip_begin( zip, name );
+  FILE *stream = fopencookie( zip, "w", functions );
+  if( stream == NULL )
+  {
+    zip_end( zip );
+    zip->failed = TRUE;
+    return NULL;
+  }
+  // The output_writer already buffers, the stream doesn't need to as well
+  setvbuf( stream, NULL, _IONBF, 0 );
+  return stream;
+}
+
+// --------------------------------------------------------------------------
+// zip_cookie_write
+//
+// Stream write function, compresses the data as it's written
+//
+// --------------------------------------------------------------------------
+
+ssize_t zip_cookie_write( void *cookie, const char *data, size_t size )
+{
+  zip_writer *zip = (zip_writer *) cookie;
+
+  zip_write( zip, data, size );
+  // Any error is reported as nothing being written
+  return( ( zip->failed == FALSE ) ? (ssize_t) size : -1 );
+}
+
+// --------------------------------------------------------------------------
+// zip_cookie_close
+//
+// Stream close function, ends the file in the archive
+//
+// --------------------------------------------------------------------------
+
+int zip_cookie_close( void *cookie )
+{
+  zip_writer *zip = (zip_writer *) cookie;
+
+  zip_end( zip );
+  return( ( zip->failed == FALSE ) ? 0 : EOF );
+}
+
+// --------------------------------------------------------------------------
+// zip_deflate
+//
+// Runs the compressor over its input, writing out each full buffer
+//
+// --------------------------------------------------------------------------
+
+void zip_deflate( zip_writer *zip, gint flush )
+{
+  zip_entry *entry = &g_array_index( zip->entries, zip_entry, zip->entries->len - 1 );
+
+  do
+  {
+    zip->stream.next_out = zip->buffer;
+    zip->stream.avail_out = ZIP_BUFFER_SIZE;
+    if( deflate( &zip->stream, flush ) == Z_STREAM_ERROR )
+    {
+      zip->failed = TRUE;
+      return;
+    }
+    gsize produced = ZIP_BUFFER_SIZE - zip->stream.avail_out;
+    zip_output( zip, zip->buffer, produced );
+    entry->compressed += produced;
+  } while( zip->stream.avail_out == 0 );
+}
+
+// --------------------------------------------------------------------------
+// zip_header
+//
+// Writes the local header of an entry
+//
+// --------------------------------------------------------------------------
+
+void zip_header( zip_writer *zip, zip_entry *entry )
+{
+  gsize name_length = strlen( entry->name );
+  GByteArray *header = g_byte_array_sized_new( 30 + name_length );
+
+  zip_put32( header, ZIP_LOCAL_SIGNATURE );
+  zip_put16( header, ZIP_VERSION );
+  zip_put16( header, entry->flags );
+  zip_put16( header, entry->method );
+  zip_put16( header, zip->dos_time );
+  zip_put16( header, zip->dos_date );
+  // All zero when there's a descriptor
+  zip_put32( header, entry->crc );
+  zip_put32( header, entry->compressed );
+  zip_put32( header, entry->size );
+  zip_put16( header, name_length );
+  zip_put16( header, 0 );                       // Extra field
+  g_byte_array_append( header, (const guint8 *) entry->name, name_length );
+  zip_output( zip, header->data, header->len );
+  g_byte_array_free( header, TRUE );
+}
+
+// --------------------------------------------------------------------------
+// zip_output
+//
+// Writes to the archive file, keeping track of the offset
+//
+// --------------------------------------------------------------------------
+
+void zip_output( zip_writer *zip, const void *data, gsize length )
+{
+  if( ( length > 0 ) && ( fwrite( data, 1, length, zip->file ) != length ) )
+  {
+    zip->failed = TRUE;
+  }
+  zip->offset += length;
+}
+
+// --------------------------------------------------------------------------
+// zip_put16 / zip_put32
+//
+// Append little endian values to a record, the records aren't aligned so
+// they are built up a field at a time rather than as structs
+//
+// --------------------------------------------------------------------------
+
+void zip_put16( GByteArray *record, guint16 value )
+{
+  guint16 le = GUINT16_TO_LE( value );
+  g_byte_array_append( record, (const guint8 *) &le, sizeof( le ) );
+}
+
+void zip_put32( GByteArray *record, guint32 value )
+{
+  guint32 le = GUINT32_TO_LE( value );
+  g_byte_array_append( record, (const guint8 *) &le, sizeof( le ) );
+}
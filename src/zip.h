@@ -0,0 +1,82 @@
+// zip.h - header file for zip.c
+//         part of the mapter program
+// Copyright (C) 2020 John Davies
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef ZIP_H
+#define ZIP_H
+
+// Record signatures
+#define ZIP_LOCAL_SIGNATURE 0x04034b50
+#define ZIP_DESCRIPTOR_SIGNATURE 0x08074b50
+#define ZIP_CENTRAL_SIGNATURE 0x02014b50
+#define ZIP_END_SIGNATURE 0x06054b50
+
+#define ZIP_VERSION 20                  // 2.0, deflate without zip64
+#define ZIP_STORED 0
+#define ZIP_DEFLATED 8
+// Sizes and CRC follow the data as they aren't known when it starts
+#define ZIP_FLAG_DESCRIPTOR 0x0008
+// Names are UTF-8
+#define ZIP_FLAG_UTF8 0x0800
+// Largest size or offset without zip64
+#define ZIP_LIMIT G_MAXUINT32
+
+#define ZIP_LEVEL 6
+#define ZIP_BUFFER_SIZE ( 64 * 1024 )
+
+// A file in the archive, kept for the central directory at the end
+typedef struct {
+  gchar *name;
+  guint16 method;
+  guint16 flags;
+  guint32 crc;
+  guint64 compressed;
+  guint64 size;
+  guint64 offset;         // Of the local header
+} zip_entry;
+
+// An archive being written. Entries are deflated as they are written so
+// only the compressor's window and one buffer are held however large the
+// archive gets
+typedef struct {
+  FILE *file;
+  guint64 offset;         // Bytes written to the file so far
+  GArray *entries;        // zip_entry for each file
+  z_stream stream;        // Deflating the current entry
+  gboolean open;          // An entry is being written
+  gboolean failed;
+  guint16 dos_time;       // Every entry is stamped with the time it was created
+  guint16 dos_date;
+  guchar *buffer;
+} zip_writer;
+
+zip_writer *zip_new( FILE * );
+gboolean zip_finish( zip_writer * );
+void zip_entry_clear( gpointer );
+void zip_stored( zip_writer *, const gchar *, const gchar *, gsize );
+void zip_begin( zip_writer *, const gchar * );
+void zip_write( zip_writer *, const gchar *, gsize );
+void zip_end( zip_writer * );
+FILE *zip_open_entry( zip_writer *, const gchar * );
+ssize_t zip_cookie_write( void *, const char *, size_t );
+int zip_cookie_close( void * );
+void zip_deflate( zip_writer *, gint );
+void zip_header( zip_writer *, zip_entry * );
+void zip_output( zip_writer *, const void *, gsize );
+void zip_put16( GByteArray *, guint16 );
+void zip_put32( GByteArray *, guint32 );
+
+#endif